@@ -0,0 +1,428 @@
+#include <signal.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "cli.h"
+#include "cli_log.h"
+#include "cli_server.h"
+#include "cli_snapshot.h"
+#include "cli_trace.h"
+#include "cli_watch.h"
+
+#define DUMP_ENTRY_COUNT  10000 /**< Number of lines written by the "dump" command */
+#define DUMP_ENTRY_LENGTH 32    /**< Maximum length of a line of the "dump" command */
+
+#define DEMO_INTERFACE_COUNT 4 /**< Number of tokens added under "lan if" */
+
+// Options of "lan show"
+static const cli_option_t lanShowOptions[] = {
+	{ 'v', "verbose", CLI_DESC(lan_show_v, "More details, repeatable"), true },
+	{ 'a', "all", CLI_DESC(lan_show_a, "Down interfaces too"), false },
+};
+
+// Tell if main loop should keep running
+static volatile int keepRunning = 1;
+
+/**
+ * @brief Handler to stop app on ctrl-c
+ *
+ * @param dummy unused
+ */
+void sigint_handler(int dummy)
+{
+	keepRunning = 0;
+}
+
+/**
+ * @brief Give a monotonic time for cli_tick()
+ * @return Time in ms
+ */
+static uint32_t get_time_ms(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// ================
+// CMD CALLBACKS
+// ================
+
+/**
+ * @brief Close the connection of the user
+ *
+ * @param argc UNUSED
+ * @param argv UNUSED
+ *
+ * @return 0
+ */
+int cli_cb_exit(uint8_t argc, char * argv[])
+{
+	CLI_PRINTF("Bye\n\r");
+	cli_exit();
+	return 0;
+}
+
+/**
+ * @brief Answer "pong", used by loadgen to measure latency
+ *
+ * @param argc UNUSED
+ * @param argv UNUSED
+ *
+ * @return 0
+ */
+int cli_cb_ping(uint8_t argc, char * argv[])
+{
+	CLI_PRINTF("pong\n\r");
+	return 0;
+}
+
+/**
+ * @brief Change the mode of the session
+ *
+ * @param argc Argument count
+ * @param argv "human", "machine" or "binary"
+ *
+ * @return 0: ok, -1: Error
+ */
+int cli_cb_mode(uint8_t argc, char * argv[])
+{
+	if (strcmp(argv[0], "human") == 0) {
+		return cli_set_mode(CLI_MODE_HUMAN);
+	} else if (strcmp(argv[0], "machine") == 0) {
+		return cli_set_mode(CLI_MODE_MACHINE);
+	} else if (strcmp(argv[0], "binary") == 0) {
+		return cli_set_mode(CLI_MODE_BINARY);
+	}
+	CLI_PRINTF("Unknown mode \"%s\"\n\r", argv[0]);
+	return -1;
+}
+
+/**
+ * @brief Print the command IDs used by binary mode
+ *
+ * @param argc UNUSED
+ * @param argv UNUSED
+ *
+ * @return 0
+ */
+int cli_cb_ids(uint8_t argc, char * argv[])
+{
+	cli_print_command_ids();
+	return 0;
+}
+
+/**
+ * @brief Print all commands
+ *
+ * @param argc UNUSED
+ * @param argv UNUSED
+ *
+ * @return 0
+ */
+int cli_cb_tree(uint8_t argc, char * argv[])
+{
+	cli_print_tree(cli_get_root_token());
+	return 0;
+}
+
+/**
+ * @brief Produce the next lines of the "dump" command
+ * @see cli_stream_callback_t
+ *
+ * @param cursor Index of the next entry
+ * @param buffer Where lines are written
+ * @param len Size of buffer
+ * @return Number of bytes written, 0 when all entries are written
+ */
+static int dump_produce(uint32_t * cursor, char * buffer, uint16_t len)
+{
+	uint16_t pos = 0;
+
+	while ((*cursor < DUMP_ENTRY_COUNT) && ((len - pos) >= DUMP_ENTRY_LENGTH)) {
+		pos += snprintf(buffer + pos, len - pos, "entry %5lu: 0x%08lX\n\r", (unsigned long) *cursor, (unsigned long) ((*cursor * 2654435761UL) & 0xFFFFFFFFUL));
+		++*cursor;
+	}
+	return pos;
+}
+
+/**
+ * @brief Write a large table without blocking the server
+ *
+ * @param argc UNUSED
+ * @param argv UNUSED
+ *
+ * @return 0: ok, -1: Error
+ */
+int cli_cb_dump(uint8_t argc, char * argv[])
+{
+	return cli_stream_start(&dump_produce);
+}
+
+/**
+ * @brief Receive the certificate of "lan cert"
+ * @see cli_upload_callback_t
+ *
+ * @param data Decoded bytes, NULL at the end
+ * @param len Number of bytes, 0: Complete, -1: Aborted
+ * @return 0
+ */
+static int cert_consume(const uint8_t * data, int16_t len)
+{
+	static uint32_t size;
+	static uint32_t sum;
+
+	if (len > 0) {
+		for (int16_t i = 0; i < len; ++i) {
+			sum = (sum + data[i]) & 0xFFFF;
+		}
+		size += len;
+		return 0;
+	}
+
+	if (len == 0) {
+		CLI_PRINTF("Received %lu bytes, checksum 0x%04lX\n\r", (unsigned long) size, (unsigned long) sum);
+	}
+	size = 0;
+	sum  = 0;
+	return 0;
+}
+
+/**
+ * @brief Receive a certificate after the command line
+ *
+ * @param argc Argument count
+ * @param argv "hex", "base64" or "raw"
+ *
+ * @return 0: ok, -1: Error
+ */
+int cli_cb_lan_cert(uint8_t argc, char * argv[])
+{
+	uint8_t encoding;
+
+	if (strcmp(argv[0], "hex") == 0) {
+		encoding = CLI_UPLOAD_HEX;
+	} else if (strcmp(argv[0], "base64") == 0) {
+		encoding = CLI_UPLOAD_BASE64;
+	} else if (strcmp(argv[0], "raw") == 0) {
+		encoding = CLI_UPLOAD_RAW;
+	} else {
+		CLI_PRINTF("Unknown encoding \"%s\"\n\r", argv[0]);
+		return -1;
+	}
+	if (encoding != CLI_UPLOAD_RAW) {
+		CLI_PRINTF("Send the data, end with '%c'\n\r", CLI_UPLOAD_END);
+	}
+	return cli_upload_start(&cert_consume, encoding);
+}
+
+/**
+ * @brief Print the interface chosen in "lan if <name>"
+ *
+ * @param argc UNUSED
+ * @param argv UNUSED
+ *
+ * @return 0
+ */
+int cli_cb_lan_if(uint8_t argc, char * argv[])
+{
+	CLI_PRINTF("Interface is up\n\r");
+	return 0;
+}
+
+/**
+ * @brief Default callback for leaf tokens
+ *
+ * @param argc Argument count
+ * @param argv Argument values
+ *
+ * @return The status of the function
+ */
+int print_args(uint8_t argc, char * argv[])
+{
+	cli_option_values_t options;
+
+	cli_get_option_values(&options);
+	CLI_PRINTF("print_args() Found %d args and options 0x%02lX:\n\r", argc, (unsigned long) options.mask);
+	for (uint8_t i = 0; i < argc; ++i) {
+		CLI_PRINTF("\t%s\n\r", argv[i]);
+	}
+	return 0;
+}
+
+/**
+ * @brief Change the IP address, "lan show" must not give the old one
+ *
+ * @param argc Argument count
+ * @param argv Argument values
+ *
+ * @return The status of print_args()
+ */
+int cli_cb_lan_ip(uint8_t argc, char * argv[])
+{
+	cli_cache_invalidate(NULL);
+	return print_args(argc, argv);
+}
+
+/**
+ * @brief Add one token per interface, only called when "lan if" is first used
+ * @see cli_provider_t
+ *
+ * @param parent The lazy token
+ * @return 0: ok, -1: Error
+ */
+static int lan_if_provider(cli_token * parent)
+{
+	char text[CLI_MAX_TEXT_LEN];
+
+	for (int i = 0; i < DEMO_INTERFACE_COUNT; ++i) {
+		cli_token * curTok;
+
+		snprintf(text, sizeof(text), "eth%d", i);
+		curTok = cli_add_token(text, CLI_DESC(lan_if_eth, "Print this interface"));
+		if ((curTok == NULL) || (cli_add_children(parent, curTok) != 0)) {
+			return -1;
+		}
+		cli_set_callback(curTok, &cli_cb_lan_if);
+	}
+	return 0;
+}
+
+// Everything the tree points to, for its snapshot
+static const cli_symbol_t demoSymbols[] = {
+	CLI_SYMBOL_CALLBACK(cli_cb_exit),
+	CLI_SYMBOL_CALLBACK(cli_cb_ping),
+	CLI_SYMBOL_CALLBACK(cli_cb_mode),
+	CLI_SYMBOL_CALLBACK(cli_cb_dump),
+	CLI_SYMBOL_CALLBACK(cli_cb_ids),
+	CLI_SYMBOL_CALLBACK(cli_cb_tree),
+	CLI_SYMBOL_CALLBACK(print_args),
+	CLI_SYMBOL_CALLBACK(cli_cb_lan_ip),
+	CLI_SYMBOL_CALLBACK(cli_cb_lan_cert),
+	CLI_SYMBOL_PROVIDER(lan_if_provider),
+	CLI_SYMBOL_OPTIONS(lanShowOptions),
+};
+
+/**
+ * @brief Create the command line interface
+ */
+static int create_cli_commands(void)
+{
+	cli_token * tokRoot = cli_get_root_token();
+	cli_token * tokLvl1;
+	cli_token * tokLvl2;
+	cli_token * curTok;
+
+	// Create commands
+	curTok = cli_add_token("exit", CLI_DESC(exit, "Close the connection"));
+	cli_set_callback(curTok, &cli_cb_exit);
+	cli_add_children(tokRoot, curTok);
+
+	curTok = cli_add_token("ping", CLI_DESC(ping, "Answer pong"));
+	cli_set_callback(curTok, &cli_cb_ping);
+	cli_add_children(tokRoot, curTok);
+
+	curTok = cli_add_token("mode", CLI_DESC(mode, "<human|machine|binary> Set mode"));
+	cli_set_callback(curTok, &cli_cb_mode);
+	cli_set_argc(curTok, 1, 0);
+	cli_add_children(tokRoot, curTok);
+
+	curTok = cli_add_token("dump", CLI_DESC(dump, "Stream a large table"));
+	cli_set_callback(curTok, &cli_cb_dump);
+	cli_add_children(tokRoot, curTok);
+
+	curTok = cli_add_token("ids", CLI_DESC(ids, "Print command IDs"));
+	cli_set_callback(curTok, &cli_cb_ids);
+	cli_add_children(tokRoot, curTok);
+
+	curTok = cli_add_token("tree", CLI_DESC(tree, "Print all commands"));
+	cli_set_callback(curTok, &cli_cb_tree);
+	cli_add_children(tokRoot, curTok);
+
+	tokLvl1 = cli_add_token("lan", CLI_DESC(lan, "LAN configuration"));
+	{
+		curTok = cli_add_token("show", CLI_DESC(lan_show, "[interface] Show configuration"));
+		cli_set_callback(curTok, &print_args);
+		cli_set_argc(curTok, 0, 1);
+		cli_set_options(curTok, lanShowOptions, sizeof(lanShowOptions) / sizeof(lanShowOptions[0]));
+		cli_add_children(tokLvl1, curTok);
+		cli_set_cache(curTok, 1000); // Polled by monitoring
+
+		curTok = cli_add_token("ip", CLI_DESC(lan_ip, "<address> Set IP adress"));
+		cli_set_callback(curTok, &cli_cb_lan_ip);
+		cli_set_argc(curTok, 1, 0);
+		cli_add_children(tokLvl1, curTok);
+
+		curTok = cli_add_token("cert", CLI_DESC(lan_cert, "<hex|base64|raw> Upload a certificate"));
+		cli_set_callback(curTok, &cli_cb_lan_cert);
+		cli_set_argc(curTok, 1, 0);
+		cli_add_children(tokLvl1, curTok);
+
+		curTok = cli_add_token("if", CLI_DESC(lan_if, "Interfaces"));
+		cli_set_provider(curTok, &lan_if_provider);
+		cli_add_children(tokLvl1, curTok);
+
+		tokLvl2 = cli_add_token("port", CLI_DESC(lan_port, "Switch port"));
+		cli_set_pattern(tokLvl2, 1, 48);
+		{
+			curTok = cli_add_token("show", CLI_DESC(lan_port_show, "Show port status"));
+			cli_set_callback(curTok, &print_args);
+			cli_add_children(tokLvl2, curTok);
+		}
+		cli_add_children(tokLvl1, tokLvl2);
+	}
+	cli_add_children(tokRoot, tokLvl1);
+	return 0;
+}
+
+/**
+ * @brief Serve the CLI over telnet
+ * @details Usage: demo_server [port] [address] [snapshot]
+ * Connect with "telnet 127.0.0.1 2323". The tree is loaded from the
+ * snapshot file if it is up to date, otherwise it is built and saved to it.
+ */
+int main(int argc, char * argv[])
+{
+	uint16_t     port     = (argc > 1) ? atoi(argv[1]) : 2323;
+	const char * address  = (argc > 2) ? argv[2] : "127.0.0.1";
+	const char * snapshot = (argc > 3) ? argv[3] : NULL;
+	uint16_t     count    = sizeof(demoSymbols) / sizeof(demoSymbols[0]);
+
+	signal(SIGINT, sigint_handler);
+	signal(SIGPIPE, SIG_IGN);
+
+	printf("Exemple using %s\n\r", cli_get_version());
+
+	cli_init();
+	cli_exit();             // No prompt on stdout, only network sessions are used
+	cli_tick(get_time_ms()); // Cached commands need the time
+	if ((snapshot == NULL) || (cli_snapshot_load(snapshot, demoSymbols, count) != 0)) {
+		create_cli_commands();
+		if (snapshot != NULL) {
+			cli_snapshot_save(snapshot, demoSymbols, count);
+		}
+	}
+
+	// Commands of the modules are not in the snapshot
+	cli_watch_register(cli_get_root_token());
+	cli_mem_register(cli_get_root_token());
+	cli_trace_register(cli_get_root_token());
+	cli_log_register(cli_get_root_token());
+
+	if (cli_server_open(address, port) != 0) {
+		printf("Unable to listen on %s:%u\n\r", address, port);
+		return 1;
+	}
+	printf("Listening on %s:%u\n\r", address, cli_server_get_port());
+
+	while (keepRunning) {
+		// Wake up for watched commands only
+		cli_server_poll((cli_watch_get_job_count() > 0) ? CLI_WATCH_TICK_MS : CLI_SERVER_NO_TIMEOUT);
+		cli_tick(get_time_ms());
+	}
+
+	cli_server_close();
+	printf("\n\r- Quitting...\n\r");
+	return 0;
+}
@@ -1,14 +1,17 @@
-#include <ncurses.h>
 #include <signal.h>
+#include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "cli.h"
+#include "cli_tty.h"
+#include "lb_history_file.h"
 
 // Tell if main loop should keep running
 static volatile int keepRunning = 1;
 
 /**
- * @brief Handler to stop app on ctrl-c
+ * @brief Handler to stop app on SIGINT or SIGTERM
  *
  * @param dummy unused
  */
@@ -19,6 +22,18 @@ void sigint_handler(int dummy)
 	printf("\n\r- Quitting...\n\r");
 }
 
+/**
+ * @brief Give a monotonic time for cli_tick()
+ * @return Time in ms
+ */
+static uint32_t get_time_ms(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
 // ================
 // CMD CALLBACKS
 // ================
@@ -109,21 +124,14 @@ static int create_cli_commands(void)
 
 int main(void)
 {
-	uint8_t byte;
+	char         historyPath[LB_HISTORY_FILE_PATH_LENGTH];
+	const char * home = getenv("HOME");
 
-	// Init signal handler
+	// Init signal handler, keys do not raise signals in raw mode
 	signal(SIGINT, sigint_handler);
-
-	// Init ncurses stuff
-	initscr();
-	endwin();
-	noecho();
+	signal(SIGTERM, sigint_handler);
 	setvbuf(stdout, NULL, _IONBF, 0);
 	setvbuf(stderr, NULL, _IONBF, 0);
-	timeout(100);
-
-	// Using getch now allows us to see firsts printf()
-	getch();
 
 	// motd
 	printf("Exemple using %s\n\r", cli_get_version());
@@ -131,15 +139,29 @@ int main(void)
 	cli_init();
 	create_cli_commands();
 
+	// The terminal is restored by cli_tty_close(), or at exit
+	if (cli_tty_open(STDIN_FILENO, STDOUT_FILENO) != 0) {
+		printf("Unable to open the terminal\n");
+		return 1;
+	}
+	cli_session_select(cli_tty_get_session());
+
+	// Reload history from previous runs
+	if (home != NULL) {
+		snprintf(historyPath, sizeof(historyPath), "%s/.elementarycli_history", home);
+		lb_history_file_open(historyPath);
+	}
+
 	while (keepRunning) {
-		byte = getch();
-		if (byte == 0xFF) {
-			continue;
+		// Returns as soon as bytes are received, or a streamed output can be written
+		if (cli_tty_poll(100) < 0) {
+			break; // Terminal closed
 		}
-		cli_rx(byte);
+		cli_tick(get_time_ms());
 	}
 
-	endwin(); // Restore terminal to previous state
+	lb_history_file_close();
+	cli_tty_close();
 
 	return 0;
-}
\ No newline at end of file
+}
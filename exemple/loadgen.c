@@ -0,0 +1,237 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOADGEN_REQUEST      "ping\n" /**< Command sent by each client */
+#define LOADGEN_PROMPT       "> "     /**< Marker telling the session is ready */
+#define LOADGEN_ANSWER       "pong"   /**< Marker telling the command was answered */
+#define LOADGEN_EVENT_COUNT  64
+#define LOADGEN_READ_LENGTH  4096
+#define LOADGEN_TIMEOUT_MS   5000
+#define LOADGEN_STATE_READY  0 /**< Waiting for the first prompt */
+#define LOADGEN_STATE_ANSWER 1 /**< Waiting for the answer of the last request */
+
+typedef struct {
+	int             fd;
+	uint8_t         state;     /**< LOADGEN_STATE_* */
+	uint8_t         matchPos;  /**< Number of bytes of the marker already matched */
+	uint32_t        sentCount; /**< Number of requests sent */
+	struct timespec sentTime;  /**< When the last request was sent */
+} loadgen_client_t;
+
+/**
+ * @brief Give the time elapsed since a timestamp
+ *
+ * @param since Timestamp
+ * @return Elapsed time in us
+ */
+static double elapsed_us(const struct timespec * since)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - since->tv_sec) * 1e6 + (now.tv_nsec - since->tv_nsec) / 1e3;
+}
+
+/**
+ * @brief Compare 2 doubles for qsort()
+ */
+static int cmp_double(const void * a, const void * b)
+{
+	double diff = *(const double *) a - *(const double *) b;
+	return (diff > 0) - (diff < 0);
+}
+
+/**
+ * @brief Look for a marker in a stream of bytes, even if split between reads
+ *
+ * @param client Pointer, matchPos holds the progress
+ * @param marker The string to find
+ * @param data Received bytes
+ * @param len Number of bytes
+ * @return Index after the marker in data, -1 if not found
+ */
+static int match_marker(loadgen_client_t * client, const char * marker, const char * data, int len)
+{
+	int markerLen = strlen(marker);
+
+	for (int i = 0; i < len; ++i) {
+		// Markers have no repeated prefix, restarting is enough
+		if (data[i] == marker[client->matchPos]) {
+			++client->matchPos;
+		} else {
+			client->matchPos = (data[i] == marker[0]) ? 1 : 0;
+		}
+		if (client->matchPos == markerLen) {
+			client->matchPos = 0;
+			return i + 1;
+		}
+	}
+	return -1;
+}
+
+/**
+ * @brief Send the next request of a client
+ *
+ * @param client Pointer
+ * @return 0: ok, -1: Error
+ */
+static int send_request(loadgen_client_t * client)
+{
+	clock_gettime(CLOCK_MONOTONIC, &client->sentTime);
+	client->state    = LOADGEN_STATE_ANSWER;
+	client->matchPos = 0;
+	++client->sentCount;
+	return (write(client->fd, LOADGEN_REQUEST, strlen(LOADGEN_REQUEST)) > 0) ? 0 : -1;
+}
+
+/**
+ * @brief Run all requests with a given number of clients and print latencies
+ *
+ * @param addr Server address
+ * @param clientCount Number of simultaneous clients
+ * @param requestCount Number of requests sent by each client
+ * @return 0: ok, -1: Error
+ */
+static int run_round(const struct sockaddr_in * addr, int clientCount, uint32_t requestCount)
+{
+	loadgen_client_t * clients   = calloc(clientCount, sizeof(loadgen_client_t));
+	double *           latencies = calloc((size_t) clientCount * requestCount, sizeof(double));
+	struct epoll_event events[LOADGEN_EVENT_COUNT];
+	struct epoll_event event;
+	struct timespec    start;
+	char               buffer[LOADGEN_READ_LENGTH];
+	uint32_t           doneCount = 0;
+	uint32_t           total     = clientCount * requestCount;
+	double             sum       = 0;
+	int                epollFd   = epoll_create1(0);
+	int                one       = 1;
+	int                ret       = -1;
+
+	if ((clients == NULL) || (latencies == NULL) || (epollFd < 0)) {
+		goto exit;
+	}
+
+	// Connect all clients
+	for (int i = 0; i < clientCount; ++i) {
+		clients[i].fd = socket(AF_INET, SOCK_STREAM, 0);
+		if ((clients[i].fd < 0) || (connect(clients[i].fd, (const struct sockaddr *) addr, sizeof(*addr)) != 0)) {
+			printf("Unable to connect client %d: %s\n", i, strerror(errno));
+			goto exit;
+		}
+		setsockopt(clients[i].fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		fcntl(clients[i].fd, F_SETFL, O_NONBLOCK);
+
+		event.events   = EPOLLIN;
+		event.data.u32 = i;
+		epoll_ctl(epollFd, EPOLL_CTL_ADD, clients[i].fd, &event);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (doneCount < total) {
+		int count = epoll_wait(epollFd, events, LOADGEN_EVENT_COUNT, LOADGEN_TIMEOUT_MS);
+		if (count <= 0) {
+			printf("Timeout: %u/%u answers received\n", doneCount, total);
+			goto exit;
+		}
+
+		for (int i = 0; i < count; ++i) {
+			loadgen_client_t * client = &clients[events[i].data.u32];
+			int                len    = read(client->fd, buffer, sizeof(buffer));
+			int                pos    = 0;
+			int                found;
+
+			if (len <= 0) {
+				printf("Connection closed by server\n");
+				goto exit;
+			}
+
+			// Several markers may be in the same read
+			while (pos < len) {
+				const char * marker = (client->state == LOADGEN_STATE_READY) ? LOADGEN_PROMPT : LOADGEN_ANSWER;
+
+				found = match_marker(client, marker, buffer + pos, len - pos);
+				if (found < 0) {
+					break;
+				}
+				pos += found;
+
+				if (client->state == LOADGEN_STATE_ANSWER) {
+					latencies[doneCount++] = elapsed_us(&client->sentTime);
+				}
+				if ((client->sentCount < requestCount) && (send_request(client) != 0)) {
+					goto exit;
+				}
+				if (client->sentCount >= requestCount) {
+					break;
+				}
+			}
+		}
+	}
+
+	// Statistics
+	qsort(latencies, total, sizeof(double), cmp_double);
+	for (uint32_t i = 0; i < total; ++i) {
+		sum += latencies[i];
+	}
+	printf("%7d %10u %10.1f %10.1f %10.1f %10.1f %12.0f\n",
+		   clientCount, total,
+		   sum / total,
+		   latencies[total / 2],
+		   latencies[(uint32_t) (total * 0.99)],
+		   latencies[total - 1],
+		   total / (elapsed_us(&start) / 1e6));
+	ret = 0;
+
+exit:
+	for (int i = 0; (clients != NULL) && (i < clientCount); ++i) {
+		if (clients[i].fd > 0) {
+			close(clients[i].fd);
+		}
+	}
+	if (epollFd >= 0) {
+		close(epollFd);
+	}
+	free(clients);
+	free(latencies);
+	return ret;
+}
+
+/**
+ * @brief Measure command round-trip latency of demo_server as the number of clients grows
+ * @details Usage: loadgen [port] [maxClients] [requestsPerClient] [address]
+ */
+int main(int argc, char * argv[])
+{
+	struct sockaddr_in addr;
+	uint16_t           port         = (argc > 1) ? atoi(argv[1]) : 2323;
+	int                maxClients   = (argc > 2) ? atoi(argv[2]) : 256;
+	uint32_t           requestCount = (argc > 3) ? atoi(argv[3]) : 100;
+	const char *       address      = (argc > 4) ? argv[4] : "127.0.0.1";
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port   = htons(port);
+	if (inet_pton(AF_INET, address, &addr.sin_addr) != 1) {
+		printf("Invalid address \"%s\"\n", address);
+		return 1;
+	}
+
+	printf("%7s %10s %10s %10s %10s %10s %12s\n", "clients", "requests", "avg(us)", "p50(us)", "p99(us)", "max(us)", "req/s");
+	for (int clientCount = 1; clientCount <= maxClients; clientCount *= 2) {
+		if (run_round(&addr, clientCount, requestCount) != 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -1,16 +1,342 @@
 #include "cli.h"
 
+#include "cli_log.h"
+#include "cli_trace.h"
+#include "cli_watch.h"
+
 #define CLI_C
 #include "cli_debug.h"
 
 // Global variables
-const char cliVersionName[] = CLI_NAME " - v" CLI_VERSION;
-cli_token  tokenList[CLI_MAX_TOKEN_COUNT];
+const char    cliVersionName[] = CLI_NAME " - v" CLI_VERSION;
+cli_token     tokenList[CLI_MAX_TOKEN_COUNT];
+cli_token *   cliTokens = tokenList;           /**< Tokens of the tree, tokenList or the ones of an image (See cli_snapshot_import()) */
+cli_symbol_t  cliSymbols[CLI_MAX_SYMBOLS];     /**< Callbacks, providers and options of the tokens, linked by index + 1 */
+uint16_t      cliSymbolCount;                  /**< Number of symbols used */
+cli_session   cliDefaultSession;              /**< Session used when none is selected */
+uint32_t      cliTickMs = 0;                   /**< Time given by the last cli_tick() */
+bool          cliIsTicked;                     /**< Tell if cli_tick() was called, cached outputs would never expire otherwise */
+uint16_t      cliStackExecute;                 /**< Highest stack used by cli_execute_lb() */
+uint16_t      cliStackAutocomplete;            /**< Highest stack used by cli_autocomplete_lb() */
+cli_token *   cliFreeToken;                    /**< First unused token, next ones are linked by childs[0] */
+cli_token *   cliLazyPinned;                   /**< Lazy token being materialized, it and its ancestors can't be evicted */
+uint16_t      cliLazyClock;                    /**< Use counter of lazy tokens, for eviction */
+bool          cliLazyHeld;                     /**< Nothing is evicted, resolved leaves are kept to be called later */
+uint16_t      cliTokenGeneration;              /**< Generation of the last token added */
+
+CLI_ATOMIC(uint32_t) cliTreeVersion; /**< Incremented each time the tree changes */
+
+#if (CLI_CONCURRENT_READERS == 1)
+atomic_uint cliReadEpoch;  /**< Advanced by the writer once the readers of the epoch before the current one left */
+atomic_uint cliReaders[2]; /**< Number of readers which entered at an even and at an odd epoch */
+cli_token * cliRetired;    /**< Removed subtrees readers may still walk, linked by retiredNext */
+#endif
+
+CLI_THREAD_LOCAL cli_session *       cliSession = &cliDefaultSession; /**< Selected session, one per reader thread */
+CLI_THREAD_LOCAL cli_option_values_t cliOptionValues;                 /**< Options given to the command being called */
+
+/**
+ * Destination of the output while it is captured
+ */
+typedef struct cli_capture_t {
+	char *                 buffer;          /**< Where bytes are written */
+	uint16_t               size;            /**< Size of buffer */
+	uint16_t               len;             /**< Number of bytes written */
+	uint8_t                isTruncated : 1; /**< Tell if bytes were lost because buffer is full */
+	cli_output_callback_t  chunk;           /**< Receive the bytes instead of buffer, NULL to use buffer */
+	struct cli_capture_t * prevCapture;     /**< Capture to restore when this one stops */
+	cli_output_callback_t  prevOutput;      /**< Output to restore when this one stops */
+} cli_capture_t;
+CLI_THREAD_LOCAL cli_capture_t * cliCapture = NULL;                           /**< Capture in progress */
+char                             cliCaptureBuffer[CLI_MACHINE_OUTPUT_LENGTH]; /**< Output of the command answered in machine or binary mode */
+
+#if (CLI_CACHE_ENTRIES > 0)
+// States of a cache entry
+#define CLI_CACHE_FREE    0 /**< Unused */
+#define CLI_CACHE_FILLING 1 /**< Callback running, its output is being copied */
+#define CLI_CACHE_STALE   2 /**< Invalidated while filling, freed once the callback returned */
+#define CLI_CACHE_VALID   3 /**< Output can be reused until the TTL of the token */
+
+/**
+ * Output of a cached leaf, for one set of arguments and options
+ */
+typedef struct {
+	cli_token *         token;                           /**< Leaf */
+	uint8_t             state;                           /**< CLI_CACHE_* */
+	uint8_t             argsLen;                         /**< Number of bytes of args */
+	uint16_t            len;                             /**< Number of bytes of output */
+	uint32_t            time;                            /**< cli_get_tick() when the callback was called */
+	int                 status;                          /**< Return of the callback */
+	cli_option_values_t options;                         /**< Options given */
+	char                args[CLI_CMD_MAX_LEN];           /**< Arguments, each one '\0' terminated */
+	char                output[CLI_CACHE_OUTPUT_LENGTH]; /**< Output of the callback */
+} cli_cache_entry_t;
+cli_cache_entry_t     cliCache[CLI_CACHE_ENTRIES]; /**< Outputs of the cached leaves */
+cli_cache_entry_t *   cliCacheFilling;             /**< Entry receiving the output, NULL if none or the output is too long */
+cli_output_callback_t cliCacheOutput;              /**< Where the output goes while it is copied */
+#endif
+
+// Tokens and symbols are linked by index + 1 on 16 bits
+#if ((CLI_MAX_TOKEN_COUNT > 0xFFFF) || (CLI_MAX_SYMBOLS > 0xFFFF))
+#error "CLI_MAX_TOKEN_COUNT and CLI_MAX_SYMBOLS must be lower than 65536"
+#endif
+
+// Probes are masked and a free entry ends them
+#if ((CLI_ID_TABLE_SIZE & (CLI_ID_TABLE_SIZE - 1)) != 0)
+#error "CLI_ID_TABLE_SIZE must be a power of 2"
+#elif (CLI_ID_TABLE_SIZE <= CLI_MAX_TOKEN_COUNT)
+#error "CLI_ID_TABLE_SIZE must be greater than CLI_MAX_TOKEN_COUNT"
+#endif
+
+/**
+ * Entry of the table giving the leaf token of a command ID
+ */
+typedef struct {
+	uint32_t    id;    /**< Command ID */
+	cli_token * token; /**< Leaf token, NULL if the entry is free */
+} cli_id_entry_t;
+// Built by lookups, one per reader thread so that none writes a table another one reads
+CLI_THREAD_LOCAL cli_id_entry_t cliIdTable[CLI_ID_TABLE_SIZE]; /**< Open addressing table of command IDs */
+CLI_THREAD_LOCAL uint32_t       cliIdTableVersion;             /**< Value of cliTreeVersion when cliIdTable was built */
+
+// Snapshot of the tree (See cli_snapshot_export())
+#define CLI_SNAPSHOT_MAGIC         0x50414E53 /**< "SNAP" in a little endian image */
+#define CLI_SNAPSHOT_VERSION       2          /**< Changed with the layout of the image */
+#define CLI_SNAPSHOT_TOKENS_OFFSET ((sizeof(cli_snapshot_header_t) + 7) & ~7UL) /**< Tokens are aligned on 8 bytes */
+
+/**
+ * Beginning of a snapshot image, followed by the tokens and the names of the
+ * symbols. Offsets are from the beginning of the image.
+ */
+typedef struct {
+	uint32_t magic;         /**< CLI_SNAPSHOT_MAGIC */
+	uint32_t size;          /**< Size of the image */
+	uint32_t tokensOffset;  /**< Tokens, as they are in tokenList */
+	uint32_t symbolsOffset; /**< Names of the symbols, each one ends with '\0' */
+	uint16_t version;       /**< CLI_SNAPSHOT_VERSION */
+	uint16_t tokenSize;     /**< sizeof(cli_token) */
+	uint16_t tokenCount;    /**< CLI_MAX_TOKEN_COUNT, the first one is root */
+	uint16_t symbolCount;   /**< Number of symbols given to cli_snapshot_export() */
+	uint16_t freeToken;     /**< Link of the first unused token */
+	uint16_t generation;    /**< Generation of the last token added */
+	uint16_t lazyClock;     /**< Use counter of lazy tokens */
+	uint8_t  maxChilds;     /**< CLI_MAX_CHILDS */
+	uint8_t  maxTextLen;    /**< CLI_MAX_TEXT_LEN */
+	uint8_t  maxDescLen;    /**< CLI_MAX_DESC_LEN, 0 if compressed */
+	uint8_t  reserved;
+} cli_snapshot_header_t;
+
+#if (CLI_DESC_COMPRESSED == 1)
+// Compressed descriptions (Generated by tools/cli_desc_gen.c)
+#define CLI_DESC_DICT_FLAG 0x80 /**< Codes from this one are an index in cliDescDict, others are ASCII */
+extern const uint8_t  cliDescBlob[];        /**< Coded descriptions, each one ends with 0 */
+extern const uint16_t cliDescOffsets[];     /**< Index of each description in cliDescBlob */
+extern const char     cliDescDict[];        /**< Dictionary words, each one ends with '\0' */
+extern const uint16_t cliDescDictOffsets[]; /**< Index of each word in cliDescDict */
+#endif
+
+// Help rendering
+#define CLI_TREE_INDENT     " | "                   /**< Printed once per level before a token of the tree */
+#define CLI_TREE_INDENT_LEN 3                       /**< Length of CLI_TREE_INDENT */
+#define CLI_TREE_MAX_DEPTH  (CLI_CMD_MAX_TOKEN + 1) /**< Deeper tokens can't be reached (Root included) */
+#define CLI_TREE_DESC_GAP   2                       /**< Spaces between the widest text and the descriptions */
+#define CLI_LABEL_LENGTH    (CLI_MAX_TEXT_LEN + 13) /**< Text of a token and "<65535-65535>" */
+
+/**
+ * Line of the help, written at once
+ */
+typedef struct {
+	char     text[CLI_OUTPUT_BUFFER_LENGTH - 1]; /**< Fits in one CLI_PRINTF() */
+	uint16_t len;
+} cli_row_t;
+
+/**
+ * Position of the tree walk at one depth
+ */
+typedef struct {
+	cli_token * tok;
+	uint8_t     childIndex; /**< Next child to visit */
+} cli_tree_level_t;
+
+// Stack measurement
+#define CLI_STACK_PATTERN 0xA5 /**< Value of the painted stack */
+#if defined(__GNUC__)
+#define CLI_NOINLINE __attribute__((noinline)) /**< Keep the frame of a function */
+#elif defined(_MSC_VER)
+#define CLI_NOINLINE __declspec(noinline)
+#else
+#define CLI_NOINLINE
+#endif
+#if (CLI_STACK_PROBE_LENGTH > 0) && !defined(__GNUC__)
+#error "CLI_STACK_PROBE_LENGTH relies on GCC or Clang keeping the frames and the painted bytes, set it to 0"
+#endif
+
+// Tokenizer
+#define CLI_PARSE_SPACE        0                             /**< Between words */
+#define CLI_PARSE_WORD         1                             /**< Inside a word, not quoted */
+#define CLI_PARSE_DQUOTE       2                             /**< Inside "..." */
+#define CLI_PARSE_SQUOTE       3                             /**< Inside '...' */
+#define CLI_PARSE_ERR_TOO_MANY -1                            /**< More than CLI_CMD_MAX_TOKEN words */
+#define CLI_PARSE_ERR_QUOTE    -2                            /**< A quote is not closed */
+#define CLI_PARSE_ERR_ESCAPE   -3                            /**< Line ends with a backslash */
+#define CLI_PARSE_SPACES       ((uintptr_t) -1 / 0xFF * ' ') /**< ' ' in each byte of a machine word */
+
+// Command IDs are 32 bits FNV-1a hashes of the token path
+#define CLI_ID_FNV_OFFSET  2166136261UL
+#define CLI_ID_FNV_PRIME   16777619UL
+#define CLI_ID_PATH_LENGTH (CLI_CMD_MAX_TOKEN * CLI_MAX_TEXT_LEN) /**< Maximum length of a token path */
+
+// Binary frames
+#define CLI_BIN_STATE_SYNC     0 /**< Waiting for CLI_BIN_SYNC */
+#define CLI_BIN_STATE_LEN_LOW  1 /**< Waiting for the low byte of the length */
+#define CLI_BIN_STATE_LEN_HIGH 2 /**< Waiting for the high byte of the length */
+#define CLI_BIN_STATE_BODY     3 /**< Receiving the body of the frame */
+#define CLI_BIN_REQUEST_HEADER 5 /**< Command ID (4) + argc (1) */
+#define CLI_BIN_ANSWER_HEADER  7 /**< Sync (1) + length (2) + status (4) */
 
 // ===================
 //      TOOLS
 // ===================
 
+/**
+ * @brief Give the token of a link
+ * @details Links are checked so that a damaged image never points out of
+ * the tokens
+ *
+ * @param link Index + 1 of the token, 0 if none
+ * @return Pointer, NULL if none
+ */
+static cli_token * cli_get_link(cli_link_t link)
+{
+	if ((link == 0) || (link > CLI_MAX_TOKEN_COUNT)) {
+		return NULL;
+	}
+	return &cliTokens[link - 1];
+}
+
+/**
+ * @brief Give the link of a token
+ *
+ * @param curTok Pointer, can be NULL
+ * @return Index + 1 of the token, 0 if NULL
+ */
+static cli_link_t cli_link(const cli_token * curTok)
+{
+	return (curTok != NULL) ? (curTok - cliTokens) + 1 : 0;
+}
+
+/**
+ * @brief Give a child of a token
+ *
+ * @param curTok Pointer
+ * @param index Child slot [0; CLI_MAX_CHILDS[
+ * @return Pointer, NULL if the slot is empty
+ */
+static cli_token * cli_get_child(const cli_token * curTok, uint8_t index)
+{
+	return cli_get_link(curTok->childs[index]);
+}
+
+/**
+ * @brief Give the parent of a token
+ *
+ * @param curTok Pointer
+ * @return Pointer, NULL for root or a token not added yet
+ */
+static cli_token * cli_get_parent(const cli_token * curTok)
+{
+	return cli_get_link(curTok->parent);
+}
+
+/**
+ * @brief Give the symbol of a link
+ *
+ * @param link Index + 1 of the symbol, 0 if none
+ * @return Pointer, NULL if none
+ */
+static const cli_symbol_t * cli_get_symbol(cli_link_t link)
+{
+	if ((link == 0) || (link > CLI_MAX_SYMBOLS)) {
+		return NULL;
+	}
+	return &cliSymbols[link - 1];
+}
+
+/**
+ * @brief Give the callback of a token
+ *
+ * @param curTok Pointer
+ * @return Pointer to function, NULL if none
+ */
+static cli_callback_t cli_get_callback(const cli_token * curTok)
+{
+	const cli_symbol_t * symbol = cli_get_symbol(curTok->callback);
+
+	return (symbol != NULL) ? symbol->callback : NULL;
+}
+
+/**
+ * @brief Give the provider of a token
+ *
+ * @param curTok Pointer
+ * @return Pointer to function, NULL if the token is not lazy
+ */
+static cli_provider_t cli_get_provider(const cli_token * curTok)
+{
+	const cli_symbol_t * symbol = cli_get_symbol(curTok->provider);
+
+	return (symbol != NULL) ? symbol->provider : NULL;
+}
+
+/**
+ * @brief Give an option of a token
+ *
+ * @param curTok Pointer
+ * @param index Option [0; optionCount[
+ * @return Pointer, NULL if the token has no options
+ */
+static const cli_option_t * cli_get_option_def(const cli_token * curTok, uint8_t index)
+{
+	const cli_symbol_t * symbol = cli_get_symbol(curTok->options);
+
+	return ((symbol != NULL) && (symbol->options != NULL)) ? &symbol->options[index] : NULL;
+}
+
+/**
+ * @brief Give the link of a callback, a provider or options, added if new
+ * @details One pointer is given, the others are NULL
+ *
+ * @param callback Pointer, NULL if not given
+ * @param provider Pointer, NULL if not given
+ * @param options Pointer, NULL if not given
+ * @return Index + 1 of the symbol, 0 if all pointers are NULL or the symbols are full
+ */
+static cli_link_t cli_add_symbol(cli_callback_t callback, cli_provider_t provider, const cli_option_t * options)
+{
+	cli_symbol_t * symbol;
+
+	if ((callback == NULL) && (provider == NULL) && (options == NULL)) {
+		return 0;
+	}
+	for (uint16_t i = 0; i < cliSymbolCount; ++i) {
+		if ((cliSymbols[i].callback == callback) && (cliSymbols[i].provider == provider) && (cliSymbols[i].options == options)) {
+			return i + 1;
+		}
+	}
+	if (cliSymbolCount == CLI_MAX_SYMBOLS) {
+		DPRINTF(ERROR, "Unable to add a symbol, maximum reach: %u\n\r", CLI_MAX_SYMBOLS);
+		return 0;
+	}
+
+	// Filled before a token links it, readers see it with the token
+	symbol           = &cliSymbols[cliSymbolCount];
+	symbol->name     = NULL;
+	symbol->callback = callback;
+	symbol->provider = provider;
+	symbol->options  = options;
+	return ++cliSymbolCount;
+}
+
 /**
  * @brief Print cmdText
  *
@@ -26,38 +352,158 @@ static void cli_print_cmd_text(char * cmdText[], uint8_t count)
 }
 
 /**
- * @brief Print all childs formatted with tree view
- * @warning Recurcive call inside !
+ * @brief Give the text of a token as printed in the help
  *
- * @param curTok The token where the tree begin
+ * @param curTok Pointer
+ * @param label Buffer of CLI_LABEL_LENGTH bytes
+ * @return Length of label
  */
-static void cli_print_token_tree(cli_token * curTok)
+static uint8_t cli_get_label(cli_token * curTok, char * label)
 {
-	static uint8_t indent = 0;
-	uint8_t        i;
-
-	// Print indent
-	for (i = 0; i < indent; ++i) {
-		CLI_PRINTF(" | ");
+	if (curTok->isPattern) {
+		return snprintf(label, CLI_LABEL_LENGTH, "%s<%u-%u>", curTok->text, curTok->patternMin, curTok->patternMax);
 	}
-	++indent;
+	cli_strcpy_safe(label, curTok->text, CLI_LABEL_LENGTH);
+	return strlen(label);
+}
 
-	// Print text and description with alignement
-	CLI_PRINTF("%s", curTok->text);
-	for (i = 0; i < (30 - 3 * indent - strlen(curTok->text)); ++i) {
-		CLI_PRINTF(" ");
+/**
+ * @brief Write and empty a row
+ *
+ * @param row Pointer
+ */
+static void cli_row_flush(cli_row_t * row)
+{
+	if (row->len > 0) {
+		CLI_PRINTF("%.*s", row->len, row->text);
+		row->len = 0;
 	}
-	CLI_PRINTF("%s\n\r", curTok->desc);
+}
 
-	// Recursive call for all childs
-	for (i = 0; i < CLI_MAX_CHILDS; ++i) {
-		if (curTok->childs[i] == NULL) {
+/**
+ * @brief Append text to a row, flushed first if full
+ *
+ * @param row Pointer
+ * @param str Text
+ * @param len Number of characters of str
+ */
+static void cli_row_append(cli_row_t * row, const char * str, uint16_t len)
+{
+	while (len > 0) {
+		uint16_t count = sizeof(row->text) - row->len;
+
+		if (count == 0) {
+			cli_row_flush(row);
 			continue;
 		}
-		cli_print_token_tree(curTok->childs[i]);
+		if (count > len) {
+			count = len;
+		}
+		memcpy(row->text + row->len, str, count);
+		row->len += count;
+		str += count;
+		len -= count;
+	}
+}
+
+/**
+ * @brief Append spaces to a row up to a column
+ *
+ * @param row Pointer
+ * @param column Index where the next text is written
+ */
+static void cli_row_pad(cli_row_t * row, uint16_t column)
+{
+	while ((row->len < column) && (row->len < sizeof(row->text))) {
+		row->text[row->len++] = ' ';
+	}
+}
+
+/**
+ * @brief Append a description to a row
+ * @details Compressed descriptions are decoded straight into the row,
+ * without any buffer of the size of the text
+ *
+ * @param row Pointer
+ * @param desc Description of a token or an option
+ */
+static void cli_row_append_desc(cli_row_t * row, cli_desc_t desc)
+{
+#if (CLI_DESC_COMPRESSED == 1)
+	const uint8_t * code = &cliDescBlob[cliDescOffsets[desc]];
+
+	for (; *code != 0; ++code) {
+		if (*code >= CLI_DESC_DICT_FLAG) {
+			const char * word = &cliDescDict[cliDescDictOffsets[*code - CLI_DESC_DICT_FLAG]];
+			cli_row_append(row, word, strlen(word));
+		} else {
+			cli_row_append(row, (const char *) code, 1);
+		}
 	}
+#else
+	cli_row_append(row, desc, strlen(desc));
+#endif
+}
 
-	--indent;
+/**
+ * @brief Walk a tree without recursion, to measure or print it
+ * @details Tokens deeper than CLI_TREE_MAX_DEPTH can't be reached by a
+ * command and are not printed
+ *
+ * @param curTok The token where the tree begin
+ * @param descColumn 0: Only measure, else column of the descriptions
+ * @return Width of the widest indent and text
+ */
+static uint16_t cli_tree_walk(cli_token * curTok, uint16_t descColumn)
+{
+	cli_tree_level_t stack[CLI_TREE_MAX_DEPTH];
+	cli_row_t        row;
+	uint16_t         width = 0;
+	int8_t           depth = 0;
+
+	stack[0].tok        = curTok;
+	stack[0].childIndex = 0;
+	row.len             = 0;
+
+	while (depth >= 0) {
+		cli_tree_level_t * level = &stack[depth];
+		cli_token *        child;
+
+		// Visit the token when entering its level
+		if (level->childIndex == 0) {
+			char     label[CLI_LABEL_LENGTH];
+			uint16_t textLen = cli_get_label(level->tok, label);
+
+			if (descColumn == 0) {
+				if ((CLI_TREE_INDENT_LEN * depth + textLen) > width) {
+					width = CLI_TREE_INDENT_LEN * depth + textLen;
+				}
+			} else {
+				for (int8_t i = 0; i < depth; ++i) {
+					cli_row_append(&row, CLI_TREE_INDENT, CLI_TREE_INDENT_LEN);
+				}
+				cli_row_append(&row, label, textLen);
+				cli_row_pad(&row, descColumn);
+				cli_row_append_desc(&row, level->tok->desc);
+				cli_row_append(&row, "\n\r", 2);
+				cli_row_flush(&row);
+			}
+		}
+
+		// Next child, removals leave holes with CLI_CONCURRENT_READERS
+		child = NULL;
+		while ((child == NULL) && (level->childIndex < CLI_MAX_CHILDS)) {
+			child = cli_get_child(level->tok, level->childIndex++);
+		}
+		if ((child == NULL) || (depth == (CLI_TREE_MAX_DEPTH - 1))) {
+			--depth;
+			continue;
+		}
+		stack[depth + 1].tok        = child;
+		stack[depth + 1].childIndex = 0;
+		++depth;
+	}
+	return width;
 }
 
 /**
@@ -67,587 +513,3258 @@ static void cli_print_token_tree(cli_token * curTok)
  */
 static void cli_print_token(cli_token * curTok)
 {
-	CLI_PRINTF("\t%s\t%s\n\r", curTok->text, curTok->desc);
+	cli_row_t row;
+	char      label[CLI_LABEL_LENGTH];
+
+	row.len = 0;
+	cli_row_append(&row, "\t", 1);
+	cli_row_append(&row, label, cli_get_label(curTok, label));
+	cli_row_append(&row, "\t", 1);
+	cli_row_append_desc(&row, curTok->desc);
+	cli_row_append(&row, "\n\r", 2);
+	cli_row_flush(&row);
 }
 
 // ===================
 //      STATIC
 // ===================
 
+#if (CLI_STACK_PROBE_LENGTH > 0)
 /**
- * @brief Tell if given token is a leaf
- * @details A leaf is a token with no children
- *
- * @param curTok Pointer
- * @return boolean
+ * @brief Fill the stack below the caller with a pattern
+ * @details Called right before the measured function, from the same function,
+ * so that the measured function uses the painted bytes
  */
-static bool cli_is_token_a_leaf(cli_token * curTok)
+static CLI_NOINLINE void cli_stack_paint(void)
 {
-	return curTok->isLeaf == true;
+	volatile uint8_t probe[CLI_STACK_PROBE_LENGTH];
+
+	for (uint16_t i = 0; i < sizeof(probe); ++i) {
+		probe[i] = CLI_STACK_PATTERN;
+	}
 }
 
 /**
- * @brief Give the usage for a specified token
+ * @brief Give how many painted bytes were used since cli_stack_paint()
+ * @details Called right after the measured function. The stack grows down
+ * so the deepest byte used is the first one not matching the pattern.
  *
- * @param curTok Pointer
+ * @return Number of bytes (Approximate, saturates at CLI_STACK_PROBE_LENGTH)
  */
-static void cli_usage(cli_token * curTok)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized" // Reading what was left on the stack is the point
+#if !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+static CLI_NOINLINE uint16_t cli_stack_measure(void)
 {
-	// Not the same header if root
-	CLI_PRINTF("Usage");
-	if (curTok == cli_get_root_token()) {
-		CLI_PRINTF(":\n\r");
-	} else {
-		CLI_PRINTF(" for \"%s\":\n\r", curTok->text);
-	}
+	volatile uint8_t probe[CLI_STACK_PROBE_LENGTH];
+	uint16_t         i;
 
-	// Incase of leaf, we just print itself with its description
-	if (cli_is_token_a_leaf(curTok)) {
-		cli_print_token(curTok);
-	} else {
-		// Print all child descriptions
-		for (uint8_t i = 0; i < CLI_MAX_CHILDS; ++i) {
-			if (curTok->childs[i] == NULL) {
-				continue;
-			}
-			cli_print_token(curTok->childs[i]);
+	for (i = 0; i < sizeof(probe); ++i) {
+		if (probe[i] != CLI_STACK_PATTERN) {
+			break;
 		}
 	}
+	return sizeof(probe) - i;
 }
+#pragma GCC diagnostic pop
+#endif
 
 /**
- * @brief Find the last valid token that match the command texts
+ * @brief Print the options of a leaf with their description
  *
- * @param cmdText Array of char pointer : [0] -> "word1\0", [1] -> "word2\0",
- * etc.
- * @param cmdTextCount Number of element in cmdText
- * @param curTok Returned pointer
- * @return depth abs(depth): Number of valid tokens, <0: token abs(depth) + 1 is not valid
+ * @param curTok Pointer
  */
-static int cli_find_last_valid_token(char * cmdText[], uint8_t cmdTextCount, cli_token ** curTok)
+static void cli_print_options(cli_token * curTok)
 {
-	int depth = 0;
-
-	DPRINTF(FINDER, "- Entering\n\r");
-
-	// Begin at root
-	(*curTok) = cli_get_root_token();
-
-	for (uint8_t i = 0; i < cmdTextCount; ++i) {
-		uint8_t childIndex;
-
-		// Search text into tokens
-		for (childIndex = 0; childIndex < CLI_MAX_CHILDS; ++childIndex) {
-			// Filter out empty childs
-			if ((*curTok)->childs[childIndex] == NULL) {
-				continue;
-			}
-			DPRINTF(FINDER, "Looking child: %s\n\r", (*curTok)->childs[childIndex]->text);
-
-			if (strncmp((*curTok)->childs[childIndex]->text, cmdText[i], CLI_MAX_TEXT_LEN) == 0) {
-				// Found it !
-				(*curTok) = (*curTok)->childs[childIndex];
-				++depth;
-				DPRINTF(FINDER, "Identified child %s (%u)\n\r", (*curTok)->text, childIndex);
-				break;
-			}
+	for (uint8_t i = 0; i < curTok->optionCount; ++i) {
+		const cli_option_t * option = cli_get_option_def(curTok, i);
+		cli_row_t            row;
+		char                 shortText[2] = { option->shortName, '\0' };
+
+		row.len = 0;
+		cli_row_append(&row, "\t", 1);
+		if (option->shortName != '\0') {
+			cli_row_append(&row, "-", 1);
+			cli_row_append(&row, shortText, 1);
+			cli_row_append(&row, (option->longName != NULL) ? ", " : "", (option->longName != NULL) ? 2 : 0);
 		}
-
-		// Check not found
-		if (childIndex >= CLI_MAX_CHILDS) {
-			DPRINTF(FINDER, "- failed\n\r");
-			return -depth; // Negative depth: depth first tokens are valid but not (depth+1)
+		if (option->longName != NULL) {
+			cli_row_append(&row, "--", 2);
+			cli_row_append(&row, option->longName, strlen(option->longName));
 		}
+		cli_row_append(&row, "\t", 1);
+		cli_row_append_desc(&row, option->desc);
+		cli_row_append(&row, "\n\r", 2);
+		cli_row_flush(&row);
+	}
+}
 
-		// Check arguments - If this child has arguments, remaining cmdText should
-		// be arguments
-		if (((*curTok)->mandatoryArgc + (*curTok)->optionalArgc) > 0) {
-			DPRINTF(FINDER, "- Next must be arguments...\n\r");
-			break;
+/**
+ * @brief Give a token and all its subtree back to the free list
+ *
+ * @param curTok Pointer, no reader can reach it anymore
+ */
+static void cli_release_token(cli_token * curTok)
+{
+	for (uint8_t i = 0; i < CLI_MAX_CHILDS; ++i) {
+		cli_token * child = cli_get_child(curTok, i);
+
+		if (child != NULL) {
+			cli_release_token(child);
 		}
 	}
-	DPRINTF(FINDER, "- Leaving\n\r");
 
-	return depth;
+	memset(curTok, 0, sizeof(*curTok));
+	curTok->childs[0] = cli_link(cliFreeToken);
+	cliFreeToken      = curTok;
 }
 
 /**
- * @brief Get the children count of a token
+ * @brief Stop using a token and all its subtree
  *
- * @param parent Pointer
- * @return Number of children [0; CLI_MAX_CHILDS]
+ * @param curTok Pointer
  */
-static uint8_t cli_get_children_count(cli_token * parent)
+static void cli_forget_token(cli_token * curTok)
 {
-	uint8_t count = 0;
+	for (uint8_t i = 0; i < CLI_MAX_CHILDS; ++i) {
+		cli_token * child = cli_get_child(curTok, i);
 
-	for (int i = 0; i < CLI_MAX_CHILDS; ++i) {
-		if (parent->childs[i] != NULL) {
-			++count;
+		if (child != NULL) {
+			cli_forget_token(child);
 		}
 	}
-	return count;
+
+	cli_watch_remove_token(curTok);
+	cli_cache_invalidate(curTok);
+	curTok->generation = 0; // Contexts of sessions are left
 }
 
 /**
- * @brief Split a string by spaces into a list of strings
- *
- * @param cmdEdit Editable buffer "word1 word2 word3"
- * @param cmdText Array of char pointer : [0] -> "word1\0", [1] -> "word2\0",
- * etc.
+ * @brief Give a new generation to a token being added
  *
- * @return Number of cmdText found (Ex: 3)
+ * @param curTok Pointer
  */
-static uint8_t cli_parse_cmd_text(char * cmdEdit, char * cmdText[])
+static void cli_set_generation(cli_token * curTok)
 {
-	uint8_t cmdTextCount = 0;
-	char *  pCmd         = cmdEdit;
+	// 0 is kept for removed tokens
+	if (++cliTokenGeneration == 0) {
+		++cliTokenGeneration;
+	}
+	curTok->generation = cliTokenGeneration;
+}
 
-	DPRINTF(PARSER, "- Entering\n\r");
+#if (CLI_CONCURRENT_READERS == 1)
+/**
+ * @brief Free the removed subtrees no reader can still walk
+ * @details Readers entered at epoch e hold cliReaders[e & 1], the epoch is
+ * advanced when no reader of the previous one is left. A subtree removed at
+ * epoch e is unreachable for readers entering at epoch e + 1, it is freed once
+ * the epoch is e + 2 (The readers of epoch e left). Never waits for readers.
+ */
+static void cli_reclaim(void)
+{
+	unsigned int epoch   = atomic_load(&cliReadEpoch);
+	cli_token *  prevTok = NULL;
+	cli_token *  curTok  = cliRetired;
 
-	// Check empty strings
-	if ((*pCmd) == '\0') {
-		DPRINTF(PARSER, "- Nothing to parse\n\r");
-		return 0; // Empty string
+	for (uint8_t i = 0; i < 2; ++i) {
+		if (atomic_load(&cliReaders[(epoch + 1) & 1]) != 0) {
+			break;
+		}
+		atomic_store(&cliReadEpoch, ++epoch);
 	}
 
-	cmdText[0] = pCmd;
+	while (curTok != NULL) {
+		cli_token * nextTok = cli_get_link(curTok->retiredNext);
 
-	while (1) {
-		if ((*pCmd) == '\0') {
-			// To get count instead of index
-			++cmdTextCount;
-			break;
-		} else if ((*pCmd) == ' ') {
-			// All spaces must be replaced by ending string
-			*pCmd = '\0';
-			++pCmd;
-
-			// A new cmdText begins only if next character is not a space
-			// and to an ending line
-			// This allow user to put multiple spaces between cmdText and extra space
-			// at the end of the line
-			if (((*pCmd) != ' ') && (*pCmd) != '\0') {
-				++cmdTextCount;
-				cmdText[cmdTextCount] = pCmd;
-
-				// Check maximum
-				if (cmdTextCount >= CLI_CMD_MAX_TOKEN) {
-					CLI_PRINTF("Limit is reached (CLI_CMD_MAX_TOKEN = %d)\n\r", CLI_CMD_MAX_TOKEN);
-					return -1;
-				}
+		if ((epoch - curTok->retiredEpoch) >= 2) {
+			if (prevTok == NULL) {
+				cliRetired = nextTok;
+			} else {
+				prevTok->retiredNext = curTok->retiredNext;
 			}
+			cli_release_token(curTok);
 		} else {
-			++pCmd;
+			prevTok = curTok;
 		}
+		curTok = nextTok;
 	}
-
-	DEBUG_BLOC(PARSER)
-	{
-		cli_print_cmd_text(cmdText, cmdTextCount);
-		DPRINTF(PARSER, "- Leaving\n\r");
-	}
-
-	return cmdTextCount;
 }
+#endif
 
 /**
- * @brief Execute a command
+ * @brief Free a token and all its subtree
+ * @details With CLI_CONCURRENT_READERS, tokens stay untouched until the
+ * readers which may walk them left
  *
- * @param cmdText Array of char pointer : [0] -> "word1\0", [1] -> "word2\0",
- * etc.
- * @param cmdTextCount Number of element in cmdText
- * @return The callback return, -1: Error
+ * @param curTok Pointer, must be detached from its parent
  */
-static int cli_execute(char * cmdText[], int cmdTextCount)
+static void cli_free_token(cli_token * curTok)
 {
-	cli_token * curTok = cli_get_root_token();
-	int         depth;
-	char **     argv = NULL;
-	uint8_t     argc; // Number of argument given by user
+	cli_forget_token(curTok);
+
+	// Command IDs must be found again
+	++cliTreeVersion;
+
+#if (CLI_CONCURRENT_READERS == 1)
+	curTok->retiredEpoch = atomic_load(&cliReadEpoch);
+	curTok->retiredNext  = cli_link(cliRetired);
+	cliRetired           = curTok;
+	cli_reclaim();
+#else
+	cli_release_token(curTok);
+#endif
+}
 
-	// FIND TOKENS
-	depth = cli_find_last_valid_token(cmdText, cmdTextCount, &curTok);
-	if (depth <= 0) {
-		// -depth is the index of the first not valid token
-		// (+1 to get not valid, -1: because starts at 0)
-		CLI_PRINTF("Unknown command \"%s\"\n\r", cmdText[-depth]);
-		goto retFailed;
+/**
+ * @brief Free the children of a lazy token, its provider adds them again on next use
+ *
+ * @param curTok Pointer
+ */
+static void cli_lazy_release(cli_token * curTok)
+{
+	for (uint8_t i = 0; i < CLI_MAX_CHILDS; ++i) {
+		cli_token * child = cli_get_child(curTok, i);
+
+		if (child != NULL) {
+			curTok->childs[i] = 0;
+			cli_free_token(child);
+		}
 	}
+	curTok->isMaterialized = false;
+}
 
-	// Error if not a leaf
-	if (cli_is_token_a_leaf(curTok) == false) {
-		goto retFailed;
+/**
+ * @brief Tell if a token is on the path from root to another one
+ *
+ * @param curTok Pointer
+ * @param descendant Pointer, can be NULL
+ * @return boolean (true if both are the same)
+ */
+static bool cli_is_ancestor(cli_token * curTok, cli_token * descendant)
+{
+	for (; descendant != NULL; descendant = cli_get_parent(descendant)) {
+		if (descendant == curTok) {
+			return true;
+		}
 	}
+	return false;
+}
 
-	// Get the number of cmdText that are not tokens
-	// Compare this number to the number of mandatory arguments
-	// If there is more, they are considered as optional arguments
-	argc = cmdTextCount - depth;
-	if (argc < curTok->mandatoryArgc) {
-		CLI_PRINTF("This command takes %d mandatory argument !\n\r", curTok->mandatoryArgc);
-		goto retFailed;
+/**
+ * @brief Free the children of the least recently used lazy token
+ * @details Called when no token is free. The token being materialized
+ * and its ancestors are kept, nothing is freed while held (See cli_hold_lazy_tokens()).
+ *
+ * @return 0: Tokens were freed, -1: Nothing to evict
+ */
+static int cli_lazy_evict(void)
+{
+	cli_token * oldest = NULL;
+
+	if (cliLazyHeld) {
+		DPRINTF(FINDER, "Lazy tokens are held, nothing evicted\n\r");
+		return -1;
 	}
+	for (uint16_t i = 0; i < CLI_MAX_TOKEN_COUNT; ++i) {
+		cli_token * curTok = &cliTokens[i];
 
-	if (argc > (curTok->mandatoryArgc + curTok->optionalArgc)) {
-		if (curTok->optionalArgc == 0) {
-			CLI_PRINTF("This command takes no optional argument !\n\r");
-		} else {
-			CLI_PRINTF("This command takes only %d optional argument !\n\r", curTok->optionalArgc);
+		// Free tokens are never materialized
+		if ((curTok->isMaterialized == false) || (curTok->childs[0] == 0) || cli_is_ancestor(curTok, cliLazyPinned)) {
+			continue;
+		}
+		// Ages are compared so that the counter can wrap
+		if ((oldest == NULL) || ((uint16_t) (cliLazyClock - curTok->lastUse) > (uint16_t) (cliLazyClock - oldest->lastUse))) {
+			oldest = curTok;
 		}
-		goto retFailed;
 	}
 
-	// The first argument starts right after the last valid token
-	argv = &cmdText[depth];
-
-	// Check null callback
-	if (curTok->callback == NULL) {
-		CLI_PRINTF("No callback defined for this command !\n\r");
+	if (oldest == NULL) {
 		return -1;
 	}
+	DPRINTF(FINDER, "Evicting children of \"%s\"\n\r", oldest->text);
+	cli_lazy_release(oldest);
+	return 0;
+}
 
-	// Call the function eventually and return its value
-	return curTok->callback(argc, argv);
+/**
+ * @brief Make sure the provider of a lazy token added its children
+ *
+ * @param curTok Pointer
+ * @return 0: ok (Or not lazy), -1: The provider failed
+ */
+static int cli_materialize(cli_token * curTok)
+{
+	cli_token *    prevPinned = cliLazyPinned;
+	cli_provider_t provider   = cli_get_provider(curTok);
+	int            ret;
 
-	// Show usage and return error
-retFailed:
-	cli_usage(curTok);
-	return -1;
+	if (provider == NULL) {
+		return 0;
+	}
+	curTok->lastUse = ++cliLazyClock;
+	if (curTok->isMaterialized) {
+		return 0;
+	}
+
+	DPRINTF(FINDER, "Materializing \"%s\"\n\r", curTok->text);
+	cliLazyPinned = curTok;
+	ret           = provider(curTok);
+	cliLazyPinned = prevPinned;
+
+	if (ret != 0) {
+		DPRINTF(ERROR, "Provider of token \"%s\" failed\n\r", curTok->text);
+		cli_lazy_release(curTok);
+		return -1;
+	}
+	curTok->isMaterialized = true;
+	return 0;
 }
 
 /**
- * @brief Auto-complete a command or propose choice
+ * @brief Get the children count of a token
  *
- * @param cmdText Array of char pointer : [0] -> "word1\0", [1] -> "word2\0", etc.
- * @param cmdTextCount Number of element in cmdText
- * @return NULL: Either no alternative or more than one, >0: A pointer to the
- * only alternative possible (only the portion to write)
+ * @param parent Pointer
+ * @return Number of children [0; CLI_MAX_CHILDS]
  */
-static char * cli_autocomplete(char * cmdText[], uint8_t cmdTextCount)
+static uint8_t cli_get_children_count(cli_token * parent)
 {
-	cli_token * curTok             = cli_get_root_token();
-	cli_token * lastAlternativeTok = NULL;
-	uint8_t     lastCmdTextLen;
-	char *      lastCmdText;
-	uint8_t     alternatives   = 0;
-	char        emptyString[1] = "";
-	int         depth;
+	uint8_t count = 0;
 
-	// FIND TOKENS
-	// If all cmdText are recognized, there is no alternatives to give
-	// If depth == 0, the last recognized is root, we must propose alternatives
-	depth = cli_find_last_valid_token(cmdText, cmdTextCount, &curTok);
-	if (depth > 0) {
-		// There is no alternatives for leafs (We won't propose to complete arguments)
-		// So just print usage
-		if (cli_is_token_a_leaf(curTok)) {
-			CLI_PRINTF("\n\r"); // Go to next line before printing usage
-			cli_usage(curTok);
-			DPRINTF(AUTOC, "Last token is a leaf\n\r");
-			return NULL;
+	for (int i = 0; i < CLI_MAX_CHILDS; ++i) {
+		if (parent->childs[i] != 0) {
+			++count;
 		}
 	}
+	return count;
+}
 
-	// Shortcuts
-	if (cmdTextCount == depth) {
-		// Here, user tries to autocomplete a already completed token
-		// He actually wants all childs of this token
-		// Use empty string to match all childs
-		lastCmdText    = emptyString;
-		lastCmdTextLen = 0;
+/**
+ * @brief Tell if given token is a leaf
+ * @details A leaf is a token with no children, lazy tokens are never leaves
+ *
+ * @param curTok Pointer
+ * @return boolean
+ */
+static bool cli_is_token_a_leaf(cli_token * curTok)
+{
+	return (curTok->provider == 0) && (cli_get_children_count(curTok) == 0);
+}
+
+/**
+ * @brief Give the usage for a specified token
+ *
+ * @param curTok Pointer
+ */
+static void cli_usage(cli_token * curTok)
+{
+	// Not the same header if root
+	CLI_PRINTF("Usage");
+	if (curTok == cli_get_root_token()) {
+		CLI_PRINTF(":\n\r");
 	} else {
-		lastCmdText    = cmdText[cmdTextCount - 1];
-		lastCmdTextLen = strlen(lastCmdText);
+		CLI_PRINTF(" for \"%s\":\n\r", curTok->text);
 	}
 
-	// Do this in 2 states:
-	// 1. Count alternatives
-	// 2. Print them if more than 1
-	for (int state = 0; state < 2; ++state) {
-		// For all childs of the last valid token found...
-		for (int i = 0; i < CLI_MAX_CHILDS; ++i) {
-			if (curTok->childs[i] == NULL) {
+	// Incase of leaf, we just print itself with its description
+	if (cli_is_token_a_leaf(curTok)) {
+		cli_print_token(curTok);
+		cli_print_options(curTok);
+	} else {
+		// Print all child descriptions
+		for (uint8_t i = 0; i < CLI_MAX_CHILDS; ++i) {
+			cli_token * child = cli_get_child(curTok, i);
+
+			if (child == NULL) {
 				continue;
 			}
-			// Does the last text match this child ?
-			if (strncmp(lastCmdText, curTok->childs[i]->text, lastCmdTextLen) == 0) {
-				if (state == 0) {
-					++alternatives;
-					lastAlternativeTok = curTok->childs[i];
-				} else if (state == 1) {
-					cli_print_token(curTok->childs[i]);
+			cli_print_token(child);
+		}
+	}
+}
+
+/**
+ * @brief Tell if a pattern token matches a word
+ * @details The word must be the text of the token followed by a decimal
+ * number within [patternMin; patternMax] (Ex: "eth12" for "eth<0-47>")
+ *
+ * @param curTok Pattern token
+ * @param word Text typed by the user
+ * @return boolean
+ */
+static bool cli_is_pattern_matching(cli_token * curTok, const char * word)
+{
+	uint8_t  prefixLen = strlen(curTok->text);
+	uint32_t value     = 0;
+
+	if ((strncmp(curTok->text, word, prefixLen) != 0) || (word[prefixLen] == '\0')) {
+		return false;
+	}
+	for (word += prefixLen; *word != '\0'; ++word) {
+		// Checking before adding a digit prevents overflows
+		if ((*word < '0') || (*word > '9') || (value > curTok->patternMax)) {
+			return false;
+		}
+		value = value * 10 + (*word - '0');
+	}
+	return (value >= curTok->patternMin) && (value <= curTok->patternMax);
+}
+
+/**
+ * @brief Give the token a line is resolved from
+ * @details The context of the session in human mode, root otherwise. A first
+ * word starting with '/' is resolved from root, the '/' is skipped.
+ *
+ * @param cmdText Array of char pointer, cmdText[0] may be changed
+ * @param cmdTextCount Number of element in cmdText
+ * @return Pointer
+ */
+static cli_token * cli_get_start_token(char * cmdText[], uint8_t cmdTextCount)
+{
+	if ((cmdTextCount > 0) && (cmdText[0][0] == '/')) {
+		++cmdText[0];
+		return cli_get_root_token();
+	} else if (cliSession->mode != CLI_MODE_HUMAN) {
+		return cli_get_root_token();
+	}
+	return cli_get_context();
+}
+
+/**
+ * @brief Find the last valid token that match the command texts
+ *
+ * @param cmdText Array of char pointer : [0] -> "word1\0", [1] -> "word2\0",
+ * etc.
+ * @param cmdTextCount Number of element in cmdText
+ * @param curTok In: Token to begin at (See cli_get_start_token()), Out: Last valid token
+ * @return depth abs(depth): Number of valid tokens, <0: token abs(depth) + 1 is not valid
+ */
+static int cli_find_last_valid_token(char * cmdText[], uint8_t cmdTextCount, cli_token ** curTok)
+{
+	int depth = 0;
+
+	DPRINTF(FINDER, "- Entering\n\r");
+
+	for (uint8_t i = 0; i < cmdTextCount; ++i) {
+		cli_token * foundTok = NULL;
+		uint8_t     childIndex;
+
+		// Search text into tokens
+		for (childIndex = 0; childIndex < CLI_MAX_CHILDS; ++childIndex) {
+			cli_token * child = cli_get_child(*curTok, childIndex);
+
+			// Filter out empty childs
+			if (child == NULL) {
+				continue;
+			}
+			DPRINTF(FINDER, "Looking child: %s\n\r", child->text);
+
+			// Exact texts are preferred to the first matching pattern
+			if (child->isPattern) {
+				if ((foundTok == NULL) && cli_is_pattern_matching(child, cmdText[i])) {
+					foundTok = child;
 				}
+			} else if (strncmp(child->text, cmdText[i], CLI_MAX_TEXT_LEN) == 0) {
+				foundTok = child;
+				break;
 			}
 		}
 
-		// Choose what to do according to the number
-		// of alternatives found on state 0
-		if (state == 0) {
-			if (alternatives == 0) {
-				break; // Nothing to do, don't bother with state 1
-			} else if (alternatives == 1) {
-				// Return the pointer of the portion to write
-				return lastAlternativeTok->text + lastCmdTextLen;
+		// Check not found
+		if (foundTok == NULL) {
+			DPRINTF(FINDER, "- failed\n\r");
+			return -depth; // Negative depth: depth first tokens are valid but not (depth+1)
+		}
+
+		// Found it !
+		(*curTok) = foundTok;
+		++depth;
+		cli_materialize(*curTok); // Lazy children are added when entered
+		DPRINTF(FINDER, "Identified child %s\n\r", (*curTok)->text);
+
+		// Check arguments - Remaining cmdText of a leaf are arguments or options
+		if (cli_is_token_a_leaf(*curTok)) {
+			DPRINTF(FINDER, "- Next must be arguments...\n\r");
+			break;
+		}
+	}
+	DPRINTF(FINDER, "- Leaving\n\r");
+
+	return depth;
+}
+
+/**
+ * @brief Tell if a character separates words
+ *
+ * @param c Character
+ * @return boolean
+ */
+static bool cli_is_space(char c)
+{
+	return (c == ' ') || (c == '\t');
+}
+
+/**
+ * @brief Split a line into words, in place and in a single pass
+ * @details Words are separated by spaces or tabs. Quotes ("..." or '...')
+ * keep spaces in a word and backslash escapes the next character (except
+ * inside '...'). Quotes and backslashes are removed by moving the end of the
+ * word backward so each word is a '\0' terminated slice of cmdEdit.
+ *
+ * @param cmdEdit Editable buffer "word1 'word 2' word\ 3"
+ * @param len Length of cmdEdit
+ * @param cmdText Array of char pointer : [0] -> "word1\0", [1] -> "word 2\0",
+ * etc.
+ *
+ * @return Number of cmdText found (Ex: 3), <0: CLI_PARSE_ERR_*
+ */
+static int cli_parse_cmd_text(char * cmdEdit, uint16_t len, char * cmdText[])
+{
+	const char * pIn          = cmdEdit;
+	const char * pEnd         = cmdEdit + len;
+	char *       pOut         = cmdEdit;
+	uint8_t      state        = CLI_PARSE_SPACE;
+	int          cmdTextCount = 0;
+	uintptr_t    chunk;
+	char         c;
+
+	DPRINTF(PARSER, "- Entering\n\r");
+
+	while (1) {
+		if (state == CLI_PARSE_SPACE) {
+			// Skip runs of spaces a machine word at a time, then byte per byte
+			while ((pEnd - pIn) >= (int) sizeof(chunk)) {
+				memcpy(&chunk, pIn, sizeof(chunk));
+				if (chunk != CLI_PARSE_SPACES) {
+					break;
+				}
+				pIn += sizeof(chunk);
+			}
+			while ((pIn < pEnd) && cli_is_space(*pIn)) {
+				++pIn;
+			}
+			if (pIn >= pEnd) {
+				break;
+			}
+
+			// A new word begins
+			if (cmdTextCount >= CLI_CMD_MAX_TOKEN) {
+				return CLI_PARSE_ERR_TOO_MANY;
+			}
+			cmdText[cmdTextCount++] = pOut;
+			state                   = CLI_PARSE_WORD;
+		} else if (pIn >= pEnd) {
+			break;
+		}
+
+		c = *pIn++;
+		switch (state) {
+		case CLI_PARSE_WORD:
+			if (cli_is_space(c)) {
+				*pOut++ = '\0';
+				state   = CLI_PARSE_SPACE;
+				break;
+			} else if (c == '"') {
+				state = CLI_PARSE_DQUOTE;
+				break;
+			} else if (c == '\'') {
+				state = CLI_PARSE_SQUOTE;
+				break;
+			}
+			// Fall through
+		case CLI_PARSE_DQUOTE:
+			if ((state == CLI_PARSE_DQUOTE) && (c == '"')) {
+				state = CLI_PARSE_WORD;
+			} else if (c == '\\') {
+				if (pIn >= pEnd) {
+					return CLI_PARSE_ERR_ESCAPE;
+				}
+				*pOut++ = *pIn++;
 			} else {
-				CLI_PRINTF("\n\r"); // Go to next line before printing alternatives
-				continue;
+				*pOut++ = c;
+			}
+			break;
+		default: // CLI_PARSE_SQUOTE
+			if (c == '\'') {
+				state = CLI_PARSE_WORD;
+			} else {
+				*pOut++ = c;
 			}
+			break;
 		}
 	}
 
-	return NULL; // No unique alternative
+	if ((state == CLI_PARSE_DQUOTE) || (state == CLI_PARSE_SQUOTE)) {
+		return CLI_PARSE_ERR_QUOTE;
+	}
+	*pOut = '\0'; // End the last word
+
+	DEBUG_BLOC(PARSER)
+	{
+		cli_print_cmd_text(cmdText, cmdTextCount);
+		DPRINTF(PARSER, "- Leaving\n\r");
+	}
+
+	return cmdTextCount;
+}
+
+/**
+ * @brief Explain why a line can't be split into words
+ *
+ * @param error CLI_PARSE_ERR_*
+ */
+static void cli_print_parse_error(int error)
+{
+	switch (error) {
+	case CLI_PARSE_ERR_TOO_MANY:
+		CLI_PRINTF("Too many words (CLI_CMD_MAX_TOKEN = %d)\n\r", CLI_CMD_MAX_TOKEN);
+		break;
+	case CLI_PARSE_ERR_QUOTE:
+		CLI_PRINTF("Missing closing quote\n\r");
+		break;
+	default:
+		CLI_PRINTF("Missing character after \\\n\r");
+		break;
+	}
+}
+
+/**
+ * @brief Find an option of a leaf
+ *
+ * @param curTok Leaf
+ * @param shortName Letter of the option (Used if longName is NULL)
+ * @param longName Name of the option, NULL to find shortName
+ * @return Index of the option, -1: Not found
+ */
+static int cli_find_option(cli_token * curTok, char shortName, const char * longName)
+{
+	for (uint8_t i = 0; i < curTok->optionCount; ++i) {
+		const cli_option_t * option = cli_get_option_def(curTok, i);
+
+		if (longName != NULL) {
+			if ((option->longName != NULL) && (strcmp(option->longName, longName) == 0)) {
+				return i;
+			}
+		} else if (option->shortName == shortName) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/**
+ * @brief Find the options in the words following a leaf and remove them
+ * @details Options are parsed in one pass into cliOptionValues. "--" ends
+ * the options and "-" or a word like "-5" is an argument. Words of leaves
+ * without options are all arguments.
+ *
+ * @param curTok Leaf
+ * @param words Words following the leaf, only arguments are kept
+ * @param count Number of words
+ * @return Number of arguments, -1: Unknown option
+ */
+static int cli_parse_options(cli_token * curTok, char * words[], uint8_t count)
+{
+	uint8_t argc    = 0;
+	bool    isEnded = (curTok->optionCount == 0);
+
+	memset(&cliOptionValues, 0, sizeof(cliOptionValues));
+
+	for (uint8_t i = 0; i < count; ++i) {
+		char * word = words[i];
+		int    index;
+
+		if (isEnded || (word[0] != '-') || (word[1] == '\0') || ((word[1] >= '0') && (word[1] <= '9'))) {
+			words[argc++] = word;
+			continue;
+		}
+		if (strcmp(word, "--") == 0) {
+			isEnded = true;
+			continue;
+		}
+
+		// "--name" or "-abc"
+		for (char * c = word + 1; *c != '\0'; ++c) {
+			index = (word[1] == '-') ? cli_find_option(curTok, '\0', word + 2) : cli_find_option(curTok, *c, NULL);
+			if (index < 0) {
+				CLI_PRINTF("Unknown option \"%s\"\n\r", word);
+				return -1;
+			}
+
+			cliOptionValues.mask |= 1UL << index;
+			if ((cli_get_option_def(curTok, index)->isCounted == false) || (cliOptionValues.counts[index] == UINT8_MAX)) {
+				cliOptionValues.counts[index] |= 1;
+			} else {
+				++cliOptionValues.counts[index];
+			}
+
+			if (word[1] == '-') {
+				break;
+			}
+		}
+	}
+	return argc;
+}
+
+/**
+ * @brief Find the leaf of a command and check its arguments
+ * @details Errors are printed with the usage
+ *
+ * @param cmdText Array of char pointer : [0] -> "word1\0", [1] -> "word2\0",
+ * etc.
+ * @param cmdTextCount Number of element in cmdText, options are removed
+ * @param curTok Returned leaf
+ * @return Index of the first argument in cmdText (Words matched by pattern
+ * tokens first), -1: Error
+ */
+static int cli_resolve(char * cmdText[], int * cmdTextCount, cli_token ** curTok)
+{
+	cli_token * matchTok;
+	int         depth;
+	int         argIndex;
+	uint8_t     argc; // Number of argument given by user
+
+	// FIND TOKENS
+	*curTok = cli_get_start_token(cmdText, *cmdTextCount);
+	depth   = cli_find_last_valid_token(cmdText, *cmdTextCount, curTok);
+	if (depth <= 0) {
+		// -depth is the index of the first not valid token
+		// (+1 to get not valid, -1: because starts at 0)
+		CLI_PRINTF("Unknown command \"%s\"\n\r", cmdText[-depth]);
+		goto retFailed;
+	}
+
+	// Error if not a leaf
+	if (cli_is_token_a_leaf(*curTok) == false) {
+		goto retFailed;
+	}
+
+	// Get the number of cmdText that are neither tokens nor options
+	// Compare this number to the number of mandatory arguments
+	// If there is more, they are considered as optional arguments
+	argIndex = cli_parse_options(*curTok, &cmdText[depth], *cmdTextCount - depth);
+	if (argIndex < 0) {
+		goto retFailed;
+	}
+	argc          = argIndex;
+	*cmdTextCount = depth + argc;
+	if (argc < (*curTok)->mandatoryArgc) {
+		CLI_PRINTF("This command takes %d mandatory argument !\n\r", (*curTok)->mandatoryArgc);
+		goto retFailed;
+	}
+
+	if (argc > ((*curTok)->mandatoryArgc + (*curTok)->optionalArgc)) {
+		if ((*curTok)->optionalArgc == 0) {
+			CLI_PRINTF("This command takes no optional argument !\n\r");
+		} else {
+			CLI_PRINTF("This command takes only %d optional argument !\n\r", (*curTok)->optionalArgc);
+		}
+		goto retFailed;
+	}
+
+	// Check null callback
+	if (cli_get_callback(*curTok) == NULL) {
+		CLI_PRINTF("No callback defined for this command !\n\r");
+		return -1;
+	}
+
+	// The first argument starts right after the last valid token
+	// Words matched by pattern tokens are moved right before it
+	argIndex = depth;
+	matchTok = *curTok;
+	for (int i = depth - 1; i >= 0; --i) {
+		if (matchTok->isPattern) {
+			cmdText[--argIndex] = cmdText[i];
+		}
+		matchTok = cli_get_parent(matchTok);
+	}
+	CLI_TRACE(RESOLVE, cli_get_token_index(*curTok), *cmdTextCount - argIndex);
+	return argIndex;
+
+	// Show usage and return error
+retFailed:
+	cli_usage(*curTok);
+	return -1;
+}
+
+#if (CLI_CACHE_ENTRIES > 0)
+/**
+ * @brief Output callback used while the output of a cached leaf is copied
+ * @details Bytes go to the output anyway, the copy is dropped if it gets too long
+ * @see cli_output_callback_t
+ *
+ * @param str Bytes to write
+ * @param len Number of bytes
+ * @return Return of the output
+ */
+static int cli_cache_output(const char * str, uint16_t len)
+{
+	cli_cache_entry_t * entry = cliCacheFilling;
+	int                 ret;
+
+	if (entry != NULL) {
+		if (len > sizeof(entry->output) - entry->len) {
+			cliCacheFilling = NULL;
+		} else {
+			memcpy(entry->output + entry->len, str, len);
+			entry->len += len;
+		}
+	}
+
+	cli_output_set_callback(cliCacheOutput);
+	ret = cli_output_write(str, len);
+	cli_output_set_callback(&cli_cache_output);
+	return ret;
+}
+
+/**
+ * @brief Find the output of a call in the cache
+ *
+ * @param curTok Leaf
+ * @param args Arguments, each one '\0' terminated
+ * @param argsLen Number of bytes of args
+ * @param isFound Set to true if the entry holds the output of this call
+ * @return The entry holding the output, else the one to fill (Free or
+ * oldest), NULL if they are all being filled
+ */
+static cli_cache_entry_t * cli_cache_find(cli_token * curTok, const char * args, uint8_t argsLen, bool * isFound)
+{
+	cli_cache_entry_t * victim = NULL;
+
+	*isFound = false;
+	for (uint8_t i = 0; i < CLI_CACHE_ENTRIES; ++i) {
+		cli_cache_entry_t * entry = &cliCache[i];
+
+		if ((entry->state == CLI_CACHE_FILLING) || (entry->state == CLI_CACHE_STALE)) {
+			continue;
+		}
+		if ((entry->state == CLI_CACHE_VALID) && (entry->token == curTok) && (entry->argsLen == argsLen) &&
+			(memcmp(entry->args, args, argsLen) == 0) && (memcmp(&entry->options, &cliOptionValues, sizeof(cliOptionValues)) == 0)) {
+			*isFound = true;
+			return entry;
+		}
+		if ((victim == NULL) || ((victim->state != CLI_CACHE_FREE) &&
+								 ((entry->state == CLI_CACHE_FREE) || ((cliTickMs - entry->time) > (cliTickMs - victim->time))))) {
+			victim = entry;
+		}
+	}
+	return victim;
+}
+
+/**
+ * @brief Call the callback of a cached leaf, or write the output of a recent call
+ *
+ * @param curTok Leaf
+ * @param argc Argument count
+ * @param argv Argument values
+ * @return The callback return
+ */
+static int cli_cache_call(cli_token * curTok, uint8_t argc, char * argv[])
+{
+	cli_cache_entry_t *   prevFilling = cliCacheFilling;
+	cli_output_callback_t prevOutput  = cliCacheOutput;
+	cli_callback_t        callback    = cli_get_callback(curTok);
+	cli_cache_entry_t *   entry;
+	char                  args[CLI_CMD_MAX_LEN];
+	uint16_t              argsLen = 0;
+	bool                  isFound;
+	int                   ret;
+
+	// Key is the arguments and the options
+	for (uint8_t i = 0; i < argc; ++i) {
+		uint16_t len = strlen(argv[i]) + 1;
+
+		if (argsLen + len > sizeof(args)) {
+			return callback(argc, argv); // Arguments of a binary request can be longer than a line
+		}
+		memcpy(args + argsLen, argv[i], len);
+		argsLen += len;
+	}
+
+	entry = cli_cache_find(curTok, args, argsLen, &isFound);
+	if (isFound && ((cliTickMs - entry->time) < curTok->cacheTtl)) {
+		cli_output_write(entry->output, entry->len);
+		return entry->status;
+	} else if (entry == NULL) {
+		return callback(argc, argv);
+	}
+
+	entry->token   = curTok;
+	entry->state   = CLI_CACHE_FILLING;
+	entry->argsLen = argsLen;
+	entry->len     = 0;
+	entry->time    = cliTickMs;
+	entry->options = cliOptionValues;
+	memcpy(entry->args, args, argsLen);
+
+	// Copy the output while it is written
+	cliCacheFilling = entry;
+	cliCacheOutput  = cli_output_get_callback();
+	cli_output_set_callback(&cli_cache_output);
+	ret = callback(argc, argv);
+	cli_output_set_callback(cliCacheOutput);
+
+	// A streamed output or an upload continue after the callback
+	if ((cliCacheFilling == entry) && (entry->state == CLI_CACHE_FILLING) && (cliSession->stream == NULL) && (cliSession->upload == NULL)) {
+		entry->state  = CLI_CACHE_VALID;
+		entry->status = ret;
+	} else {
+		entry->state = CLI_CACHE_FREE;
+	}
+	cliCacheFilling = prevFilling;
+	cliCacheOutput  = prevOutput;
+	return ret;
+}
+#endif
+
+/**
+ * @brief Call the callback of a leaf, traced
+ *
+ * @param curTok Leaf, with a callback
+ * @param argc Argument count
+ * @param argv Argument values
+ * @param isCacheUsed false: The callback is called even if the leaf is cached
+ * @return The callback return
+ */
+static int cli_call_traced(cli_token * curTok, uint8_t argc, char * argv[], bool isCacheUsed)
+{
+	int ret;
+
+	CLI_TRACE(CB_START, cli_get_token_index(curTok), argc);
+#if (CLI_CACHE_ENTRIES > 0)
+	// An image may be imported before the first cli_tick()
+	if (isCacheUsed && (curTok->cacheTtl > 0) && cliIsTicked) {
+		ret = cli_cache_call(curTok, argc, argv);
+	} else
+#endif
+	{
+		ret = cli_get_callback(curTok)(argc, argv);
+	}
+	CLI_TRACE(CB_END, cli_get_token_index(curTok), ret);
+	return ret;
+}
+
+/**
+ * @brief Call the callback of a leaf
+ *
+ * @param curTok Leaf, with a callback
+ * @param argc Argument count
+ * @param argv Argument values
+ * @return The callback return
+ */
+static int cli_call(cli_token * curTok, uint8_t argc, char * argv[])
+{
+	return cli_call_traced(curTok, argc, argv, true);
+}
+
+/**
+ * @brief Change the context of the selected session if the line asks to
+ * @details ".." (or "exit" out of root) goes up, "/" goes to root and a
+ * token which is not a leaf, given alone, is entered. Tokens matched by a
+ * pattern can't be entered, the number would be lost.
+ *
+ * @param cmdText Array of char pointer : [0] -> "word1\0", [1] -> "word2\0",
+ * etc.
+ * @param cmdTextCount Number of element in cmdText
+ * @return true: Context changed, false: The line is a command
+ */
+static bool cli_enter_context(char * cmdText[], int cmdTextCount)
+{
+	char *      words[CLI_CMD_MAX_TOKEN]; // Copy, cli_get_start_token() may change the first word
+	cli_token * context = cli_get_context();
+	cli_token * startTok;
+	cli_token * curTok;
+
+	if (cmdTextCount == 1) {
+		if (strcmp(cmdText[0], "/") == 0) {
+			cli_set_context(NULL);
+			return true;
+		} else if ((context != cli_get_root_token()) && ((strcmp(cmdText[0], "..") == 0) || (strcmp(cmdText[0], "exit") == 0))) {
+			cli_set_context(cli_get_parent(context));
+			return true;
+		}
+	}
+
+	memcpy(words, cmdText, cmdTextCount * sizeof(words[0]));
+	startTok = cli_get_start_token(words, cmdTextCount);
+	curTok   = startTok;
+	if ((cli_find_last_valid_token(words, cmdTextCount, &curTok) != cmdTextCount) || cli_is_token_a_leaf(curTok)) {
+		return false;
+	}
+	for (cli_token * matchTok = curTok; matchTok != startTok; matchTok = cli_get_parent(matchTok)) {
+		if (matchTok->isPattern) {
+			return false;
+		}
+	}
+	cli_set_context(curTok);
+	return true;
+}
+
+/**
+ * @brief Execute a command
+ *
+ * @param cmdText Array of char pointer : [0] -> "word1\0", [1] -> "word2\0",
+ * etc.
+ * @param cmdTextCount Number of element in cmdText
+ * @return The callback return, -1: Error
+ */
+static int cli_execute(char * cmdText[], int cmdTextCount)
+{
+	cli_token * curTok;
+	int         argIndex;
+
+	// Lines typed by a human can move in the tree
+	if ((cliSession->mode == CLI_MODE_HUMAN) && cli_enter_context(cmdText, cmdTextCount)) {
+		return 0;
+	}
+
+	argIndex = cli_resolve(cmdText, &cmdTextCount, &curTok);
+	if (argIndex < 0) {
+		return -1;
+	}
+
+	// Call the function eventually and return its value
+	return cli_call(curTok, cmdTextCount - argIndex, &cmdText[argIndex]);
+}
+
+/**
+ * @brief Auto-complete a long option or print the matching ones
+ *
+ * @param curTok Leaf
+ * @param name Beginning of the name, after "--"
+ * @return NULL: Either no alternative or more than one, >0: The portion to write
+ */
+static char * cli_autocomplete_option(cli_token * curTok, const char * name)
+{
+	const char * lastName     = NULL;
+	uint8_t      nameLen      = strlen(name);
+	uint8_t      alternatives = 0;
+
+	for (int state = 0; state < 2; ++state) {
+		for (uint8_t i = 0; i < curTok->optionCount; ++i) {
+			const char * longName = cli_get_option_def(curTok, i)->longName;
+
+			if ((longName == NULL) || (strncmp(name, longName, nameLen) != 0)) {
+				continue;
+			}
+			if (state == 0) {
+				++alternatives;
+				lastName = longName;
+			} else {
+				CLI_PRINTF("\t--%s\n\r", longName);
+			}
+		}
+
+		if (alternatives == 0) {
+			break;
+		} else if (alternatives == 1) {
+			return (char *) lastName + nameLen;
+		} else if (state == 0) {
+			CLI_PRINTF("\n\r"); // Go to next line before printing alternatives
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Auto-complete a command or propose choice
+ *
+ * @param cmdText Array of char pointer : [0] -> "word1\0", [1] -> "word2\0", etc.
+ * @param cmdTextCount Number of element in cmdText
+ * @param isWordEnded Returned, tell if a space can follow the alternative
+ * @return NULL: Either no alternative or more than one, >0: A pointer to the
+ * only alternative possible (only the portion to write)
+ */
+static char * cli_autocomplete(char * cmdText[], uint8_t cmdTextCount, bool * isWordEnded)
+{
+	cli_token * curTok             = cli_get_start_token(cmdText, cmdTextCount);
+	cli_token * lastAlternativeTok = NULL;
+	uint8_t     lastCmdTextLen;
+	char *      lastCmdText;
+	uint8_t     alternatives   = 0;
+	char        emptyString[1] = "";
+	int         depth;
+
+	// FIND TOKENS
+	// If all cmdText are recognized, there is no alternatives to give
+	// If depth == 0, the last recognized is root, we must propose alternatives
+	depth = cli_find_last_valid_token(cmdText, cmdTextCount, &curTok);
+	if (depth > 0) {
+		// There is no alternatives for leafs (We won't propose to complete arguments)
+		// So just print usage
+		if (cli_is_token_a_leaf(curTok)) {
+			// Except long options
+			if ((cmdTextCount > depth) && (strncmp(cmdText[cmdTextCount - 1], "--", 2) == 0)) {
+				return cli_autocomplete_option(curTok, cmdText[cmdTextCount - 1] + 2);
+			}
+			CLI_PRINTF("\n\r"); // Go to next line before printing usage
+			cli_usage(curTok);
+			DPRINTF(AUTOC, "Last token is a leaf\n\r");
+			return NULL;
+		}
+	}
+
+	// Shortcuts
+	if (cmdTextCount == depth) {
+		// Here, user tries to autocomplete a already completed token
+		// He actually wants all childs of this token
+		// Use empty string to match all childs
+		lastCmdText    = emptyString;
+		lastCmdTextLen = 0;
+	} else {
+		lastCmdText    = cmdText[cmdTextCount - 1];
+		lastCmdTextLen = strlen(lastCmdText);
+	}
+
+	// Do this in 2 states:
+	// 1. Count alternatives
+	// 2. Print them if more than 1
+	for (int state = 0; state < 2; ++state) {
+		// For all childs of the last valid token found...
+		for (int i = 0; i < CLI_MAX_CHILDS; ++i) {
+			cli_token * child = cli_get_child(curTok, i);
+
+			if (child == NULL) {
+				continue;
+			}
+			// Does the last text match this child ?
+			if (strncmp(lastCmdText, child->text, lastCmdTextLen) == 0) {
+				if (state == 0) {
+					++alternatives;
+					lastAlternativeTok = child;
+				} else if (state == 1) {
+					cli_print_token(child);
+				}
+			}
+		}
+
+		// Choose what to do according to the number
+		// of alternatives found on state 0
+		if (state == 0) {
+			if (alternatives == 0) {
+				break; // Nothing to do, don't bother with state 1
+			} else if (alternatives == 1) {
+				// Return the pointer of the portion to write
+				// The number of a pattern is still to be typed
+				*isWordEnded = (lastAlternativeTok->isPattern == false);
+				return lastAlternativeTok->text + lastCmdTextLen;
+			} else {
+				CLI_PRINTF("\n\r"); // Go to next line before printing alternatives
+				continue;
+			}
+		}
+	}
+
+	return NULL; // No unique alternative
+}
+
+/**
+ * @brief Output callback used while the output is captured
+ * @see cli_output_callback_t
+ *
+ * @param str Bytes to capture
+ * @param len Number of bytes
+ * @return Number of bytes captured
+ */
+static int cli_capture_output(const char * str, uint16_t len)
+{
+	uint16_t freeLen = cliCapture->size - cliCapture->len;
+
+	if (cliCapture->chunk != NULL) {
+		if (cliCapture->isTruncated) {
+			return -1;
+		} else if (cliCapture->chunk(str, len) < 0) {
+			cliCapture->isTruncated = true; // Stop streamed output too
+			return -1;
+		}
+		return len;
+	}
+
+	if (len > freeLen) {
+		cliCapture->isTruncated = true;
+		len                     = freeLen;
+	}
+	memcpy(cliCapture->buffer + cliCapture->len, str, len);
+	cliCapture->len += len;
+	return len;
+}
+
+/**
+ * @brief Start to capture the output into a buffer
+ * @details Captures can be nested, cli_capture_stop() restores the previous one
+ *
+ * @param capture Pointer, must stay valid until cli_capture_stop()
+ * @param buffer Where bytes are written
+ * @param size Size of buffer
+ */
+static void cli_capture_start(cli_capture_t * capture, char * buffer, uint16_t size)
+{
+	capture->buffer      = buffer;
+	capture->size        = size;
+	capture->len         = 0;
+	capture->isTruncated = false;
+	capture->chunk       = NULL;
+	capture->prevCapture = cliCapture;
+	capture->prevOutput  = cli_output_get_callback();
+
+	cliCapture = capture;
+	cli_output_set_callback(&cli_capture_output);
+}
+
+/**
+ * @brief Stop to capture the output
+ *
+ * @param capture Pointer given to cli_capture_start()
+ */
+static void cli_capture_stop(cli_capture_t * capture)
+{
+	cli_output_set_callback(capture->prevOutput);
+	cliCapture = capture->prevCapture;
+
+	if (capture->isTruncated && (capture->chunk == NULL)) {
+		DPRINTF(ERROR, "Output truncated (%u bytes)\n\r", capture->size);
+	}
+}
+
+/**
+ * @brief End the streamed output of the selected session
+ *
+ * @param isAborted Tell if the user stopped it
+ */
+static void cli_stream_stop(bool isAborted)
+{
+	cliSession->stream = NULL;
+	if (isAborted) {
+		CLI_PRINTF("\n\rAborted\n\r");
+	}
+
+	// Prompt was hidden while streaming
+	if (cliSession->mode == CLI_MODE_HUMAN) {
+		lb_set_silent(false);
+		lb_refresh();
+	}
+}
+
+/**
+ * @brief Write the next chunk of the streamed output of the selected session
+ *
+ * @return Number of bytes written, 0: Stream is over
+ */
+static int cli_stream_produce(void)
+{
+	char buffer[CLI_STREAM_CHUNK_LENGTH];
+	int  len;
+
+	len = cliSession->stream(&cliSession->streamCursor, buffer, sizeof(buffer));
+	if (len <= 0) {
+		cli_stream_stop(false);
+		return 0;
+	} else if (len > (int) sizeof(buffer)) {
+		len = sizeof(buffer);
+	}
+	cli_output_write(buffer, len);
+	return len;
+}
+
+/**
+ * @brief Write the whole streamed output while the output is captured
+ * @details Used by machine and binary modes which answer once per command,
+ * the stream is stopped as soon as the capture is full
+ */
+static void cli_stream_drain(void)
+{
+	while ((cliSession->stream != NULL) && (cliCapture->isTruncated == false)) {
+		cli_stream_produce();
+	}
+	cliSession->stream = NULL;
+}
+
+/**
+ * @brief Execute a line while the output is captured
+ * @details The selected session acts as in machine mode for the duration of
+ * the call: the prompt is left untouched and a streamed output is written
+ * entirely. A stream already running in the session is kept for later. An
+ * upload started by the command is aborted.
+ *
+ * @param line The line ('\0' terminated)
+ * @param status Where the result of the command is written, can be NULL
+ */
+static void cli_capture_execute(const char * line, int * status)
+{
+	cli_stream_callback_t prevStream = cliSession->stream;
+	uint32_t              prevCursor = cliSession->streamCursor;
+	cli_upload_callback_t prevUpload = cliSession->upload;
+	uint8_t               prevMode   = cliSession->mode;
+	int                   ret;
+
+	cliSession->stream = NULL;
+	cliSession->mode   = CLI_MODE_MACHINE;
+	ret                = cli_execute_lb(line, strlen(line));
+	cli_stream_drain();
+
+	// No data can follow the line, this is not the received one
+	if ((prevUpload == NULL) && (cliSession->upload != NULL)) {
+		cliSession->upload(NULL, -1);
+		cliSession->upload = NULL;
+		ret                = -1;
+	}
+
+	// The command may have changed the mode on purpose
+	if (cliSession->mode == CLI_MODE_MACHINE) {
+		cliSession->mode = prevMode;
+	}
+	cliSession->stream       = prevStream;
+	cliSession->streamCursor = prevCursor;
+
+	if (status != NULL) {
+		*status = ret;
+	}
+}
+
+/**
+ * @brief Write the frame answering a line in machine mode
+ * @details "<status> <length>\n<output>", " truncated" follows the length
+ * when the output did not fit in CLI_MACHINE_OUTPUT_LENGTH
+ *
+ * @param status Return of the callback
+ * @param capture Stopped capture of the output
+ */
+static void cli_machine_answer(int status, const cli_capture_t * capture)
+{
+	CLI_PRINTF("%d %u%s\n", status, capture->len, capture->isTruncated ? " truncated" : "");
+	cli_output_write(capture->buffer, capture->len);
+}
+
+/**
+ * @brief Execute a line received in machine mode and answer with a frame
+ * @details The frame is "<status> <length>\n" followed by the output of the command
+ *
+ * @param line The line ('\0' terminated)
+ * @param len The length of line
+ * @param isOverflow Tell if the line was too long
+ */
+static void cli_machine_execute(const char * line, uint16_t len, bool isOverflow)
+{
+	cli_capture_t capture;
+	int           status;
+
+	// Execute with output captured
+	cli_capture_start(&capture, cliCaptureBuffer, sizeof(cliCaptureBuffer));
+	if (isOverflow) {
+		CLI_PRINTF("Line is too long (CLI_CMD_MAX_LEN = %d)\n\r", CLI_CMD_MAX_LEN);
+		status = -1;
+	} else {
+		status = cli_execute_lb(line, len);
+	}
+	cli_stream_drain();
+	cli_capture_stop(&capture);
+
+	cli_machine_answer(status, &capture);
+}
+
+/**
+ * @brief Receive a byte in machine mode
+ * @details No echo, no edition and no history: lines are
+ * executed as soon as '\n' is received ('\r' is ignored)
+ *
+ * @param byte Incomming byte
+ */
+static void cli_machine_rx(uint8_t byte)
+{
+	if (byte == '\r') {
+		return;
+	} else if (byte != '\n') {
+		if (cliSession->machineLineLen < (CLI_CMD_MAX_LEN - 1)) {
+			cliSession->machineLine[cliSession->machineLineLen++] = byte;
+		} else {
+			cliSession->isMachineOverflow = true;
+		}
+		return;
+	}
+
+	cliSession->machineLine[cliSession->machineLineLen] = '\0';
+	cli_machine_execute(cliSession->machineLine, cliSession->machineLineLen, cliSession->isMachineOverflow);
+	cliSession->machineLineLen    = 0;
+	cliSession->isMachineOverflow = false;
+
+	// The command may have left machine mode
+	if (cliSession->mode == CLI_MODE_HUMAN) {
+		lb_refresh();
+	}
+}
+
+/**
+ * @brief Give the buffered uploaded bytes to the consumer
+ *
+ * @return The consumer return, 0 if nothing was buffered
+ */
+static int cli_upload_flush(void)
+{
+	int ret = 0;
+
+	if (cliSession->uploadLen > 0) {
+		ret                   = cliSession->upload(cliSession->uploadChunk, cliSession->uploadLen);
+		cliSession->uploadLen = 0;
+	}
+	return ret;
+}
+
+/**
+ * @brief End the upload of the selected session
+ * @details The consumer is always called last with no data. In machine mode,
+ * the end is answered with a frame as a command would be.
+ *
+ * @param error Why the upload is aborted, NULL: The data was received
+ */
+static void cli_upload_stop(const char * error)
+{
+	cli_upload_callback_t consumer = cliSession->upload;
+	cli_capture_t         capture;
+	int                   status = -1;
+
+	if (cliSession->mode == CLI_MODE_MACHINE) {
+		cli_capture_start(&capture, cliCaptureBuffer, sizeof(cliCaptureBuffer));
+	}
+
+	if ((error == NULL) && (cli_upload_flush() < 0)) {
+		error = "Data refused";
+	}
+	if (error == NULL) {
+		status = consumer(NULL, 0);
+	} else {
+		CLI_PRINTF("%s\n\r", error);
+		consumer(NULL, -1);
+	}
+	cliSession->upload = NULL;
+
+	if (cliSession->mode == CLI_MODE_MACHINE) {
+		cli_capture_stop(&capture);
+		cli_machine_answer(status, &capture);
+	} else {
+		// Prompt was hidden while uploading
+		lb_set_silent(false);
+		lb_refresh();
+	}
+}
+
+/**
+ * @brief Add a decoded byte to the upload of the selected session
+ *
+ * @param byte Decoded byte
+ * @return 0: ok, -1: The consumer refused the data, the upload is over
+ */
+static int cli_upload_push(uint8_t byte)
+{
+	cliSession->uploadChunk[cliSession->uploadLen++] = byte;
+	if ((cliSession->uploadLen == CLI_UPLOAD_CHUNK_LENGTH) && (cli_upload_flush() < 0)) {
+		cli_upload_stop("Data refused");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Give the value of a hexadecimal or base64 digit
+ *
+ * @param byte Received character
+ * @param encoding CLI_UPLOAD_HEX or CLI_UPLOAD_BASE64
+ * @return Value, -1: Not a digit
+ */
+static int cli_upload_digit(uint8_t byte, uint8_t encoding)
+{
+	if (encoding == CLI_UPLOAD_HEX) {
+		if ((byte >= '0') && (byte <= '9')) {
+			return byte - '0';
+		}
+		byte |= 0x20; // Lower case
+		return ((byte >= 'a') && (byte <= 'f')) ? byte - 'a' + 10 : -1;
+	}
+
+	if ((byte >= 'A') && (byte <= 'Z')) {
+		return byte - 'A';
+	} else if ((byte >= 'a') && (byte <= 'z')) {
+		return byte - 'a' + 26;
+	} else if ((byte >= '0') && (byte <= '9')) {
+		return byte - '0' + 52;
+	} else if (byte == '+') {
+		return 62;
+	} else if (byte == '/') {
+		return 63;
+	}
+	return -1;
+}
+
+/**
+ * @brief Receive a byte of a raw upload
+ * @details The first 4 bytes are the length of the data (big endian)
+ *
+ * @param byte Incomming byte
+ */
+static void cli_upload_raw_rx(uint8_t byte)
+{
+	if (cliSession->uploadBits < 4) {
+		cliSession->uploadValue = (cliSession->uploadValue << 8) | byte;
+		if ((++cliSession->uploadBits == 4) && (cliSession->uploadValue == 0)) {
+			cli_upload_stop(NULL);
+		}
+		return;
+	}
+
+	if (cli_upload_push(byte) < 0) {
+		return;
+	}
+	if (--cliSession->uploadValue == 0) {
+		cli_upload_stop(NULL);
+	}
+}
+
+/**
+ * @brief Receive a byte of the upload of the selected session
+ * @details Text is decoded on the fly, spaces and line ends are ignored
+ *
+ * @param byte Incomming byte
+ */
+static void cli_upload_rx(uint8_t byte)
+{
+	uint8_t bitCount = (cliSession->uploadEncoding == CLI_UPLOAD_HEX) ? 4 : 6;
+	int     digit;
+
+	if (cliSession->uploadEncoding == CLI_UPLOAD_RAW) {
+		cli_upload_raw_rx(byte);
+		return;
+	}
+
+	if ((byte == ' ') || (byte == '\t') || (byte == '\r') || (byte == '\n') || (byte == '=')) {
+		return; // base64 padding is implied by the end
+	} else if (byte == CLI_UPLOAD_ABORT) {
+		cli_upload_stop("\n\rAborted");
+		return;
+	} else if (byte == CLI_UPLOAD_END) {
+		// Remaining bits are padding, a half byte is an error
+		if ((cliSession->uploadEncoding == CLI_UPLOAD_HEX) && (cliSession->uploadBits != 0)) {
+			cli_upload_stop("Odd number of digits");
+		} else {
+			cli_upload_stop(NULL);
+		}
+		return;
+	}
+
+	digit = cli_upload_digit(byte, cliSession->uploadEncoding);
+	if (digit < 0) {
+		cli_upload_stop("Invalid character");
+		return;
+	}
+	cliSession->uploadValue = (cliSession->uploadValue << bitCount) | digit;
+	cliSession->uploadBits += bitCount;
+	if (cliSession->uploadBits >= 8) {
+		cliSession->uploadBits -= 8;
+		cli_upload_push(cliSession->uploadValue >> cliSession->uploadBits);
+	}
+}
+
+/**
+ * @brief Continue a FNV-1a hash with a string
+ *
+ * @param hash Current hash
+ * @param str String ('\0' terminated)
+ * @return The new hash
+ */
+static uint32_t cli_id_hash(uint32_t hash, const char * str)
+{
+	while (*str != '\0') {
+		hash ^= (uint8_t) *str++;
+		hash *= CLI_ID_FNV_PRIME;
+	}
+	return hash;
+}
+
+/**
+ * @brief Add a leaf token into the command ID table
+ *
+ * @param id Command ID
+ * @param curTok Pointer
+ * @return 0: ok, -1: Collision or table full
+ */
+static int cli_id_table_insert(uint32_t id, cli_token * curTok)
+{
+	uint16_t index = id & (CLI_ID_TABLE_SIZE - 1);
+
+	for (uint16_t i = 0; i < CLI_ID_TABLE_SIZE; ++i) {
+		cli_id_entry_t * entry = &cliIdTable[index];
+
+		if (entry->token == NULL) {
+			entry->id    = id;
+			entry->token = curTok;
+			return 0;
+		} else if (entry->id == id) {
+			DPRINTF(ERROR, "Command ID 0x%08lX of \"%s\" is already used by \"%s\"\n\r", (unsigned long) id, curTok->text, entry->token->text);
+			return -1;
+		}
+		index = (index + 1) & (CLI_ID_TABLE_SIZE - 1);
+	}
+
+	DPRINTF(ERROR, "Command ID table is full (CLI_ID_TABLE_SIZE = %d)\n\r", CLI_ID_TABLE_SIZE);
+	return -1;
+}
+
+/**
+ * @brief Walk the tree to give the command ID of all leaves
+ * @warning Recurcive call inside !
+ *
+ * @param curTok The token where the walk begins
+ * @param path Path of curTok, children are appended to it
+ * @param pathLen Length of path
+ * @param isPrint true: print the IDs, false: fill the command ID table
+ */
+static void cli_id_walk(cli_token * curTok, char * path, uint16_t pathLen, bool isPrint)
+{
+	for (uint8_t i = 0; i < CLI_MAX_CHILDS; ++i) {
+		cli_token * child   = cli_get_child(curTok, i);
+		uint16_t    textLen;
+		uint32_t    id;
+
+		// Binary requests can't give the words matched by patterns
+		if ((child == NULL) || child->isPattern) {
+			continue;
+		}
+
+		// Path is "<token> <token> ..."
+		textLen = strlen(child->text);
+		if ((pathLen + textLen + 2) > CLI_ID_PATH_LENGTH) {
+			DPRINTF(ERROR, "Path of \"%s\" is too deep (CLI_CMD_MAX_TOKEN = %d)\n\r", child->text, CLI_CMD_MAX_TOKEN);
+			continue;
+		}
+		if (pathLen > 0) {
+			path[pathLen] = ' ';
+		}
+		memcpy(&path[pathLen + (pathLen > 0)], child->text, textLen + 1);
+
+		if (cli_is_token_a_leaf(child) == false) {
+			cli_id_walk(child, path, pathLen + (pathLen > 0) + textLen, isPrint);
+			continue;
+		}
+
+		id = cli_get_command_id(path);
+		if (isPrint) {
+			CLI_PRINTF("0x%08lX %u %u %s\n\r", (unsigned long) id, child->mandatoryArgc, child->optionalArgc, path);
+		} else {
+			cli_id_table_insert(id, child);
+		}
+	}
+	path[pathLen] = '\0';
+}
+
+/**
+ * @brief Find the leaf token of a command ID
+ * @details The table of the thread is built again if the tree changed
+ *
+ * @param id Command ID
+ * @return The token, NULL if not found
+ */
+static cli_token * cli_id_find(uint32_t id)
+{
+	char     path[CLI_ID_PATH_LENGTH];
+	uint16_t index = id & (CLI_ID_TABLE_SIZE - 1);
+
+	// The tree may change again while it is walked
+	if (cliIdTableVersion != cliTreeVersion) {
+		uint32_t version = cliTreeVersion;
+
+		path[0] = '\0';
+		memset(cliIdTable, 0, sizeof(cliIdTable));
+		cli_id_walk(cli_get_root_token(), path, 0, false);
+		cliIdTableVersion = version;
+	}
+
+	for (uint16_t i = 0; i < CLI_ID_TABLE_SIZE; ++i) {
+		cli_id_entry_t * entry = &cliIdTable[index];
+
+		if (entry->token == NULL) {
+			break;
+		} else if (entry->id == id) {
+			return entry->token;
+		}
+		index = (index + 1) & (CLI_ID_TABLE_SIZE - 1);
+	}
+	return NULL;
+}
+
+/**
+ * @brief Call the command of a binary request
+ * @details Arguments are '\0' terminated in place: the length of an
+ * argument is read before being overwritten by the end of the previous one
+ *
+ * @param frame Request: id (4, little endian), argc (1), { length (1), bytes }
+ * @param len Length of frame, may be greater than CLI_BIN_FRAME_LENGTH
+ * @return The callback return, -1: Error
+ */
+static int cli_bin_dispatch(uint8_t * frame, uint16_t len)
+{
+	char *      argv[CLI_CMD_MAX_TOKEN];
+	cli_token * curTok;
+	uint32_t    id;
+	uint16_t    pos;
+	uint8_t     argc;
+	uint8_t     argLen;
+	int         optionRet;
+
+	if (len > CLI_BIN_FRAME_LENGTH) {
+		CLI_PRINTF("Frame is too long (CLI_BIN_FRAME_LENGTH = %d)\n\r", CLI_BIN_FRAME_LENGTH);
+		return -1;
+	} else if (len < CLI_BIN_REQUEST_HEADER) {
+		CLI_PRINTF("Frame is too short\n\r");
+		return -1;
+	}
+
+	id   = frame[0] | (frame[1] << 8) | ((uint32_t) frame[2] << 16) | ((uint32_t) frame[3] << 24);
+	argc = frame[4];
+	if (argc > CLI_CMD_MAX_TOKEN) {
+		CLI_PRINTF("Too many arguments (CLI_CMD_MAX_TOKEN = %d)\n\r", CLI_CMD_MAX_TOKEN);
+		return -1;
+	}
+
+	pos = CLI_BIN_REQUEST_HEADER;
+	for (uint8_t i = 0; i < argc; ++i) {
+		if (pos >= len) {
+			CLI_PRINTF("Arguments do not match the frame length\n\r");
+			return -1;
+		}
+		argLen     = frame[pos];
+		frame[pos] = '\0';
+		argv[i]    = (char *) &frame[pos + 1];
+		pos += 1 + argLen;
+	}
+	if (pos != len) {
+		CLI_PRINTF("Arguments do not match the frame length\n\r");
+		return -1;
+	}
+	frame[pos] = '\0'; // Frame has a spare byte
+
+	if (id == CLI_BIN_ID_EXIT) {
+		return cli_set_mode(CLI_MODE_HUMAN);
+	}
+
+	curTok = cli_id_find(id);
+	if (curTok == NULL) {
+		CLI_PRINTF("Unknown command ID 0x%08lX\n\r", (unsigned long) id);
+		return -1;
+	}
+	optionRet = cli_parse_options(curTok, argv, argc);
+	if (optionRet < 0) {
+		return -1;
+	}
+	argc = optionRet;
+	if ((argc < curTok->mandatoryArgc) || (argc > (curTok->mandatoryArgc + curTok->optionalArgc))) {
+		CLI_PRINTF("This command takes %d mandatory and %d optional argument !\n\r", curTok->mandatoryArgc, curTok->optionalArgc);
+		return -1;
+	}
+	if (cli_get_callback(curTok) == NULL) {
+		CLI_PRINTF("No callback defined for this command !\n\r");
+		return -1;
+	}
+	return cli_call(curTok, argc, argv);
+}
+
+/**
+ * @brief Execute a binary request and answer with a frame
+ * @details The answer is sync (1), length (2), status (4) followed
+ * by the output of the command, integers are little endian
+ *
+ * @param frame Request
+ * @param len Length of frame
+ */
+static void cli_bin_execute(uint8_t * frame, uint16_t len)
+{
+	cli_capture_t capture;
+	uint8_t       header[CLI_BIN_ANSWER_HEADER];
+	uint16_t      answerLen;
+	uint32_t      status;
+	uint8_t       lock;
+
+	// Execute with output captured
+	cli_capture_start(&capture, cliCaptureBuffer, sizeof(cliCaptureBuffer));
+	lock   = cli_read_lock();
+	status = cli_bin_dispatch(frame, len);
+	cli_read_unlock(lock);
+	cli_stream_drain();
+	cli_capture_stop(&capture);
+
+	// Answer
+	answerLen = 4 + capture.len;
+	header[0] = CLI_BIN_SYNC;
+	header[1] = answerLen & 0xFF;
+	header[2] = answerLen >> 8;
+	header[3] = status & 0xFF;
+	header[4] = (status >> 8) & 0xFF;
+	header[5] = (status >> 16) & 0xFF;
+	header[6] = (status >> 24) & 0xFF;
+	cli_output_write((const char *) header, sizeof(header));
+	cli_output_write(capture.buffer, capture.len);
+}
+
+/**
+ * @brief Receive a byte in binary mode
+ * @details Frame is sync (1), length (2, little endian) and body,
+ * bytes out of a frame are dropped
+ *
+ * @param byte Incomming byte
+ */
+static void cli_bin_rx(uint8_t byte)
+{
+	cli_session * session = cliSession;
+
+	switch (session->binState) {
+	case CLI_BIN_STATE_SYNC:
+		if (byte == CLI_BIN_SYNC) {
+			session->binState = CLI_BIN_STATE_LEN_LOW;
+		}
+		return;
+	case CLI_BIN_STATE_LEN_LOW:
+		session->binLen   = byte;
+		session->binState = CLI_BIN_STATE_LEN_HIGH;
+		return;
+	case CLI_BIN_STATE_LEN_HIGH:
+		session->binLen |= byte << 8;
+		session->binPos   = 0;
+		session->binState = CLI_BIN_STATE_BODY;
+		if (session->binLen > 0) {
+			return;
+		}
+		break; // Empty frame, answered as an error
+	default:
+		// Bytes beyond CLI_BIN_FRAME_LENGTH are dropped, frame is answered as an error
+		if (session->binPos < CLI_BIN_FRAME_LENGTH) {
+			session->binFrame[session->binPos] = byte;
+		}
+		if (++session->binPos < session->binLen) {
+			return;
+		}
+		break;
+	}
+
+	session->binState = CLI_BIN_STATE_SYNC;
+	cli_bin_execute(session->binFrame, session->binLen);
+
+	// The command may have left binary mode
+	if (cliSession->mode == CLI_MODE_HUMAN) {
+		lb_refresh();
+	}
+}
+
+/**
+ * @brief Free all the tokens and add root
+ */
+static void cli_reset_tree(void)
+{
+	cliTokens = tokenList;
+	memset(tokenList, 0, sizeof(tokenList));
+	memset(cliSymbols, 0, sizeof(cliSymbols));
+	cliSymbolCount = 0;
+	cliFreeToken   = NULL;
+	cliLazyPinned  = NULL;
+	cliLazyClock   = 0;
+	for (int i = CLI_MAX_TOKEN_COUNT - 1; i >= 0; --i) {
+		tokenList[i].childs[0] = cli_link(cliFreeToken);
+		cliFreeToken           = &tokenList[i];
+	}
+	++cliTreeVersion; // ID tables of all threads are built again
+
+	// Add root children
+	cli_add_token(CLI_ROOT_TOKEN_NAME, CLI_DESC(root, ""));
+}
+
+/**
+ * @brief Give the link a symbol of the tree has in an image
+ *
+ * @param symbols Symbols given to cli_snapshot_export()
+ * @param symbolCount Number of symbols
+ * @param link Link of a callback, a provider or options of a token
+ * @return Index + 1 in symbols, 0 if link is 0, -1: Not found
+ */
+static int cli_snapshot_link_symbol(const cli_symbol_t * symbols, uint16_t symbolCount, cli_link_t link)
+{
+	const cli_symbol_t * symbol = cli_get_symbol(link);
+
+	if (symbol == NULL) {
+		return 0;
+	}
+	for (uint16_t i = 0; i < symbolCount; ++i) {
+		if ((symbols[i].callback == symbol->callback) && (symbols[i].provider == symbol->provider) && (symbols[i].options == symbol->options)) {
+			return i + 1;
+		}
+	}
+	return -1;
+}
+
+/**
+ * @brief Give the completion of a line
+ * @see cli_autocomplete_lb()
+ *
+ * @param str The input command string
+ * @param len The length of the str
+ * @param outBuffer The buffer where we write the completion
+ * @param outBufferMaxLen The length of outBuffer
+ *
+ * @return Number of characters added
+ */
+static CLI_NOINLINE uint8_t cli_autocomplete_line(const char * str, uint16_t len, char * outBuffer, uint16_t outBufferMaxLen)
+{
+	char    cmdEdit[CLI_CMD_MAX_LEN]; // Editable copy of str
+	char *  cmdText[CLI_CMD_MAX_TOKEN];
+	char    completion[CLI_CMD_MAX_LEN]; // Copy, the token may be freed after cli_read_unlock()
+	int     cmdTextCount;
+	uint8_t countToAdd, countAlreadyWrote;
+	uint8_t lock;
+
+	(void) len; // str is '\0' terminated
+	// Copy incomming buffer
+	cli_strcpy_safe(cmdEdit, str, CLI_CMD_MAX_LEN);
+
+	// PARSER (Note: cmdTextCount can be 0)
+	cmdTextCount = cli_parse_cmd_text(cmdEdit, strlen(cmdEdit), cmdText);
+	CLI_TRACE(PARSE, CLI_TRACE_NO_TOKEN, cmdTextCount);
+	if (cmdTextCount < 0) {
+		return 0; // Nothing to complete in an unfinished line
+	}
+
+	// Search for alternatives
+	bool   isWordEnded = true;
+	lock               = cli_read_lock();
+	char * pText       = cli_autocomplete(cmdText, cmdTextCount, &isWordEnded);
+	if (pText != NULL) {
+		cli_strcpy_safe(completion, pText, sizeof(completion));
+	}
+	cli_read_unlock(lock);
+	if (pText == NULL) {
+		DPRINTF(AUTOC, "No unique alternative found\n\r");
+		return 0; // Nothing added
+	}
+	pText = completion;
+	DPRINTF(AUTOC, "Found 1 alternative: %s\n\r", pText);
+
+	countToAdd = strlen(pText); // size we have to write (Ex: 2 -> "ig" for "conf")
+
+	// Check overflow
+	if (countToAdd > outBufferMaxLen) {
+		// Not enough space to autocomplete, do nothing
+		DPRINTF(ERROR, "Not enough space in line buffer for autocompletion\n\r");
+		return 0;
+	}
+
+	// Append the text to add and update max len
+	cli_strcpy_safe(outBuffer, pText, outBufferMaxLen);
+	outBufferMaxLen -= countToAdd;
+	DPRINTF(AUTOC, "Adding %u bytes\n\r", countToAdd);
+
+	// Append an extra space (" ") if there is enough memory
+	if (isWordEnded && (outBufferMaxLen >= 1)) {
+		DPRINTF(AUTOC, "Adding extra space\n\r");
+		cli_strcpy_safe(outBuffer + countToAdd, " ", outBufferMaxLen);
+		countToAdd += 1;
+	}
+
+	return countToAdd;
+}
+
+/**
+ * @brief Execute a line
+ * @see cli_execute_lb()
+ *
+ * @param str The input command string
+ * @param len The length of the str
+ *
+ * @return The result of the command
+ */
+static CLI_NOINLINE int cli_execute_line(const char * str, uint16_t len)
+{
+	char    cmdEdit[CLI_CMD_MAX_LEN]; // Editable copy of str
+	char *  cmdText[CLI_CMD_MAX_TOKEN];
+	int     cmdTextCount;
+	uint8_t lock;
+	int     ret;
+
+	// Copy incomming buffer
+	cli_strcpy_safe(cmdEdit, str, CLI_CMD_MAX_LEN);
+	if (len >= CLI_CMD_MAX_LEN) {
+		len = CLI_CMD_MAX_LEN - 1;
+	}
+
+	// PARSER
+	cmdTextCount = cli_parse_cmd_text(cmdEdit, len, cmdText);
+	CLI_TRACE(PARSE, CLI_TRACE_NO_TOKEN, cmdTextCount);
+	if (cmdTextCount < 0) {
+		cli_print_parse_error(cmdTextCount);
+		return -1;
+	} else if (cmdTextCount == 0) {
+		return 0;
+	}
+
+	lock = cli_read_lock();
+	ret  = cli_execute(cmdText, cmdTextCount);
+	cli_read_unlock(lock);
+	return ret;
+}
+
+// ===================
+//       EXTERN
+// ===================
+
+/**
+ * @brief Init module
+ * @return 0
+ */
+int cli_init(void)
+{
+	DEBUG_ENABLE(ERROR);
+	//DEBUG_ENABLE(PARSER);
+	//DEBUG_ENABLE(FINDER);
+	//DEBUG_ENABLE(AUTOC);
+
+	// Empty token list, only root
+	cli_reset_tree();
+	cliStackExecute      = 0;
+	cliStackAutocomplete = 0;
+
+	// Init default session (stdout)
+	cli_session_init(&cliDefaultSession, NULL);
+	cli_session_select(&cliDefaultSession);
+	return 0;
+}
+
+/**
+ * @brief Safely copy src into dest with a max length and
+ * set the ending string character
+ * @details [long description]
+ *
+ * @param dest Pointer
+ * @param src Pointer
+ * @param maxLen Max length of dest
+ */
+void cli_strcpy_safe(char * dest, const char * src, uint16_t maxLen)
+{
+	strncpy(dest, src, maxLen);
+	dest[maxLen - 1] = '\0';
+}
+
+/**
+ * @brief Give a string containing the version of CLI
+ * @return String pointer
+ */
+const char * cli_get_version(void)
+{
+	return cliVersionName;
+}
+
+/**
+ * @brief Add a token to the list of known tokens
+ *
+ * @param text The text of the token
+ * @param desc The description of the token
+ * @return a pointer to the newly created token
+ */
+cli_token * cli_add_token(const char * text, cli_desc_t desc)
+{
+	cli_token * curTok;
+
+#if (CLI_CONCURRENT_READERS == 1)
+	// Removed tokens may be free now
+	if (cliFreeToken == NULL) {
+		cli_reclaim();
+	}
+#endif
+	// Make room by dropping a lazy subtree
+	if (cliFreeToken == NULL) {
+		cli_lazy_evict();
+	}
+	curTok = cliFreeToken;
+
+	// Check overflow
+	if (curTok == NULL) {
+		DPRINTF(ERROR, "Unable to add token \"%s\", maximum reach: %u\n\r", text, CLI_MAX_TOKEN_COUNT);
+		return NULL;
+	}
+	cliFreeToken = cli_get_link(curTok->childs[0]);
+
+	// Clear and fill the structure
+	memset(curTok, 0, sizeof(*curTok));
+	cli_set_generation(curTok);
+	cli_strcpy_safe(curTok->text, text, CLI_MAX_TEXT_LEN);
+#if (CLI_DESC_COMPRESSED == 1)
+	curTok->desc = desc;
+#else
+	cli_strcpy_safe(curTok->desc, desc, CLI_MAX_DESC_LEN);
+#endif
+	return curTok;
+}
+
+/**
+ * @brief Add a children to a token
+ *
+ * @param parent Pointer
+ * @param children Pointer
+ *
+ * @return 0: ok, -1: Can't take more children
+ */
+int cli_add_children(cli_token * parent, cli_token * children)
+{
+	uint8_t argc = parent->mandatoryArgc + parent->optionalArgc;
+	if (argc > 0) {
+		DPRINTF(ERROR, "Unable to add children for token \"%s\", parent has %u arguments\n\r", parent->text, argc);
+		return -1;
+	}
+	if ((children->parent != 0) || (children == cli_get_root_token())) {
+		DPRINTF(ERROR, "Unable to add children \"%s\", token already has a parent\n\r", children->text);
+		return -1;
+	}
+
+	for (uint8_t i = 0; i < CLI_MAX_CHILDS; ++i) {
+		if (parent->childs[i] == 0) {
+			// Readers can walk back to the parent as soon as the child is seen
+			children->parent  = cli_link(parent);
+			parent->childs[i] = cli_link(children);
+
+			// Command IDs must be found again
+			++cliTreeVersion;
+			return 0;
+		}
+	}
+
+	DPRINTF(ERROR, "Unable to add children for token \"%s\", parent has no empty child (CLI_MAX_CHILDS = %d)\n\r", parent->text, CLI_MAX_CHILDS);
+	return -1;
+}
+
+/**
+ * @brief Remove a child of a token and free its subtree
+ * @details Watched commands of the subtree are stopped. The parent
+ * becomes a leaf again when its last child is removed.
+ *
+ * @param parent Pointer
+ * @param children Pointer
+ *
+ * @return 0: ok, -1: children is not a child of parent
+ */
+int cli_remove_children(cli_token * parent, cli_token * children)
+{
+	uint8_t i;
+
+	for (i = 0; i < CLI_MAX_CHILDS; ++i) {
+		if (cli_get_child(parent, i) == children) {
+			break;
+		}
+	}
+	if ((i == CLI_MAX_CHILDS) || (children == NULL)) {
+		DPRINTF(ERROR, "Unable to remove children of token \"%s\", not found\n\r", parent->text);
+		return -1;
+	}
+
+#if (CLI_CONCURRENT_READERS == 1)
+	// Moving the others would hide them from readers, the hole is reused by cli_add_children()
+	parent->childs[i] = 0;
+#else
+	// Keep the order of the other children (Usage)
+	for (; i < (CLI_MAX_CHILDS - 1); ++i) {
+		parent->childs[i] = parent->childs[i + 1];
+	}
+	parent->childs[CLI_MAX_CHILDS - 1] = 0;
+#endif
+
+	cli_free_token(children);
+	return 0;
+}
+
+/**
+ * @brief Remove a token from the tree and free it with its subtree
+ * @details Also frees a token which was never added to a parent
+ * @see cli_remove_children()
+ *
+ * @param curTok Pointer
+ * @return 0: ok, -1: Error
+ */
+int cli_remove_token(cli_token * curTok)
+{
+	if (curTok == cli_get_root_token()) {
+		DPRINTF(ERROR, "Unable to remove root token\n\r");
+		return -1;
+	}
+	if (curTok->parent != 0) {
+		return cli_remove_children(cli_get_parent(curTok), curTok);
+	}
+	cli_free_token(curTok);
+	return 0;
+}
+
+/**
+ * @brief Set callback
+ * @details [long description]
+ *
+ * @param curTok Pointer
+ * @param callback Pointer to function
+ * @return 0: ok, -1: Error
+ */
+int cli_set_callback(cli_token * curTok, cli_callback_t callback)
+{
+	cli_link_t link;
+
+	if (!cli_is_token_a_leaf(curTok)) {
+		DPRINTF(ERROR, "Unable to set callback for token \"%s\", token is not a leaf\n\r", curTok->text);
+		return -1;
+	}
+	link = cli_add_symbol(callback, NULL, NULL);
+	if ((link == 0) && (callback != NULL)) {
+		return -1;
+	}
+	curTok->callback = link;
+	return 0;
+}
+
+/**
+ * @brief Reuse the output of a leaf for a time
+ * @details A call with the same arguments and options within ttlMs (See
+ * cli_tick()) writes the output of the previous one and gives its status,
+ * without calling the callback. Use cli_cache_invalidate() when what the
+ * command reads changes. Outputs longer than CLI_CACHE_OUTPUT_LENGTH, streamed
+ * outputs and uploads are not cached. The cache is not shared between threads:
+ * a thread safe leaf can't be cached. The time is the one of cli_tick(), which
+ * must be called before (Refused otherwise) and before commands are executed.
+ *
+ * @param curTok Leaf
+ * @param ttlMs Time in ms, 0 to stop caching
+ * @return 0: ok, -1: Error
+ */
+int cli_set_cache(cli_token * curTok, uint16_t ttlMs)
+{
+	if (!cli_is_token_a_leaf(curTok) || curTok->isThreadSafe || (CLI_CACHE_ENTRIES == 0)) {
+		DPRINTF(ERROR, "Unable to cache token \"%s\"\n\r", curTok->text);
+		return -1;
+	}
+	if ((ttlMs > 0) && !cliIsTicked) {
+		DPRINTF(ERROR, "Unable to cache token \"%s\", cli_tick() was never called\n\r", curTok->text);
+		return -1;
+	}
+	curTok->cacheTtl = ttlMs;
+	cli_cache_invalidate(curTok);
+	return 0;
+}
+
+/**
+ * @brief Declare if the callback of a leaf can be called by several threads
+ * at the same time
+ * @details Thread safe commands of cli_batch_execute() are called by workers.
+ * Their callback may only print, read its options and use its own data.
+ *
+ * @param curTok Pointer
+ * @param isThreadSafe boolean
+ * @return 0: ok, -1: Error
+ */
+int cli_set_thread_safe(cli_token * curTok, bool isThreadSafe)
+{
+	if (!cli_is_token_a_leaf(curTok)) {
+		DPRINTF(ERROR, "Unable to set thread safety for token \"%s\", token is not a leaf\n\r", curTok->text);
+		return -1;
+	}
+	if (isThreadSafe && (curTok->cacheTtl > 0)) {
+		DPRINTF(ERROR, "Token \"%s\" is cached, it can't be thread safe\n\r", curTok->text);
+		return -1;
+	}
+	curTok->isThreadSafe = isThreadSafe;
+	return 0;
+}
+
+/**
+ * @brief Set the argument counts for this token
+ *
+ * @param curTok Pointer
+ * @param mandatoryArgc uint8_t
+ * @param optionalArgc uint8_t
+ *
+ * @return 0: ok, -1: Error
+ */
+int cli_set_argc(cli_token * curTok, uint8_t mandatoryArgc, uint8_t optionalArgc)
+{
+	if (!cli_is_token_a_leaf(curTok)) {
+		DPRINTF(ERROR, "Can't set argument count for token \"%s\": token is not a leaf\n\r", curTok->text);
+		return -1;
+	}
+
+	curTok->mandatoryArgc = mandatoryArgc;
+	curTok->optionalArgc  = optionalArgc;
+	return 0;
+}
+
+/**
+ * @brief Make a token match a range of instances: "<text><number>"
+ * @details The token still can have children. The words it matches are given
+ * to the callback of the leaf, before the arguments. Commands below it have
+ * no command ID.
+ *
+ * @param curTok Pointer, its text is the prefix (Ex: "eth")
+ * @param min Smallest number
+ * @param max Greatest number
+ * @return 0: ok, -1: Error
+ */
+int cli_set_pattern(cli_token * curTok, uint16_t min, uint16_t max)
+{
+	if (min > max) {
+		DPRINTF(ERROR, "Unable to set pattern for token \"%s\", empty range\n\r", curTok->text);
+		return -1;
+	}
+
+	curTok->isPattern  = true;
+	curTok->patternMin = min;
+	curTok->patternMax = max;
+
+	// Command IDs must be found again
+	++cliTreeVersion;
+	return 0;
+}
+
+/**
+ * @brief Give options to a leaf
+ * @details Options are removed from the arguments before they are counted,
+ * the callback reads them with cli_get_option()
+ *
+ * @param curTok Leaf
+ * @param options Array kept by the caller (Ex: static const)
+ * @param count Number of options, CLI_MAX_OPTIONS at most
+ * @return 0: ok, -1: Error
+ */
+int cli_set_options(cli_token * curTok, const cli_option_t * options, uint8_t count)
+{
+	cli_link_t link;
+
+	if (!cli_is_token_a_leaf(curTok) || (count > CLI_MAX_OPTIONS)) {
+		DPRINTF(ERROR, "Unable to set options for token \"%s\" (CLI_MAX_OPTIONS = %d)\n\r", curTok->text, CLI_MAX_OPTIONS);
+		return -1;
+	}
+	link = cli_add_symbol(NULL, NULL, options);
+	if ((link == 0) && (options != NULL)) {
+		return -1;
+	}
+	curTok->options     = link;
+	curTok->optionCount = count;
+	return 0;
+}
+
+/**
+ * @brief Tell how many times an option was given to the command being called
+ *
+ * @param index Index of the option in the array of cli_set_options()
+ * @return 0: Not given, else number of times (1 if not counted)
+ */
+uint8_t cli_get_option(uint8_t index)
+{
+	return (index < CLI_MAX_OPTIONS) ? cliOptionValues.counts[index] : 0;
+}
+
+/**
+ * @brief Give all options of the command being called
+ *
+ * @param values Filled structure
+ */
+void cli_get_option_values(cli_option_values_t * values)
+{
+	*values = cliOptionValues;
+}
+
+/**
+ * @brief Restore the options of a command before calling its callback again
+ * @see cli_get_option_values()
+ *
+ * @param values Pointer
+ */
+void cli_set_option_values(const cli_option_values_t * values)
+{
+	cliOptionValues = *values;
+}
+
+/**
+ * @brief Make a token lazy: its children are added by a provider when the
+ * token is first entered by a command or an autocompletion
+ * @details The children are kept until cli_invalidate() or until their
+ * tokens are needed elsewhere (Least recently used first)
+ *
+ * @param curTok Pointer, without children nor arguments
+ * @param provider Function adding the children with cli_add_children(curTok, ...)
+ * @return 0: ok, -1: Error
+ */
+int cli_set_provider(cli_token * curTok, cli_provider_t provider)
+{
+	uint8_t    argc = curTok->mandatoryArgc + curTok->optionalArgc;
+	cli_link_t link;
+
+	if ((cli_get_children_count(curTok) > 0) || (argc > 0) || (curTok == cli_get_root_token())) {
+		DPRINTF(ERROR, "Unable to set provider for token \"%s\", token has children or arguments\n\r", curTok->text);
+		return -1;
+	}
+#if (CLI_CONCURRENT_READERS == 1)
+	// Readers would add the children
+	DPRINTF(ERROR, "Unable to set provider for token \"%s\", not supported with CLI_CONCURRENT_READERS\n\r", curTok->text);
+	return -1;
+#endif
+
+	link = cli_add_symbol(NULL, provider, NULL);
+	if ((link == 0) && (provider != NULL)) {
+		return -1;
+	}
+	curTok->provider = link; // No longer a leaf, children come later
+	return 0;
+}
+
+/**
+ * @brief Free the children of a lazy token so that its provider is called again
+ *
+ * @param curTok Pointer
+ */
+void cli_invalidate(cli_token * curTok)
+{
+	if (curTok->isMaterialized) {
+		cli_lazy_release(curTok);
+	}
+}
+
+/**
+ * @brief Keep the children of lazy tokens when no token is free
+ * @details Used while leaves found by cli_resolve_lb() wait to be called:
+ * evicting a subtree would free them. Materializing a lazy token then fails
+ * when no token is free.
+ *
+ * @param isHeld true: Nothing is evicted, false: Least recently used subtrees are evicted
+ */
+void cli_hold_lazy_tokens(bool isHeld)
+{
+	cliLazyHeld = isHeld;
+}
+
+/**
+ * @brief Forget the cached outputs of a leaf
+ * @details To be called when the state read by the command changes
+ *
+ * @param curTok Leaf, NULL for all leaves
+ */
+void cli_cache_invalidate(cli_token * curTok)
+{
+#if (CLI_CACHE_ENTRIES > 0)
+	for (uint8_t i = 0; i < CLI_CACHE_ENTRIES; ++i) {
+		cli_cache_entry_t * entry = &cliCache[i];
+
+		if ((curTok != NULL) && (entry->token != curTok)) {
+			continue;
+		}
+		if (entry->state == CLI_CACHE_VALID) {
+			entry->state = CLI_CACHE_FREE;
+		} else if (entry->state == CLI_CACHE_FILLING) {
+			entry->state = CLI_CACHE_STALE;
+		}
+	}
+#else
+	(void) curTok;
+#endif
+}
+
+/**
+ * @brief Give the root token pointer
+ * @return Pointer to root token
+ */
+cli_token * cli_get_root_token(void)
+{
+	return &cliTokens[0];
+}
+
+/**
+ * @brief Give a token from its index
+ * @see cli_get_token_index()
+ *
+ * @param index Index in [0; CLI_MAX_TOKEN_COUNT[
+ * @return Pointer, NULL if not used
+ */
+cli_token * cli_get_token(uint8_t index)
+{
+	if ((index >= CLI_MAX_TOKEN_COUNT) || (cliTokens[index].text[0] == '\0')) {
+		return NULL;
+	}
+	return &cliTokens[index];
+}
+
+/**
+ * @brief Give the index of a token, a compact reference to it
+ * @details The index is reused once the token is removed
+ *
+ * @param curTok Pointer
+ * @return Index, root is 0
+ */
+uint8_t cli_get_token_index(cli_token * curTok)
+{
+	return curTok - cliTokens;
+}
+
+/**
+ * @brief Enter a section where tokens can be used while another thread
+ * changes the tree
+ * @details Lookups of the CLI are already in such a section. Tokens removed
+ * meanwhile stay readable until cli_read_unlock(). Sections can be nested
+ * and never wait, the writer doesn't either. Nothing is done without
+ * CLI_CONCURRENT_READERS.
+ * @note The tree must be changed by one thread at a time, and sessions
+ * selected by one thread at a time
+ *
+ * @return Value to give to cli_read_unlock()
+ */
+uint8_t cli_read_lock(void)
+{
+#if (CLI_CONCURRENT_READERS == 1)
+	unsigned int epoch;
+
+	// Counted in the parity of an epoch which can't advance anymore
+	while (1) {
+		epoch = atomic_load(&cliReadEpoch);
+		atomic_fetch_add(&cliReaders[epoch & 1], 1);
+		if (atomic_load(&cliReadEpoch) == epoch) {
+			return epoch & 1;
+		}
+		atomic_fetch_sub(&cliReaders[epoch & 1], 1);
+	}
+#else
+	return 0;
+#endif
+}
+
+/**
+ * @brief Leave a section entered with cli_read_lock()
+ *
+ * @param lock Value given by cli_read_lock()
+ */
+void cli_read_unlock(uint8_t lock)
+{
+#if (CLI_CONCURRENT_READERS == 1)
+	atomic_fetch_sub(&cliReaders[lock], 1);
+#else
+	(void) lock;
+#endif
+}
+
+/**
+ * @brief Print a token and all its subtree with tree view
+ * @details Descriptions are aligned after the widest text, each row is
+ * written at once
+ *
+ * @param curTok The token where the tree begin (Ex: root)
+ */
+void cli_print_tree(cli_token * curTok)
+{
+	cli_tree_walk(curTok, cli_tree_walk(curTok, 0) + CLI_TREE_DESC_GAP);
+}
+
+/**
+ * @brief Callback function for LineBuffer
+ * @details The definition of this function must follow
+ * the one defined in LineBuffer
+ * @see lb_autocomplete_callback_t
+ *
+ * @param str The input command string
+ * @param len The length of the str
+ * @param outBuffer The buffer where we write the completion
+ * @param outBufferMaxLen The length of outBuffer
+ *
+ * @return Number of characters added
+ */
+uint8_t cli_autocomplete_lb(const char * str, uint16_t len, char * outBuffer, uint16_t outBufferMaxLen)
+{
+#if (CLI_STACK_PROBE_LENGTH > 0)
+	uint8_t  ret;
+	uint16_t used;
+
+	cli_stack_paint();
+	ret  = cli_autocomplete_line(str, len, outBuffer, outBufferMaxLen);
+	used = cli_stack_measure();
+	if (used > cliStackAutocomplete) {
+		cliStackAutocomplete = used;
+	}
+	return ret;
+#else
+	return cli_autocomplete_line(str, len, outBuffer, outBufferMaxLen);
+#endif
+}
+
+/**
+ * @brief Callback function for LineBuffer
+ * @details The definition of this function must follow
+ * the one defined in LineBuffer
+ * @see lb_line_callback_t
+ *
+ * @param str The input command string
+ * @param len The length of the str
+ *
+ * @return The result of the command
+ */
+int cli_execute_lb(const char * str, uint16_t len)
+{
+#if (CLI_STACK_PROBE_LENGTH > 0)
+	int      ret;
+	uint16_t used;
+
+	cli_stack_paint();
+	ret  = cli_execute_line(str, len);
+	used = cli_stack_measure();
+	if (used > cliStackExecute) {
+		cliStackExecute = used;
+	}
+	return ret;
+#else
+	return cli_execute_line(str, len);
+#endif
+}
+
+/**
+ * @brief Execute a line and write its output into a buffer
+ * @details Everything the command prints goes to buffer: its callback,
+ * usage and error messages and its streamed output. Can be called from
+ * a command callback.
+ *
+ * @param line The command line ('\0' terminated)
+ * @param buffer Where the output is written, always '\0' terminated
+ * @param size Size of buffer
+ * @param status Where the result of the command is written, can be NULL
+ * @return Length of the output, -1: Output truncated to size - 1 bytes or Error
+ */
+int cli_execute_capture(const char * line, char * buffer, uint16_t size, int * status)
+{
+	cli_capture_t capture;
+
+	if ((line == NULL) || (buffer == NULL) || (size == 0)) {
+		DPRINTF(ERROR, "Unable to capture output\n\r");
+		return -1;
+	}
+
+	// Keep room for '\0'
+	cli_capture_start(&capture, buffer, size - 1);
+	cli_capture_execute(line, status);
+	cli_capture_stop(&capture);
+
+	buffer[capture.len] = '\0';
+	return capture.isTruncated ? -1 : capture.len;
+}
+
+/**
+ * @brief Execute a line and give its output to a function, chunk by chunk
+ * @details Same as cli_execute_capture() for outputs of unknown length
+ *
+ * @param line The command line ('\0' terminated)
+ * @param chunk Function receiving the output, a negative return stops the output
+ * @param status Where the result of the command is written, can be NULL
+ * @return 0: ok, -1: Output stopped by chunk or Error
+ */
+int cli_execute_chunked(const char * line, cli_output_callback_t chunk, int * status)
+{
+	cli_capture_t capture;
+
+	if ((line == NULL) || (chunk == NULL)) {
+		DPRINTF(ERROR, "Unable to capture output\n\r");
+		return -1;
+	}
+
+	cli_capture_start(&capture, NULL, 0);
+	capture.chunk = chunk;
+	cli_capture_execute(line, status);
+	cli_capture_stop(&capture);
+
+	return capture.isTruncated ? -1 : 0;
+}
+
+/**
+ * @brief Find the leaf and the arguments of a line without executing it
+ * @details Errors are printed like cli_execute_lb(). Used to call the
+ * callback of a command many times without parsing it again.
+ *
+ * @param line Editable line ('\0' terminated), spaces are replaced by '\0'
+ * @param cmdText Array of CLI_CMD_MAX_TOKEN pointers, receives the words of line
+ * @param curTok Returned leaf
+ * @param argc Returned number of arguments
+ * @return Index of the first argument in cmdText, -1: Error
+ * @note With CLI_CONCURRENT_READERS, call it from a cli_read_lock() section
+ * lasting as long as curTok is used
+ */
+int cli_resolve_lb(char * line, char * cmdText[], cli_token ** curTok, uint8_t * argc)
+{
+	int cmdTextCount;
+	int argIndex;
+
+	cmdTextCount = cli_parse_cmd_text(line, strlen(line), cmdText);
+	if (cmdTextCount < 0) {
+		cli_print_parse_error(cmdTextCount);
+		return -1;
+	} else if (cmdTextCount == 0) {
+		return -1;
+	}
+
+	argIndex = cli_resolve(cmdText, &cmdTextCount, curTok);
+	if (argIndex >= 0) {
+		*argc = cmdTextCount - argIndex;
+	}
+	return argIndex;
 }
 
-// ===================
-//       EXTERN
-// ===================
-
 /**
- * @brief Init module
- * @return 0
+ * @brief Call the callback of a leaf found by cli_resolve_lb()
+ * @details Traced like any command, the cache is not used: it is not
+ * shared between threads (Ex: workers of cli_batch_execute())
+ *
+ * @param curTok Leaf given by cli_resolve_lb()
+ * @param argc Number of arguments
+ * @param argv Arguments, from the index given by cli_resolve_lb()
+ * @return The callback return
  */
-int cli_init(void)
+int cli_call_resolved(cli_token * curTok, uint8_t argc, char * argv[])
 {
-	DEBUG_ENABLE(ERROR);
-	//DEBUG_ENABLE(PARSER);
-	//DEBUG_ENABLE(FINDER);
-	//DEBUG_ENABLE(AUTOC);
+	return cli_call_traced(curTok, argc, argv, false);
+}
 
-	// Empty token list
-	memset(tokenList, 0, sizeof(tokenList));
+/**
+ * @brief Initialize a session
+ * @details The prompt is written to the output of the session.
+ * The selected session does not change.
+ *
+ * @param session Pointer
+ * @param output Where the output of the session goes, NULL for stdout
+ */
+void cli_session_init(cli_session * session, cli_output_callback_t output)
+{
+	cli_session * prevSession = cliSession;
 
-	// Add root children
-	cli_add_token(CLI_ROOT_TOKEN_NAME, "");
+	memset(session, 0, sizeof(*session));
+	session->output = output;
 
-	// Init LineBuffer
+	cli_session_select(session);
 	lb_init();
 	lb_set_valid_line_callback(&cli_execute_lb);
 	lb_set_autocomplete_callback(&cli_autocomplete_lb);
-	return 0;
+	cli_session_select(prevSession);
 }
 
 /**
- * @brief Safely copy src into dest with a max length and
- * set the ending string character
- * @details [long description]
+ * @brief Tell how the room left in the output of a session is known
+ * @details Streamed outputs are produced only when the output has room,
+ * without this function they are produced as fast as cli_poll() is called
  *
- * @param dest Pointer
- * @param src Pointer
- * @param maxLen Max length of dest
+ * @param session Pointer
+ * @param outputRoom Pointer on function, NULL if the output never blocks
  */
-void cli_strcpy_safe(char * dest, const char * src, uint16_t maxLen)
+void cli_session_set_output_room(cli_session * session, cli_output_room_callback_t outputRoom)
 {
-	strncpy(dest, src, maxLen);
-	dest[maxLen - 1] = '\0';
+	session->outputRoom = outputRoom;
+	if (session == cliSession) {
+		cli_output_set_room_callback(outputRoom);
+	}
 }
 
 /**
- * @brief Give a string containing the version of CLI
- * @return String pointer
+ * @brief Select the session receiving the next bytes and output
+ * @details Must be called before cli_rx() when several sessions are used
+ *
+ * @param session Pointer, NULL to select the default session
  */
-const char * cli_get_version(void)
+void cli_session_select(cli_session * session)
 {
-	return cliVersionName;
+	cliSession = (session != NULL) ? session : &cliDefaultSession;
+	lb_select_handle(&cliSession->lb);
+	cli_output_set_callback(cliSession->output);
+	cli_output_set_room_callback(cliSession->outputRoom);
 }
 
 /**
- * @brief Add a token to the list of known tokens
+ * @brief Give the selected session
+ * @return Pointer
+ */
+cli_session * cli_session_get(void)
+{
+	return cliSession;
+}
+
+/**
+ * @brief Resolve the lines of the selected session from a token
+ * @details Used in human mode, the prompt gives the path of the token.
+ * Users enter a token by typing it alone and leave with ".." or "exit".
  *
- * @param text The text of the token
- * @param desc The description of the token
- * @return a pointer to the newly created token
+ * @param curTok Token which is not a leaf, NULL for root
+ * @return 0: ok, -1: Error
  */
-cli_token * cli_add_token(const char * text, const char * desc)
+int cli_set_context(cli_token * curTok)
 {
-	cli_token * curTok = NULL;
+	char        prompt[LB_PROMPT_LENGTH];
+	uint16_t    pos = sizeof(prompt) - 3;
+	cli_token * pathTok;
 
-	// Find a not used token (Considered not used if text is not set)
-	for (int i = 0; i < CLI_MAX_TOKEN_COUNT; ++i) {
-		if (tokenList[i].text[0] == '\0') {
-			curTok = &tokenList[i];
-			break;
-		}
+	if (curTok == cli_get_root_token()) {
+		curTok = NULL;
+	} else if ((curTok != NULL) && cli_is_token_a_leaf(curTok)) {
+		DPRINTF(ERROR, "Unable to enter token \"%s\", token is a leaf\n\r", curTok->text);
+		return -1;
 	}
+	cliSession->context           = curTok;
+	cliSession->contextGeneration = (curTok != NULL) ? curTok->generation : 0;
 
-	// Check overflow
 	if (curTok == NULL) {
-		DPRINTF(ERROR, "Unable to add token \"%s\", maximum reach: %u\n\r", curTok->text, CLI_MAX_TOKEN_COUNT);
-		return NULL;
+		lb_set_prompt(NULL);
+		return 0;
 	}
 
-	// Clear and fill the structure
-	memset(curTok, 0, sizeof(*curTok));
-	cli_strcpy_safe(curTok->text, text, CLI_MAX_TEXT_LEN);
-	cli_strcpy_safe(curTok->desc, desc, CLI_MAX_DESC_LEN);
-	curTok->isLeaf = true;
+	// Path written from the end, "<word> ... <word>> "
+	strcpy(&prompt[pos], "> ");
+	for (pathTok = curTok; pathTok != cli_get_root_token(); pathTok = cli_get_parent(pathTok)) {
+		uint16_t len = strlen(pathTok->text);
 
-	return curTok;
+		if (len + 1 > pos) {
+			break; // Too long, the end of the path is kept
+		}
+		pos -= len;
+		memcpy(&prompt[pos], pathTok->text, len);
+		if (cli_get_parent(pathTok) != cli_get_root_token()) {
+			prompt[--pos] = ' ';
+		}
+	}
+	if (prompt[pos] == ' ') {
+		++pos; // Cut path
+	}
+	lb_set_prompt(&prompt[pos]);
+	return 0;
 }
 
 /**
- * @brief Add a children to a token
+ * @brief Give the token the lines of the selected session are resolved from
+ * @details The context is left if it was removed, even if its token was
+ * added again since (The generation changed)
  *
- * @param parent Pointer
- * @param children Pointer
+ * @return Pointer, root if none
+ */
+cli_token * cli_get_context(void)
+{
+	cli_token * context = cliSession->context;
+
+	if (context == NULL) {
+		return cli_get_root_token();
+	}
+
+	if (context->generation != cliSession->contextGeneration) {
+		cli_set_context(NULL);
+		return cli_get_root_token();
+	}
+	return context;
+}
+
+/**
+ * @brief Change the mode of the selected session
+ * @details Can be called from a command callback
  *
- * @return 0: ok, -1: Can't take more children
+ * @param mode CLI_MODE_*
+ * @return 0: ok, -1: Unknown mode
  */
-int cli_add_children(cli_token * parent, cli_token * children)
+int cli_set_mode(uint8_t mode)
 {
-	uint8_t argc = parent->mandatoryArgc + parent->optionalArgc;
-	if (argc > 0) {
-		DPRINTF(ERROR, "Unable to add children for token \"%s\", parent has %u arguments\n\r", parent->text, argc);
+	switch (mode) {
+	case CLI_MODE_HUMAN:
+		lb_set_silent(false);
+		break;
+	case CLI_MODE_MACHINE:
+	case CLI_MODE_BINARY:
+		lb_set_silent(true);
+		break;
+	default:
+		DPRINTF(ERROR, "Unknown mode %u\n\r", mode);
 		return -1;
 	}
 
-	for (uint8_t i = 0; i < CLI_MAX_CHILDS; ++i) {
-		if (parent->childs[i] == NULL) {
-			parent->childs[i] = children;
+	cliSession->mode              = mode;
+	cliSession->machineLineLen    = 0;
+	cliSession->isMachineOverflow = false;
+	cliSession->binState          = CLI_BIN_STATE_SYNC;
+	return 0;
+}
 
-			// Token with children are no longer a leaf
-			parent->isLeaf = false;
-			return 0;
+/**
+ * @brief Give the command ID of a path
+ * @details Host tooling can compute IDs the same way, they don't depend on
+ * the order tokens are added
+ *
+ * @param path Tokens of a command separated by one space (Ex: "lan show")
+ * @return The command ID
+ */
+uint32_t cli_get_command_id(const char * path)
+{
+	return cli_id_hash(CLI_ID_FNV_OFFSET, path);
+}
+
+/**
+ * @brief Print the command ID of all leaves
+ * @details One line per command: "0x<id> <mandatoryArgc> <optionalArgc> <path>"
+ */
+void cli_print_command_ids(void)
+{
+	char path[CLI_ID_PATH_LENGTH];
+
+	path[0] = '\0';
+	cli_id_walk(cli_get_root_token(), path, 0, true);
+}
+
+/**
+ * @brief Write the tree to an image cli_snapshot_import() uses as the tree
+ * @details The tokens are written as they are in memory, they have no
+ * pointer: tokens are linked by index and callbacks, providers and options
+ * by index in symbols, whose names are also written. The image is only valid
+ * for a build with the same cli_config.h, compiler and endianness.
+ *
+ * @param image Where the image is written, aligned on 8 bytes, NULL to only get its size
+ * @param size Size of image
+ * @param symbols Every callback, provider and options used by the tree
+ * @param symbolCount Number of symbols, CLI_MAX_SYMBOLS at most
+ * @return Size of the image, -1: Error
+ */
+int cli_snapshot_export(uint8_t * image, uint32_t size, const cli_symbol_t * symbols, uint16_t symbolCount)
+{
+	cli_snapshot_header_t * header = (cli_snapshot_header_t *) image;
+	cli_token *             tokens;
+	uint32_t                pos = CLI_SNAPSHOT_TOKENS_OFFSET + sizeof(tokenList);
+
+	for (uint16_t i = 0; i < symbolCount; ++i) {
+		pos += strlen(symbols[i].name) + 1;
+	}
+	if (image == NULL) {
+		return pos;
+	}
+	if ((pos > size) || (symbolCount > CLI_MAX_SYMBOLS)) {
+		DPRINTF(ERROR, "Unable to export the tree, %lu bytes and %u symbols are needed\n\r", (unsigned long) pos, symbolCount);
+		return -1;
+	}
+#if (CLI_CONCURRENT_READERS == 1)
+	// Removed tokens are in no list of the image
+	cli_reclaim();
+	if (cliRetired != NULL) {
+		DPRINTF(ERROR, "Unable to export the tree, removed tokens are still read\n\r");
+		return -1;
+	}
+#endif
+
+	tokens = (cli_token *) (image + CLI_SNAPSHOT_TOKENS_OFFSET);
+	memset(image, 0, pos);
+	memcpy(tokens, cliTokens, sizeof(tokenList));
+
+	// Symbols are linked by their index in symbols, free tokens have none
+	for (uint16_t i = 0; i < CLI_MAX_TOKEN_COUNT; ++i) {
+		cli_token * curTok   = &tokens[i];
+		int         callback = cli_snapshot_link_symbol(symbols, symbolCount, curTok->callback);
+		int         provider = cli_snapshot_link_symbol(symbols, symbolCount, curTok->provider);
+		int         options  = cli_snapshot_link_symbol(symbols, symbolCount, curTok->options);
+
+		if ((callback < 0) || (provider < 0) || (options < 0)) {
+			DPRINTF(ERROR, "Unable to export token \"%s\", its callback, provider or options is not a symbol\n\r", curTok->text);
+			return -1;
 		}
+		curTok->callback = callback;
+		curTok->provider = provider;
+		curTok->options  = options;
 	}
 
-	DPRINTF(ERROR, "Unable to add children for token \"%s\", parent has no empty child (CLI_MAX_CHILDS = %d)\n\r", parent->text, CLI_MAX_CHILDS);
-	return -1;
+	pos                   = CLI_SNAPSHOT_TOKENS_OFFSET + sizeof(tokenList);
+	header->symbolsOffset = pos;
+	for (uint16_t i = 0; i < symbolCount; ++i) {
+		uint16_t len = strlen(symbols[i].name) + 1;
+
+		memcpy(&image[pos], symbols[i].name, len);
+		pos += len;
+	}
+
+	header->magic        = CLI_SNAPSHOT_MAGIC;
+	header->size         = pos;
+	header->tokensOffset = CLI_SNAPSHOT_TOKENS_OFFSET;
+	header->version      = CLI_SNAPSHOT_VERSION;
+	header->tokenSize    = sizeof(cli_token);
+	header->tokenCount   = CLI_MAX_TOKEN_COUNT;
+	header->symbolCount  = symbolCount;
+	header->freeToken    = cli_link(cliFreeToken);
+	header->generation   = cliTokenGeneration;
+	header->lazyClock    = cliLazyClock;
+	header->maxChilds    = CLI_MAX_CHILDS;
+	header->maxTextLen   = CLI_MAX_TEXT_LEN;
+#if (CLI_DESC_COMPRESSED == 0)
+	header->maxDescLen = CLI_MAX_DESC_LEN;
+#endif
+	return pos;
 }
 
 /**
- * @brief Set callback
- * @details [long description]
+ * @brief Use an image of cli_snapshot_export() as the tree
+ * @details Only the header and the names of the symbols are checked, the
+ * tokens are used where they are with no copy: the cost does not depend on
+ * the size of the tree. Links are checked when followed, tokens are trusted
+ * otherwise. Changes of the tree (Lazy tokens, modules like
+ * cli_mem_register() registered after) are written into the image, which is
+ * usually a private mapping of a file (See cli_snapshot_load()).
+ * @note cli_init() must be called right before, no reader may walk the tree
  *
- * @param curTok Pointer
- * @param callback Pointer to function
- * @return 0
+ * @param image Pointer, aligned on 8 bytes, writable and valid until cli_init() is called again
+ * @param size Size of image
+ * @param symbols Same names, in the same order, as the ones given to cli_snapshot_export()
+ * @param symbolCount Number of symbols
+ * @return 0: ok, -1: Error (The tree only has root)
  */
-int cli_set_callback(cli_token * curTok, cli_callback_t callback)
+int cli_snapshot_import(uint8_t * image, uint32_t size, const cli_symbol_t * symbols, uint16_t symbolCount)
 {
-	if (!cli_is_token_a_leaf(curTok)) {
-		DPRINTF(ERROR, "Unable to set callback for token \"%s\", token is not a leaf\n\r", curTok->text);
+	const cli_snapshot_header_t * header = (const cli_snapshot_header_t *) image;
+	uint32_t                      pos;
+
+	if ((((uintptr_t) image & 7) != 0) || (size < CLI_SNAPSHOT_TOKENS_OFFSET) || (header->magic != CLI_SNAPSHOT_MAGIC) ||
+		(header->version != CLI_SNAPSHOT_VERSION) || (header->size != size) || (header->tokenSize != sizeof(cli_token)) ||
+		(header->tokenCount != CLI_MAX_TOKEN_COUNT) || (header->maxChilds != CLI_MAX_CHILDS) || (header->maxTextLen != CLI_MAX_TEXT_LEN) ||
+		(header->maxDescLen != ((CLI_DESC_COMPRESSED == 0) ? CLI_MAX_DESC_LEN : 0)) || (header->tokensOffset != CLI_SNAPSHOT_TOKENS_OFFSET) ||
+		(header->symbolsOffset != CLI_SNAPSHOT_TOKENS_OFFSET + sizeof(tokenList)) || (header->symbolCount > CLI_MAX_SYMBOLS) ||
+		(header->freeToken > CLI_MAX_TOKEN_COUNT)) {
+		DPRINTF(ERROR, "Unable to import the tree, the image is not made by this build\n\r");
+		return -1;
+	}
+
+	// Symbols may have changed since the export
+	pos = header->symbolsOffset;
+	for (uint16_t i = 0; i < header->symbolCount; ++i) {
+		uint16_t len = (i < symbolCount) ? strlen(symbols[i].name) + 1 : 0;
+
+		if ((len == 0) || (pos + len > size) || (memcmp(&image[pos], symbols[i].name, len) != 0)) {
+			DPRINTF(ERROR, "Unable to import the tree, symbol %u differs\n\r", i);
+			return -1;
+		}
+		pos += len;
+	}
+
+	// Root, added by cli_init(), is the last token added
+	if ((cliTokens != tokenList) || (cliTokenGeneration != tokenList[0].generation) || (cliSymbolCount != 0)) {
+		DPRINTF(ERROR, "Unable to import the tree, tokens were added\n\r");
 		return -1;
 	}
-	curTok->callback = callback;
+
+	cliTokens          = (cli_token *) (image + header->tokensOffset);
+	cliFreeToken       = cli_get_link(header->freeToken);
+	cliTokenGeneration = header->generation;
+	cliLazyClock       = header->lazyClock;
+	memcpy(cliSymbols, symbols, header->symbolCount * sizeof(cli_symbol_t));
+	cliSymbolCount = header->symbolCount;
+
+	// Command IDs must be found again
+	++cliTreeVersion;
 	return 0;
 }
 
 /**
- * @brief Set the argument counts for this token
- *
- * @param curTok Pointer
- * @param mandatoryArgc uint8_t
- * @param optionalArgc uint8_t
+ * @brief Stream the output of the running command
+ * @details To be called from a command callback. The producer is then called
+ * by cli_poll() each time the output has room for CLI_STREAM_CHUNK_LENGTH bytes,
+ * until it returns 0. The prompt is hidden meanwhile and any key aborts.
  *
+ * @param producer Function writing at most len bytes into buffer, cursor starts at 0
  * @return 0: ok, -1: Error
  */
-int cli_set_argc(cli_token * curTok, uint8_t mandatoryArgc, uint8_t optionalArgc)
+int cli_stream_start(cli_stream_callback_t producer)
 {
-	if (!cli_is_token_a_leaf(curTok)) {
-		DPRINTF(ERROR, "Can't set argument count for token \"%s\": token is not a leaf\n\r", curTok->text);
+	if ((producer == NULL) || (cliSession->stream != NULL)) {
+		DPRINTF(ERROR, "Unable to start stream\n\r");
 		return -1;
 	}
 
-	curTok->mandatoryArgc = mandatoryArgc;
-	curTok->optionalArgc  = optionalArgc;
+	cliSession->stream       = producer;
+	cliSession->streamCursor = 0;
+	if (cliSession->mode == CLI_MODE_HUMAN) {
+		lb_set_silent(true);
+	}
 	return 0;
 }
 
 /**
- * @brief Give the root token pointer
- * @return Pointer to root token
+ * @brief Tell if the selected session is streaming an output
+ * @return boolean
  */
-cli_token * cli_get_root_token(void)
+bool cli_is_streaming(void)
 {
-	return &tokenList[0];
+	return cliSession->stream != NULL;
 }
 
 /**
- * @brief Callback function for LineBuffer
- * @details The definition of this function must follow
- * the one defined in LineBuffer
- * @see lb_autocomplete_callback_t
- *
- * @param str The input command string
- * @param len The length of the str
- * @param outBuffer The buffer where we write the completion
- * @param outBufferMaxLen The length of outBuffer
+ * @brief Receive data after the command line
+ * @details To be called from a command callback. Once the callback returned,
+ * the next bytes received by the selected session are decoded and given to
+ * consumer by chunks of at most CLI_UPLOAD_CHUNK_LENGTH bytes, without going
+ * through the line buffer: no echo, no history and no limit of length.
+ * Text is ended by CLI_UPLOAD_END and aborted by CLI_UPLOAD_ABORT, raw data
+ * is preceded by its length. The consumer is called last with data NULL and
+ * len 0 (Complete, its return is the status of the command) or -1 (Aborted).
+ * A chunk refused by the consumer (return < 0) aborts the upload.
  *
- * @return Number of characters added
+ * @param consumer Function receiving the data
+ * @param encoding CLI_UPLOAD_*
+ * @return 0: ok, -1: Error
  */
-uint8_t cli_autocomplete_lb(const char * str, uint16_t len, char * outBuffer, uint16_t outBufferMaxLen)
+int cli_upload_start(cli_upload_callback_t consumer, uint8_t encoding)
 {
-	char    cmdEdit[CLI_CMD_MAX_LEN]; // Editable copy of str
-	char *  cmdText[CLI_CMD_MAX_TOKEN];
-	uint8_t cmdTextCount;
-	uint8_t countToAdd, countAlreadyWrote;
-
-	// Copy incomming buffer
-	cli_strcpy_safe(cmdEdit, str, CLI_CMD_MAX_LEN);
-
-	// PARSER (Note: cmdTextCount can be 0)
-	cmdTextCount = cli_parse_cmd_text(cmdEdit, cmdText);
+	if ((consumer == NULL) || (encoding > CLI_UPLOAD_RAW) || (cliSession->upload != NULL) || (cliSession->mode == CLI_MODE_BINARY)) {
+		DPRINTF(ERROR, "Unable to start upload\n\r");
+		return -1;
+	}
 
-	// Search for alternatives
-	char * pText = cli_autocomplete(cmdText, cmdTextCount);
-	if (pText == NULL) {
-		DPRINTF(AUTOC, "No unique alternative found\n\r");
-		return 0; // Nothing added
+	cliSession->upload         = consumer;
+	cliSession->uploadEncoding = encoding;
+	cliSession->uploadBits     = 0;
+	cliSession->uploadValue    = 0;
+	cliSession->uploadLen      = 0;
+	if (cliSession->mode == CLI_MODE_HUMAN) {
+		lb_set_silent(true);
 	}
-	DPRINTF(AUTOC, "Found 1 alternative: %s\n\r", pText);
+	return 0;
+}
 
-	countToAdd = strlen(pText); // size we have to write (Ex: 2 -> "ig" for "conf")
+/**
+ * @brief Tell if the selected session is receiving an upload
+ * @return boolean
+ */
+bool cli_is_uploading(void)
+{
+	return cliSession->upload != NULL;
+}
 
-	// Check overflow
-	if (countToAdd > outBufferMaxLen) {
-		// Not enough space to autocomplete, do nothing
-		DPRINTF(ERROR, "Not enough space in line buffer for autocompletion\n\r");
+/**
+ * @brief Let the selected session produce its streamed output
+ * @details To be called from the main loop, produce one chunk if the output has room
+ *
+ * @return Number of bytes written, 0: Nothing to do or no room
+ */
+int cli_poll(void)
+{
+	if ((cliSession->stream == NULL) || (cli_output_get_room() < CLI_STREAM_CHUNK_LENGTH)) {
 		return 0;
 	}
+	return cli_stream_produce();
+}
 
-	// Append the text to add and update max len
-	cli_strcpy_safe(outBuffer, pText, outBufferMaxLen);
-	outBufferMaxLen -= countToAdd;
-	DPRINTF(AUTOC, "Adding %u bytes\n\r", countToAdd);
-
-	// Append an extra space (" ") if there is enough memory
-	if (outBufferMaxLen >= 1) {
-		DPRINTF(AUTOC, "Adding extra space\n\r");
-		cli_strcpy_safe(outBuffer + countToAdd, " ", outBufferMaxLen);
-		countToAdd += 1;
-	}
+/**
+ * @brief Give the time to the CLI
+ * @details To be called from the main loop, at least every CLI_WATCH_TICK_MS
+ * while cli_watch_get_job_count() > 0, pending DPRINTF() are printed (See cli_log_flush())
+ *
+ * @param nowMs Monotonic time in ms (may wrap)
+ */
+void cli_tick(uint32_t nowMs)
+{
+	cliTickMs   = nowMs;
+	cliIsTicked = true;
+	cli_watch_tick(nowMs);
+	cli_log_flush();
+}
 
-	return countToAdd;
+/**
+ * @brief Give the time of the last cli_tick()
+ * @return Time in ms
+ */
+uint32_t cli_get_tick(void)
+{
+	return cliTickMs;
 }
 
 /**
- * @brief Callback function for LineBuffer
- * @details The definition of this function must follow
- * the one defined in LineBuffer
- * @see lb_line_callback_t
+ * @brief Give the memory used by the CLI
+ * @details Stack figures are the highest seen since cli_init(),
+ * commands must have been run to get them
  *
- * @param str The input command string
- * @param len The length of the str
- *
- * @return The result of the command
+ * @param stats Filled structure
  */
-int cli_execute_lb(const char * str, uint16_t len)
+void cli_get_memory_stats(cli_memory_stats_t * stats)
 {
-	char    cmdEdit[CLI_CMD_MAX_LEN]; // Editable copy of str
-	char *  cmdText[CLI_CMD_MAX_TOKEN];
-	uint8_t cmdTextCount;
+	memset(stats, 0, sizeof(*stats));
+	stats->tokenListBytes         = sizeof(tokenList);
+	stats->sessionBytes           = sizeof(cli_session);
+	stats->lbHandleBytes          = sizeof(lb_handle_t);
+	stats->tokenCapacity          = CLI_MAX_TOKEN_COUNT;
+	stats->childCapacity          = CLI_MAX_TOKEN_COUNT * CLI_MAX_CHILDS;
+	stats->historySize            = lb_get_history_size();
+	stats->historyCapacity        = LB_HISTORY_COUNT * LB_LINE_BUFFER_LENGTH;
+	stats->executeStackBytes      = cliStackExecute;
+	stats->autocompleteStackBytes = cliStackAutocomplete;
+
+	for (uint16_t i = 0; i < CLI_MAX_TOKEN_COUNT; ++i) {
+		cli_token * curTok = &cliTokens[i];
+		uint8_t     childCount;
+		uint8_t     len;
+
+		if (curTok->text[0] == '\0') {
+			continue; // Not used
+		}
+		++stats->tokenCount;
 
-	// Copy incomming buffer
-	cli_strcpy_safe(cmdEdit, str, CLI_CMD_MAX_LEN);
+		childCount = cli_get_children_count(curTok);
+		stats->childCount += childCount;
+		if (childCount > stats->maxChildCount) {
+			stats->maxChildCount = childCount;
+		}
 
-	// PARSER
-	cmdTextCount = cli_parse_cmd_text(cmdEdit, cmdText);
-	if (cmdTextCount <= 0) {
-		return 0;
+		len = strlen(curTok->text) + 1;
+		if (len > stats->maxTextLen) {
+			stats->maxTextLen = len;
+		}
+#if (CLI_DESC_COMPRESSED == 0)
+		len = strlen(curTok->desc) + 1;
+		if (len > stats->maxDescLen) {
+			stats->maxDescLen = len;
+		}
+#endif
+	}
+}
+
+/**
+ * @brief Callback of the "mem" command
+ *
+ * @param argc UNUSED
+ * @param argv UNUSED
+ * @return 0
+ */
+static int cli_cb_mem(uint8_t argc, char * argv[])
+{
+	cli_memory_stats_t stats;
+
+	(void) argc;
+	(void) argv;
+	cli_get_memory_stats(&stats);
+	CLI_PRINTF("Tokens       %5u / %-5u (%lu B)\n\r", stats.tokenCount, stats.tokenCapacity, (unsigned long) stats.tokenListBytes);
+	CLI_PRINTF("Child slots  %5u / %-5u (max %u per token, CLI_MAX_CHILDS = %d)\n\r", stats.childCount, stats.childCapacity, stats.maxChildCount, CLI_MAX_CHILDS);
+	CLI_PRINTF("Text         %5u / %-5u B\n\r", stats.maxTextLen, CLI_MAX_TEXT_LEN);
+#if (CLI_DESC_COMPRESSED == 1)
+	CLI_PRINTF("Description  compressed\n\r");
+#else
+	CLI_PRINTF("Description  %5u / %-5u B\n\r", stats.maxDescLen, CLI_MAX_DESC_LEN);
+#endif
+	CLI_PRINTF("History      %5u / %-5u B\n\r", stats.historySize, stats.historyCapacity);
+	CLI_PRINTF("Session      %5u B (line buffer %u B)\n\r", stats.sessionBytes, stats.lbHandleBytes);
+#if (CLI_STACK_PROBE_LENGTH > 0)
+	CLI_PRINTF("Stack        %5u B execute, %u B autocomplete (CLI_STACK_PROBE_LENGTH = %d)\n\r",
+			   stats.executeStackBytes, stats.autocompleteStackBytes, CLI_STACK_PROBE_LENGTH);
+	if ((stats.executeStackBytes >= CLI_STACK_PROBE_LENGTH) || (stats.autocompleteStackBytes >= CLI_STACK_PROBE_LENGTH)) {
+		CLI_PRINTF("Stack probe saturated, raise CLI_STACK_PROBE_LENGTH\n\r");
 	}
+#else
+	CLI_PRINTF("Stack        stack probe disabled, not measured (CLI_STACK_PROBE_LENGTH = 0)\n\r");
+#endif
+	return 0;
+}
+
+/**
+ * @brief Add the "mem" command printing cli_get_memory_stats()
+ *
+ * @param parent Token receiving the command (Ex: root)
+ * @return 0: ok, -1: Error
+ */
+int cli_mem_register(cli_token * parent)
+{
+	cli_token * curTok = cli_add_token("mem", CLI_DESC(mem, "Memory used by the CLI"));
 
-	return cli_execute(cmdText, cmdTextCount);
+	if (curTok == NULL) {
+		return -1;
+	}
+	cli_set_callback(curTok, &cli_cb_mem);
+	return cli_add_children(parent, curTok);
 }
 
 /**
@@ -657,7 +3774,18 @@ int cli_execute_lb(const char * str, uint16_t len)
  */
 void cli_rx(uint8_t byte)
 {
-	lb_rx(byte);
+	CLI_TRACE(RX, CLI_TRACE_NO_TOKEN, byte);
+	if (cliSession->stream != NULL) {
+		cli_stream_stop(true); // Any key aborts
+	} else if (cliSession->upload != NULL) {
+		cli_upload_rx(byte);
+	} else if (cliSession->mode == CLI_MODE_MACHINE) {
+		cli_machine_rx(byte);
+	} else if (cliSession->mode == CLI_MODE_BINARY) {
+		cli_bin_rx(byte);
+	} else {
+		lb_rx(byte);
+	}
 }
 
 /**
@@ -13,6 +13,17 @@
 #include "cli_config.h"
 #include "line_buffer.h"
 
+#if (CLI_DESC_COMPRESSED == 1)
+#include "cli_desc_ids.h" // Generated by tools/cli_desc_gen.c
+#endif
+
+#if (CLI_CONCURRENT_READERS == 1)
+#include <stdatomic.h>
+#define CLI_ATOMIC(type) _Atomic(type) /**< Shared between readers and the writer */
+#else
+#define CLI_ATOMIC(type) type
+#endif
+
 // ======================
 // Constants
 // ======================
@@ -23,38 +34,214 @@
 #define CLI_CMD_MAX_LEN     LB_LINE_BUFFER_LENGTH /**< Maximum length of a line */
 #define CLI_ROOT_TOKEN_NAME "."                   /**< Name of the root token */
 
+#define CLI_MODE_HUMAN   0 /**< Line edition, echo, history and prompt */
+#define CLI_MODE_MACHINE 1 /**< No echo, each line is answered with "<status> <length>\n<output>" */
+#define CLI_MODE_BINARY  2 /**< No echo, binary requests are answered with binary frames (See README) */
+
+#define CLI_BIN_SYNC    0xA5 /**< First byte of a binary frame */
+#define CLI_BIN_ID_EXIT 0    /**< Command ID of the request going back to human mode */
+
+#define CLI_UPLOAD_HEX    0    /**< Uploaded data is hexadecimal text, ended by CLI_UPLOAD_END */
+#define CLI_UPLOAD_BASE64 1    /**< Uploaded data is base64 text, ended by CLI_UPLOAD_END */
+#define CLI_UPLOAD_RAW    2    /**< Uploaded data is a 32 bits big endian length followed by the bytes */
+#define CLI_UPLOAD_END    '.'  /**< End of a hexadecimal or base64 upload */
+#define CLI_UPLOAD_ABORT  0x03 /**< Abort a hexadecimal or base64 upload (Ctrl-C) */
+
+/**
+ * Description given to cli_add_token(), the id is a C identifier naming the
+ * text once compressed (Ex: CLI_DESC(lan, "LAN configuration"))
+ */
+#if (CLI_DESC_COMPRESSED == 1)
+#define CLI_DESC(id, text) CLI_DESC_ID_##id
+#else
+#define CLI_DESC(id, text) text
+#endif
+
+// Entries of the symbols given to cli_snapshot_export(), named after the C identifier
+#define CLI_SYMBOL_CALLBACK(fn)     { #fn, &fn, NULL, NULL }           /**< Callback of leaves */
+#define CLI_SYMBOL_PROVIDER(fn)     { #fn, NULL, &fn, NULL }           /**< Provider of lazy tokens */
+#define CLI_SYMBOL_OPTIONS(options) { #options, NULL, NULL, options } /**< Options of leaves */
+
 // ======================
 // Typedefs and structs
 // ======================
 
-typedef int (*cli_callback_t)(uint8_t argc, char * argv[]); /**< Prototype of the function callable by cli commands */
+typedef int (*cli_callback_t)(uint8_t argc, char * argv[]);                        /**< Prototype of the function callable by cli commands */
+typedef int (*cli_stream_callback_t)(uint32_t * cursor, char * buffer, uint16_t len); /**< Prototype of the function producing a streamed output (See cli_stream_start()) */
+typedef int (*cli_upload_callback_t)(const uint8_t * data, int16_t len);              /**< Prototype of the function consuming uploaded data (See cli_upload_start()) */
+
+#if (CLI_DESC_COMPRESSED == 1)
+typedef uint16_t cli_desc_t; /**< Index of the description in the generated blob */
+#else
+typedef const char * cli_desc_t; /**< Text of the description */
+#endif
+
+/**
+ * Option of a leaf, given anywhere after it (Ex: -v, --verbose)
+ */
+typedef struct {
+	char         shortName; /**< 'v' for "-v", '\0' if none */
+	const char * longName;  /**< "verbose" for "--verbose", NULL if none */
+	cli_desc_t   desc;      /**< Printed in the usage */
+	bool         isCounted; /**< true: each use is counted (-vvv), false: given or not */
+} cli_option_t;
+
+/**
+ * Options given to the command being called (See cli_get_option_values())
+ */
+typedef struct {
+	uint32_t mask;                    /**< Bit i is set if options[i] was given */
+	uint8_t  counts[CLI_MAX_OPTIONS]; /**< Number of times options[i] was given, at most 1 if not counted */
+} cli_option_values_t;
+
+typedef struct cli_token_t cli_token;              /**< Needed because we have self pointer into this structure */
+typedef int (*cli_provider_t)(cli_token * parent); /**< Prototype of the function adding the children of a lazy token (See cli_set_provider()) */
+typedef uint16_t cli_link_t;                       /**< Index + 1 of a token or a symbol, 0 if none (Tokens hold no pointer, See cli_snapshot_import()) */
+typedef CLI_ATOMIC(cli_link_t) cli_child_t;        /**< Child slot, a reader sees a token in it or none */
 
-typedef struct cli_token_t cli_token; /**< Needed because we have self pointer into this structure */
 struct cli_token_t {
-	char           text[CLI_MAX_TEXT_LEN]; /**< Name of the token */
-	char           desc[CLI_MAX_DESC_LEN]; /**< Description of the token */
-	cli_token *    childs[CLI_MAX_CHILDS]; /**< Pointer to all token child (None if leaf) */
-	uint8_t        mandatoryArgc;          /**< Number of mandatory argument of the leaf */
-	uint8_t        optionalArgc;           /**< Number of optional argument of the leaf */
-	cli_callback_t callback;               /**< Function to call when user type the command */
-	uint8_t        isLeaf : 1;             /**< Tell if token is a leaf */
+	char                 text[CLI_MAX_TEXT_LEN]; /**< Name of the token */
+#if (CLI_DESC_COMPRESSED == 1)
+	cli_desc_t           desc;                   /**< Description of the token, decoded when printed */
+#else
+	char                 desc[CLI_MAX_DESC_LEN]; /**< Description of the token */
+#endif
+	cli_child_t          childs[CLI_MAX_CHILDS]; /**< Link to all token child (None if leaf) */
+	cli_link_t           parent;                 /**< Token having this one as child, 0 if not added yet */
+	uint8_t              mandatoryArgc;          /**< Number of mandatory argument of the leaf */
+	uint8_t              optionalArgc;           /**< Number of optional argument of the leaf */
+	cli_link_t           callback;               /**< Symbol of the function to call when user type the command, 0 if none */
+	cli_link_t           options;                /**< Symbol of the options of the leaf, 0 if none */
+	uint8_t              optionCount;            /**< Number of options */
+	cli_link_t           provider;               /**< Symbol of the function adding the children on first use, 0 if not lazy */
+	uint16_t             lastUse;                /**< Value of the use counter when a lazy token was last entered */
+	uint16_t             patternMin;             /**< Smallest number matched after text by a pattern token */
+	uint16_t             patternMax;             /**< Greatest number matched after text by a pattern token */
+	uint16_t             cacheTtl;               /**< Time in ms the output of the leaf is reused, 0 if not cached (See cli_set_cache()) */
+	uint8_t              isMaterialized : 1;     /**< Tell if the provider added the children */
+	uint8_t              isPattern : 1;          /**< Tell if the token matches "<text><number>" (See cli_set_pattern()) */
+	uint8_t              isThreadSafe : 1;       /**< Tell if the callback can run along other ones (See cli_set_thread_safe()) */
+	CLI_ATOMIC(uint16_t) generation;             /**< Given when the token is added, 0 once removed, tells a kept pointer the token was reused */
+#if (CLI_CONCURRENT_READERS == 1)
+	cli_link_t           retiredNext;            /**< Next removed subtree waiting for the readers to leave */
+	uint32_t             retiredEpoch;           /**< Reader epoch when the subtree was removed */
+#endif
 };
 
+/**
+ * Callback, provider or options named in an image of the tree (See cli_snapshot_export())
+ */
+typedef struct {
+	const char *         name;     /**< Written in the image, checked by cli_snapshot_import() */
+	cli_callback_t       callback; /**< Callback of leaves, NULL if the symbol is not one */
+	cli_provider_t       provider; /**< Provider of lazy tokens, NULL if the symbol is not one */
+	const cli_option_t * options;  /**< Options of leaves, NULL if the symbol is not one */
+} cli_symbol_t;
+
+/**
+ * Memory used by the CLI, to tune cli_config.h
+ */
+typedef struct {
+	uint32_t tokenListBytes;         /**< Static size of the token list */
+	uint16_t sessionBytes;           /**< Size of a session (Each one has a line buffer) */
+	uint16_t lbHandleBytes;          /**< Size of a line buffer handle */
+	uint16_t tokenCount;             /**< Number of tokens used */
+	uint16_t tokenCapacity;          /**< CLI_MAX_TOKEN_COUNT */
+	uint16_t childCount;             /**< Number of child slots used */
+	uint16_t childCapacity;          /**< Number of child slots allocated */
+	uint8_t  maxChildCount;          /**< Highest number of children of a token (vs CLI_MAX_CHILDS) */
+	uint8_t  maxTextLen;             /**< Longest token text with '\0' (vs CLI_MAX_TEXT_LEN) */
+	uint8_t  maxDescLen;             /**< Longest description with '\0' (vs CLI_MAX_DESC_LEN, 0 if compressed) */
+	uint16_t historySize;            /**< Bytes of history used by the selected session */
+	uint16_t historyCapacity;        /**< Bytes of history allocated per session */
+	uint16_t executeStackBytes;      /**< Highest stack used by cli_execute_lb() (0 if not measured) */
+	uint16_t autocompleteStackBytes; /**< Highest stack used by cli_autocomplete_lb() (0 if not measured) */
+} cli_memory_stats_t;
+
+/**
+ * State of a user of the CLI (serial port, network connection, ...)
+ */
+typedef struct {
+	lb_handle_t                lb;                                   /**< Line buffer of the session */
+	cli_output_callback_t      output;                               /**< Where the output of the session goes, NULL for stdout */
+	cli_output_room_callback_t outputRoom;                           /**< Room left in output, NULL if unknown */
+	cli_stream_callback_t      stream;                               /**< Producer of the streamed output in progress, NULL if none */
+	uint32_t                   streamCursor;                         /**< Progress of the streamed output, owned by the producer */
+	cli_upload_callback_t      upload;                               /**< Consumer of the upload in progress, NULL if none */
+	uint8_t                    uploadEncoding;                       /**< CLI_UPLOAD_* */
+	uint8_t                    uploadBits;                           /**< Bits pending in uploadValue (Text), bytes of the length received (Raw) */
+	uint32_t                   uploadValue;                          /**< Bits being decoded (Text), bytes left to receive (Raw) */
+	uint16_t                   uploadLen;                            /**< Number of bytes in uploadChunk */
+	uint8_t                    uploadChunk[CLI_UPLOAD_CHUNK_LENGTH]; /**< Decoded bytes not given to the consumer yet */
+	uint8_t                    mode;                                 /**< CLI_MODE_* */
+	cli_token *                context;                              /**< Token lines are resolved from in human mode, NULL for root (See cli_set_context()) */
+	uint16_t                   contextGeneration;                    /**< Generation of context when it was entered */
+	uint8_t                    machineLineLen;                       /**< Size of machineLine */
+	uint8_t                    isMachineOverflow : 1;                /**< Tell if the line being received in machine mode is too long */
+	char                       machineLine[CLI_CMD_MAX_LEN];         /**< Line being received in machine mode */
+	uint8_t                    binState;                             /**< Progress of the binary frame being received */
+	uint16_t                   binLen;                               /**< Length of the binary frame being received */
+	uint16_t                   binPos;                               /**< Number of bytes of the frame received */
+	uint8_t                    binFrame[CLI_BIN_FRAME_LENGTH + 1];   /**< Binary frame being received (+1 to terminate the last argument) */
+} cli_session;
+
 // ======================
 // Protoypes
 // ======================
 
-int          cli_init(void);
-void         cli_strcpy_safe(char * dest, const char * src, uint16_t maxLen);
-const char * cli_get_version(void);
-cli_token *  cli_add_token(const char * text, const char * desc);
-int          cli_add_children(cli_token * parent, cli_token * children);
-int          cli_set_callback(cli_token * curTok, cli_callback_t callback);
-int          cli_set_argc(cli_token * curTok, uint8_t mandatoryArgc, uint8_t optionalArgc);
-cli_token *  cli_get_root_token(void);
-uint8_t      cli_autocomplete_lb(const char * str, uint16_t len, char * outBuffer, uint16_t outBufferMaxLen);
-int          cli_execute_lb(const char * str, uint16_t len);
-void         cli_rx(uint8_t byte);
-void         cli_exit(void);
+int           cli_init(void);
+void          cli_strcpy_safe(char * dest, const char * src, uint16_t maxLen);
+const char *  cli_get_version(void);
+cli_token *   cli_add_token(const char * text, cli_desc_t desc);
+int           cli_add_children(cli_token * parent, cli_token * children);
+int           cli_remove_children(cli_token * parent, cli_token * children);
+int           cli_remove_token(cli_token * curTok);
+int           cli_set_callback(cli_token * curTok, cli_callback_t callback);
+int           cli_set_argc(cli_token * curTok, uint8_t mandatoryArgc, uint8_t optionalArgc);
+int           cli_set_pattern(cli_token * curTok, uint16_t min, uint16_t max);
+int           cli_set_thread_safe(cli_token * curTok, bool isThreadSafe);
+int           cli_set_cache(cli_token * curTok, uint16_t ttlMs);
+int           cli_set_options(cli_token * curTok, const cli_option_t * options, uint8_t count);
+uint8_t       cli_get_option(uint8_t index);
+void          cli_get_option_values(cli_option_values_t * values);
+void          cli_set_option_values(const cli_option_values_t * values);
+int           cli_set_provider(cli_token * curTok, cli_provider_t provider);
+void          cli_invalidate(cli_token * curTok);
+void          cli_hold_lazy_tokens(bool isHeld);
+void          cli_cache_invalidate(cli_token * curTok);
+cli_token *   cli_get_root_token(void);
+cli_token *   cli_get_token(uint8_t index);
+uint8_t       cli_get_token_index(cli_token * curTok);
+uint8_t       cli_read_lock(void);
+void          cli_read_unlock(uint8_t lock);
+void          cli_print_tree(cli_token * curTok);
+uint8_t       cli_autocomplete_lb(const char * str, uint16_t len, char * outBuffer, uint16_t outBufferMaxLen);
+int           cli_execute_lb(const char * str, uint16_t len);
+int           cli_execute_capture(const char * line, char * buffer, uint16_t size, int * status);
+int           cli_execute_chunked(const char * line, cli_output_callback_t chunk, int * status);
+int           cli_resolve_lb(char * line, char * cmdText[], cli_token ** curTok, uint8_t * argc);
+int           cli_call_resolved(cli_token * curTok, uint8_t argc, char * argv[]);
+void          cli_session_init(cli_session * session, cli_output_callback_t output);
+void          cli_session_set_output_room(cli_session * session, cli_output_room_callback_t outputRoom);
+void          cli_session_select(cli_session * session);
+cli_session * cli_session_get(void);
+int           cli_set_context(cli_token * curTok);
+cli_token *   cli_get_context(void);
+int           cli_set_mode(uint8_t mode);
+uint32_t      cli_get_command_id(const char * path);
+void          cli_print_command_ids(void);
+int           cli_snapshot_export(uint8_t * image, uint32_t size, const cli_symbol_t * symbols, uint16_t symbolCount);
+int           cli_snapshot_import(uint8_t * image, uint32_t size, const cli_symbol_t * symbols, uint16_t symbolCount);
+int           cli_stream_start(cli_stream_callback_t producer);
+bool          cli_is_streaming(void);
+int           cli_upload_start(cli_upload_callback_t consumer, uint8_t encoding);
+bool          cli_is_uploading(void);
+int           cli_poll(void);
+void          cli_tick(uint32_t nowMs);
+void          cli_get_memory_stats(cli_memory_stats_t * stats);
+int           cli_mem_register(cli_token * parent);
+uint32_t      cli_get_tick(void);
+void          cli_rx(uint8_t byte);
+void          cli_exit(void);
 
 #endif /* CLI_H */
\ No newline at end of file
@@ -0,0 +1,319 @@
+#include "cli_batch.h"
+
+#include <pthread.h>
+
+#if (CLI_BATCH == 0)
+#error "cli_batch.c is built without CLI_BATCH=1, outputs of the workers would be shared"
+#endif
+
+#define CLI_BATCH_C
+#include "cli_debug.h"
+
+/**
+ * A thread safe command, resolved by the caller and called by a worker
+ */
+typedef struct {
+	cli_batch_job_t *   job;                        /**< Where the result goes */
+	cli_token *         token;                      /**< Leaf of the command */
+	uint8_t             argIndex;                   /**< Index of the first argument in cmdText */
+	uint8_t             argc;                       /**< Number of arguments */
+	uint8_t             isTruncated : 1;            /**< Tell if output of job is full */
+	uint16_t            outputLen;                  /**< Number of bytes written in output of job */
+	cli_option_values_t options;                    /**< Options of the command */
+	char *              cmdText[CLI_CMD_MAX_TOKEN]; /**< Words of line */
+	char                line[CLI_CMD_MAX_LEN];      /**< The command, split in place */
+} cli_batch_slot_t;
+
+// Global variables
+typedef struct {
+	cli_batch_slot_t slots[CLI_BATCH_RUN_LENGTH]; /**< Commands of the run */
+	uint16_t         slotCount;                   /**< Number of commands of the run */
+	uint16_t         nextSlot;                    /**< Next command to call */
+	uint16_t         busyCount;                   /**< Number of commands being called */
+#if (CLI_BATCH_WORKERS > 0)
+	pthread_t        workers[CLI_BATCH_WORKERS];  /**< Threads calling the commands */
+#endif
+	uint8_t          workerCount;                 /**< Number of started workers, commands are called by the caller if 0 */
+	uint8_t          isClosing : 1;               /**< Tell workers to stop */
+	pthread_mutex_t  lock;                        /**< Protects the run counters and isClosing, not the slots */
+	pthread_cond_t   runReady;                    /**< Signaled when a run is given to the workers */
+	pthread_cond_t   runDone;                     /**< Signaled when the last command of a run returned */
+} cli_batch_t;
+cli_batch_t cliBatch = {
+	.lock     = PTHREAD_MUTEX_INITIALIZER,
+	.runReady = PTHREAD_COND_INITIALIZER,
+	.runDone  = PTHREAD_COND_INITIALIZER,
+};
+static CLI_THREAD_LOCAL cli_batch_slot_t * cliBatchSlot; /**< Command being called by this thread */
+
+// ===================
+//      STATIC
+// ===================
+
+/**
+ * @brief Output callback of the command being called by this thread
+ * @see cli_output_callback_t
+ *
+ * @param str Bytes to write
+ * @param len Number of bytes
+ * @return Number of bytes written
+ */
+static int cli_batch_output(const char * str, uint16_t len)
+{
+	cli_batch_job_t * job     = cliBatchSlot->job;
+	uint16_t          freeLen = job->outputSize - 1 - cliBatchSlot->outputLen; // Keep room for '\0'
+
+	if (len > freeLen) {
+		cliBatchSlot->isTruncated = true;
+		len                       = freeLen;
+	}
+	memcpy(job->output + cliBatchSlot->outputLen, str, len);
+	cliBatchSlot->outputLen += len;
+	return len;
+}
+
+/**
+ * @brief Output callback dropping everything
+ * @see cli_output_callback_t
+ *
+ * @param str UNUSED
+ * @param len Number of bytes
+ * @return len
+ */
+static int cli_batch_discard(const char * str, uint16_t len)
+{
+	(void) str;
+	return len;
+}
+
+/**
+ * @brief Call the command of a slot with its output written in its job
+ *
+ * @param slot Pointer
+ */
+static void cli_batch_call(cli_batch_slot_t * slot)
+{
+	cli_output_callback_t prevOutput = cli_output_get_callback();
+	cli_batch_job_t *     job        = slot->job;
+
+	slot->outputLen   = 0;
+	slot->isTruncated = false;
+	cliBatchSlot      = slot;
+	cli_output_set_callback(&cli_batch_output);
+	cli_set_option_values(&slot->options);
+
+	job->status = cli_call_resolved(slot->token, slot->argc, &slot->cmdText[slot->argIndex]);
+
+	cli_output_set_callback(prevOutput);
+	job->output[slot->outputLen] = '\0';
+	job->outputLen               = slot->isTruncated ? -1 : slot->outputLen;
+}
+
+#if (CLI_BATCH_WORKERS > 0)
+/**
+ * @brief Thread calling the commands of the runs until cli_batch_close()
+ *
+ * @param arg UNUSED
+ * @return NULL
+ */
+static void * cli_batch_worker(void * arg)
+{
+	(void) arg;
+	pthread_mutex_lock(&cliBatch.lock);
+	while (1) {
+		cli_batch_slot_t * slot;
+
+		while ((cliBatch.isClosing == false) && (cliBatch.nextSlot >= cliBatch.slotCount)) {
+			pthread_cond_wait(&cliBatch.runReady, &cliBatch.lock);
+		}
+		if (cliBatch.isClosing) {
+			break;
+		}
+		slot = &cliBatch.slots[cliBatch.nextSlot++];
+		++cliBatch.busyCount;
+		pthread_mutex_unlock(&cliBatch.lock);
+
+		cli_batch_call(slot);
+
+		pthread_mutex_lock(&cliBatch.lock);
+		--cliBatch.busyCount;
+		if ((cliBatch.nextSlot >= cliBatch.slotCount) && (cliBatch.busyCount == 0)) {
+			pthread_cond_signal(&cliBatch.runDone);
+		}
+	}
+	pthread_mutex_unlock(&cliBatch.lock);
+	return NULL;
+}
+#endif
+
+/**
+ * @brief Call the first commands of the slots and wait for them
+ *
+ * @param slotCount Number of commands
+ */
+static void cli_batch_run(uint16_t slotCount)
+{
+	if (slotCount == 0) {
+		return;
+	} else if (cliBatch.workerCount == 0) {
+		for (uint16_t i = 0; i < slotCount; ++i) {
+			cli_batch_call(&cliBatch.slots[i]);
+		}
+		return;
+	}
+
+	pthread_mutex_lock(&cliBatch.lock);
+	cliBatch.slotCount = slotCount;
+	cliBatch.nextSlot  = 0;
+	pthread_cond_broadcast(&cliBatch.runReady);
+	while ((cliBatch.nextSlot < cliBatch.slotCount) || (cliBatch.busyCount > 0)) {
+		pthread_cond_wait(&cliBatch.runDone, &cliBatch.lock);
+	}
+	cliBatch.slotCount = 0;
+	cliBatch.nextSlot  = 0;
+	pthread_mutex_unlock(&cliBatch.lock);
+}
+
+/**
+ * @brief Find the leaf of a command, to be called by a worker
+ *
+ * @param job The command
+ * @param slot Where the command is resolved
+ * @return true: Thread safe command, false: Serial command or Error
+ */
+static bool cli_batch_resolve(cli_batch_job_t * job, cli_batch_slot_t * slot)
+{
+	cli_output_callback_t prevOutput = cli_output_get_callback();
+	cli_session *         session    = cli_session_get();
+	uint8_t               prevMode   = session->mode;
+	int                   argIndex;
+
+	if ((job->output == NULL) || (job->outputSize == 0)) {
+		return false; // cli_execute_capture() fails too
+	}
+
+	// Errors are printed when the command is executed as a serial one
+	cli_output_set_callback(&cli_batch_discard);
+	cli_strcpy_safe(slot->line, job->line, CLI_CMD_MAX_LEN);
+
+	// Found from root in machine mode, like serial commands by cli_execute_capture()
+	session->mode = CLI_MODE_MACHINE;
+	argIndex      = cli_resolve_lb(slot->line, slot->cmdText, &slot->token, &slot->argc);
+	session->mode = prevMode;
+	cli_output_set_callback(prevOutput);
+
+	if ((argIndex < 0) || (slot->token->isThreadSafe == false)) {
+		return false;
+	}
+	slot->job      = job;
+	slot->argIndex = argIndex;
+	cli_get_option_values(&slot->options);
+	return true;
+}
+
+// ===================
+//       EXTERN
+// ===================
+
+/**
+ * @brief Start the workers of cli_batch_execute()
+ * @details Without workers, commands are called by the caller
+ *
+ * @return 0: ok, -1: Error
+ */
+int cli_batch_open(void)
+{
+#if (CLI_BATCH_WORKERS > 0)
+	if (cliBatch.workerCount > 0) {
+		DPRINTF(ERROR, "Workers are already started\n\r");
+		return -1;
+	}
+
+	cliBatch.isClosing = false;
+	for (uint8_t i = 0; i < CLI_BATCH_WORKERS; ++i) {
+		if (pthread_create(&cliBatch.workers[i], NULL, &cli_batch_worker, NULL) != 0) {
+			DPRINTF(ERROR, "Unable to start worker %u\n\r", i);
+			cli_batch_close();
+			return -1;
+		}
+		++cliBatch.workerCount;
+	}
+	DPRINTF(INFO, "%u workers started\n\r", cliBatch.workerCount);
+#endif
+	return 0;
+}
+
+/**
+ * @brief Execute commands, the thread safe ones at the same time
+ * @details Consecutive thread safe commands (See cli_set_thread_safe()) are
+ * called by the workers, by runs of CLI_BATCH_RUN_LENGTH at most. Other
+ * commands wait for the previous ones and are executed alone by the caller,
+ * like cli_execute_capture(). Results are written in each job, in any case
+ * as if the commands were executed one after the other. A command whose lazy
+ * tokens need an eviction while others wait is executed alone too.
+ *
+ * @param jobs Commands, their output and outputSize must be set
+ * @param count Number of commands
+ * @return 0: ok, -1: Error
+ */
+int cli_batch_execute(cli_batch_job_t * jobs, uint16_t count)
+{
+	cli_option_values_t callerOptions;
+	uint16_t            slotCount = 0;
+	bool                isResolved;
+	uint8_t             lock;
+
+	if (jobs == NULL) {
+		DPRINTF(ERROR, "No jobs\n\r");
+		return -1;
+	}
+
+	cli_get_option_values(&callerOptions);
+	lock = cli_read_lock();
+	for (uint16_t i = 0; i < count; ++i) {
+		cli_batch_job_t * job = &jobs[i];
+
+		job->status = -1;
+
+		// Leaves of the waiting commands must not be evicted by the lazy tokens of this one
+		cli_hold_lazy_tokens(slotCount > 0);
+		isResolved = cli_batch_resolve(job, &cliBatch.slots[slotCount]);
+		cli_hold_lazy_tokens(false);
+
+		if (isResolved) {
+			if (++slotCount == CLI_BATCH_RUN_LENGTH) {
+				cli_batch_run(slotCount);
+				slotCount = 0;
+			}
+			continue;
+		}
+
+		// Serial commands wait for the previous ones
+		cli_batch_run(slotCount);
+		slotCount      = 0;
+		job->outputLen = cli_execute_capture(job->line, job->output, job->outputSize, &job->status);
+	}
+	cli_batch_run(slotCount);
+	cli_read_unlock(lock);
+	cli_set_option_values(&callerOptions);
+	return 0;
+}
+
+/**
+ * @brief Stop the workers
+ */
+void cli_batch_close(void)
+{
+#if (CLI_BATCH_WORKERS > 0)
+	pthread_mutex_lock(&cliBatch.lock);
+	cliBatch.isClosing = true;
+	pthread_cond_broadcast(&cliBatch.runReady);
+	pthread_mutex_unlock(&cliBatch.lock);
+
+	for (uint8_t i = 0; i < cliBatch.workerCount; ++i) {
+		pthread_join(cliBatch.workers[i], NULL);
+	}
+	cliBatch.workerCount = 0;
+	cliBatch.isClosing   = false;
+#endif
+}
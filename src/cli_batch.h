@@ -0,0 +1,33 @@
+#ifndef CLI_BATCH_H
+#define CLI_BATCH_H
+
+// ======================
+// Includes
+// ======================
+
+#include "cli.h"
+
+// ======================
+// Typedefs and structs
+// ======================
+
+/**
+ * A command of cli_batch_execute()
+ */
+typedef struct {
+	const char * line;       /**< The command (Ex: "lan show eth0") */
+	char *       output;     /**< Where the output is written, '\0' terminated */
+	uint16_t     outputSize; /**< Size of output */
+	int          outputLen;  /**< Returned length of the output, -1: Truncated or Error */
+	int          status;     /**< Returned result of the command */
+} cli_batch_job_t;
+
+// ======================
+// Protoypes
+// ======================
+
+int  cli_batch_open(void);
+int  cli_batch_execute(cli_batch_job_t * jobs, uint16_t count);
+void cli_batch_close(void);
+
+#endif /* CLI_BATCH_H */
@@ -2,18 +2,93 @@
 #define CLI_CONFIG_H
 
 /* EXTERN USER FUNCTIONS */
+#include "cli_output.h"
 
-/* CLI */
-#define CLI_MAX_CHILDS      4  /**< Maximum number of childs for a token */
-#define CLI_MAX_TEXT_LEN    10 /**< Maximum length of the token's text attribute */
-#define CLI_MAX_DESC_LEN    32 /**< Maximum length og the token's description attribute */
+/* CLI (Sizes of the tree can be given by the build, Ex: -DCLI_MAX_CHILDS=12) */
+#ifndef CLI_MAX_CHILDS
+#define CLI_MAX_CHILDS 4 /**< Maximum number of childs for a token */
+#endif
+#ifndef CLI_MAX_TEXT_LEN
+#define CLI_MAX_TEXT_LEN 10 /**< Maximum length of the token's text attribute */
+#endif
+#ifndef CLI_MAX_DESC_LEN
+#define CLI_MAX_DESC_LEN 32 /**< Maximum length og the token's description attribute */
+#endif
+#ifndef CLI_MAX_TOKEN_COUNT
 #define CLI_MAX_TOKEN_COUNT 10 /**< Maximum number of tokens */
-#define CLI_CMD_MAX_TOKEN   5  /**< Maximum number of cmdText in a line (including tokens and arguments) */
+#endif
+#ifndef CLI_MAX_SYMBOLS
+#define CLI_MAX_SYMBOLS 16 /**< Maximum number of distinct callbacks, providers and options given to the tree */
+#endif
+#define CLI_CMD_MAX_TOKEN 5 /**< Maximum number of cmdText in a line (including tokens and arguments) */
+#define CLI_MAX_OPTIONS   8 /**< Maximum number of options of a leaf (32 at most) */
 
-#define CLI_PRINTF(...) printf(__VA_ARGS__); /**< Standard output */
+#define CLI_DESC_COMPRESSED 0 /**< 1: Descriptions are compressed by tools/cli_desc_gen.c into flash, CLI_MAX_DESC_LEN is not used */
+
+#define CLI_PRINTF(...)          cli_output_printf(__VA_ARGS__); /**< Standard output */
+#define CLI_OUTPUT_BUFFER_LENGTH 256                             /**< Maximum length of a formatted output when an output callback is used */
+
+#define CLI_MACHINE_OUTPUT_LENGTH 1024 /**< Maximum output of a command answered in machine or binary mode (truncated beyond) */
+
+#ifndef CLI_ID_TABLE_SIZE
+#define CLI_ID_TABLE_SIZE 64 /**< Size of the command ID table, power of 2 greater than CLI_MAX_TOKEN_COUNT */
+#endif
+#define CLI_BIN_FRAME_LENGTH 64 /**< Maximum size of a binary request after its length field */
+
+#define CLI_STREAM_CHUNK_LENGTH 128 /**< Maximum number of bytes produced at once by a streamed command */
+#define CLI_UPLOAD_CHUNK_LENGTH 64  /**< Maximum number of uploaded bytes given at once to the consumer (See cli_upload_start()) */
+
+#define CLI_CACHE_ENTRIES       8   /**< Number of outputs kept for the cached leaves (See cli_set_cache()), 0 to disable */
+#define CLI_CACHE_OUTPUT_LENGTH 256 /**< Maximum output kept, longer ones are not cached */
+
+#ifndef CLI_STACK_PROBE_LENGTH
+#define CLI_STACK_PROBE_LENGTH 0 /**< Bytes of stack painted to measure the stack used by commands (Ex: 1024, GCC or Clang only), 0 to disable */
+#endif
+
+#define CLI_TRACE_LENGTH  256               /**< Number of events kept by the trace, power of 2, 0 to disable */
+#define CLI_TRACE_CLOCK() cli_trace_clock() /**< Time of an event, can be a cycle counter (Ex: DWT->CYCCNT) */
+
+#ifndef CLI_CONCURRENT_READERS
+#define CLI_CONCURRENT_READERS 0 /**< 1: Commands can be looked up while another thread changes the tree (C11 atomics, See cli_read_lock()) */
+#endif
+
+/* WATCH */
+#define CLI_WATCH_MAX_JOBS    16 /**< Maximum number of commands run periodically */
+#define CLI_WATCH_WHEEL_SLOTS 64 /**< Number of slots of the timer wheel, power of 2 */
+#define CLI_WATCH_TICK_MS     10 /**< Resolution of the timer wheel */
 
 /* LINE BUFFER */
 #define LB_LINE_BUFFER_LENGTH 32 /**< Maximum number of character into the line buffer */
 #define LB_HISTORY_COUNT      10 /**< Maximum number of line in history */
+#define LB_PROMPT_LENGTH      24 /**< Maximum length of the prompt (See lb_set_prompt()) */
+
+/* BATCH (Linux only, opt-in as it needs C11 thread local storage, Ex: -DCLI_BATCH=1) */
+#ifndef CLI_BATCH
+#define CLI_BATCH 0 /**< 1: cli_batch.c is built, the output and the options are thread local */
+#endif
+#define CLI_BATCH_WORKERS    4  /**< Number of threads calling the thread safe commands of cli_batch_execute(), 0: Called by the caller */
+#define CLI_BATCH_RUN_LENGTH 32 /**< Maximum number of thread safe commands given to the workers at once */
+
+#if ((CLI_BATCH == 1) && (CLI_BATCH_WORKERS > 0)) || (CLI_CONCURRENT_READERS == 1)
+#define CLI_THREAD_LOCAL _Thread_local /**< State of the command being called, one per worker or per reader thread */
+#else
+#define CLI_THREAD_LOCAL
+#endif
+
+/* SERVER (Linux only) */
+#define CLI_SERVER_MAX_SESSIONS  256  /**< Maximum number of simultaneous connections */
+#define CLI_SERVER_OUTPUT_LENGTH 4096 /**< Size of the output buffer of each connection */
+#define CLI_SERVER_RX_LENGTH     512  /**< Maximum number of bytes read at once from a connection */
+
+/* TTY (POSIX only) */
+#define CLI_TTY_RX_LENGTH 256 /**< Maximum number of bytes read at once from the terminal */
+
+/* DEBUG LOG (-DDEBUG) */
+#define CLI_LOG_LENGTH      64 /**< Number of DPRINTF() kept until formatted by cli_log_flush(), 0: Printed at once */
+#define CLI_LOG_MAX_ARGS    6  /**< Maximum number of arguments of a DPRINTF() */
+#define CLI_LOG_STRING_SIZE 32 /**< Bytes of the string arguments of a DPRINTF() copied when it is recorded */
+
+/* HISTORY FILE (POSIX only) */
+#define LB_HISTORY_FILE_COMPACT_LINES 256 /**< Number of lines appended to the history file before it is compacted */
 
 #endif /* CLI_CONFIG_H */
\ No newline at end of file
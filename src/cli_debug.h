@@ -22,6 +22,60 @@ int debugLineBuffer = 0;
 #define DEBUG_INFO     0x0001
 #define DEBUG_ERROR    0x0002
 
+#elif defined(LB_HISTORY_FILE_C)
+// Variable declaration
+int debugHistoryFile = 0;
+#define DEBUG_VAR_NAME debugHistoryFile
+
+// Flag declaration
+#define DEBUG_INFO  0x0001
+#define DEBUG_ERROR 0x0002
+
+#elif defined(CLI_SERVER_C)
+// Variable declaration
+int debugServer = 0;
+#define DEBUG_VAR_NAME debugServer
+
+// Flag declaration
+#define DEBUG_INFO  0x0001
+#define DEBUG_ERROR 0x0002
+
+#elif defined(CLI_WATCH_C)
+// Variable declaration
+int debugWatch = 0;
+#define DEBUG_VAR_NAME debugWatch
+
+// Flag declaration
+#define DEBUG_INFO  0x0001
+#define DEBUG_ERROR 0x0002
+
+#elif defined(CLI_TTY_C)
+// Variable declaration
+int debugTty = 0;
+#define DEBUG_VAR_NAME debugTty
+
+// Flag declaration
+#define DEBUG_INFO  0x0001
+#define DEBUG_ERROR 0x0002
+
+#elif defined(CLI_BATCH_C)
+// Variable declaration
+int debugBatch = 0;
+#define DEBUG_VAR_NAME debugBatch
+
+// Flag declaration
+#define DEBUG_INFO  0x0001
+#define DEBUG_ERROR 0x0002
+
+#elif defined(CLI_SNAPSHOT_C)
+// Variable declaration
+int debugSnapshot = 0;
+#define DEBUG_VAR_NAME debugSnapshot
+
+// Flag declaration
+#define DEBUG_INFO  0x0001
+#define DEBUG_ERROR 0x0002
+
 #else
 #error "No context found for debug.h"
 #endif
@@ -29,15 +83,26 @@ int debugLineBuffer = 0;
 // Common to all contexts
 #ifdef DEBUG
 
+#include "cli_log.h"
+
 #define DEBUG_OUTPUT        printf                             /**< Define where output text goes */
 #define DEBUG_ENABLE(flag)  DEBUG_VAR_NAME |= DEBUG_##flag     /**< Enable a flag */
 #define DEBUG_DISABLE(flag) DEBUG_VAR_NAME &= ~DEBUG_##flag    /**< Disable a flag */
 #define DEBUG_BLOC(flag)    if (DEBUG_VAR_NAME & DEBUG_##flag) /**< Test if flag is enabled */
+
+#if (CLI_LOG_IS_DEFERRED == 1)
+#define DPRINTF(flag, ...)                                     /**< Record string if flag is enabled, cli_log_flush() prints it */ \
+	DEBUG_BLOC(flag)                                                                                                      \
+	{                                                                                                                     \
+		cli_log("[" #flag "] " __VA_ARGS__);                                                                              \
+	}
+#else
 #define DPRINTF(flag, ...)                                     /**< Print string if flag is enabled */ \
 	DEBUG_BLOC(flag)                                                                                   \
 	{                                                                                                  \
 		DEBUG_OUTPUT("[" #flag "] " __VA_ARGS__);                                                      \
 	}
+#endif
 
 #else
 
@@ -0,0 +1,431 @@
+#include "cli_log.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+
+#if (CLI_LOG_IS_DEFERRED == 1)
+
+// Kind of the argument of a conversion
+#define CLI_LOG_ARG_NONE     0 /**< No argument ("%%" or unknown conversion) */
+#define CLI_LOG_ARG_SIGNED   1 /**< d i c */
+#define CLI_LOG_ARG_UNSIGNED 2 /**< u x X o */
+#define CLI_LOG_ARG_POINTER  3 /**< p */
+#define CLI_LOG_ARG_STRING   4 /**< s */
+#define CLI_LOG_ARG_DOUBLE   5 /**< f F e E g G a A */
+
+#define CLI_LOG_SPEC_LENGTH 24 /**< Maximum length of a rebuilt conversion (Ex: "%-*.*llX" with the '*' replaced) */
+
+/**
+ * A conversion of a format
+ */
+typedef struct {
+	const char * start;     /**< Its '%' */
+	const char * end;       /**< Character after it */
+	uint8_t      starCount; /**< Number of '*' (Width, precision), each one takes an int argument */
+	uint8_t      kind;      /**< CLI_LOG_ARG_* */
+	char         length;    /**< Length modifier: 'H' (hh), 'h', 'l', 'L' (ll), 'z', 'j', 't' or 0 */
+} cli_log_spec_t;
+
+/**
+ * A DPRINTF() waiting to be formatted
+ */
+typedef struct {
+	const char * format;                        /**< String literal, still valid when formatted */
+	uint8_t      argCount;                      /**< Number of args recorded */
+	uint64_t     args[CLI_LOG_MAX_ARGS];        /**< Integers, pointers, doubles (bits) or offsets in strings */
+	char         strings[CLI_LOG_STRING_SIZE];  /**< Copies of the string arguments, they may be gone when formatted */
+} cli_log_record_t;
+
+// Global variables
+cli_log_record_t cliLog[CLI_LOG_LENGTH]; /**< Ring of the records */
+uint32_t         cliLogHead;             /**< Number of records written, the next one goes to cliLog[cliLogHead % CLI_LOG_LENGTH] */
+uint32_t         cliLogTail;             /**< Number of records formatted */
+uint32_t         cliLogLost;             /**< Records overwritten before being formatted, since the last flush */
+
+// ===================
+//      STATIC
+// ===================
+
+/**
+ * @brief Parse a conversion
+ *
+ * @param format Its '%'
+ * @param spec Filled
+ */
+static void cli_log_parse_spec(const char * format, cli_log_spec_t * spec)
+{
+	const char * c = format + 1;
+
+	spec->start     = format;
+	spec->starCount = 0;
+	spec->kind      = CLI_LOG_ARG_NONE;
+	spec->length    = 0;
+
+	// Flags, width and precision
+	while ((*c != '\0') && (strchr("-+ #0", *c) != NULL)) {
+		++c;
+	}
+	while ((*c == '*') || (*c == '.') || ((*c >= '0') && (*c <= '9'))) {
+		if (*c == '*') {
+			++spec->starCount;
+		}
+		++c;
+	}
+
+	// Length
+	if ((*c == 'h') || (*c == 'l')) {
+		spec->length = *c++;
+		if (*c == spec->length) {
+			spec->length = (spec->length == 'h') ? 'H' : 'L';
+			++c;
+		}
+	} else if ((*c == 'z') || (*c == 'j') || (*c == 't')) {
+		spec->length = *c++;
+	}
+
+	switch (*c) {
+	case 'd':
+	case 'i':
+	case 'c':
+		spec->kind = CLI_LOG_ARG_SIGNED;
+		break;
+	case 'u':
+	case 'x':
+	case 'X':
+	case 'o':
+		spec->kind = CLI_LOG_ARG_UNSIGNED;
+		break;
+	case 'p':
+		spec->kind = CLI_LOG_ARG_POINTER;
+		break;
+	case 's':
+		spec->kind = CLI_LOG_ARG_STRING;
+		break;
+	case 'f':
+	case 'F':
+	case 'e':
+	case 'E':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		spec->kind = CLI_LOG_ARG_DOUBLE;
+		break;
+	default:
+		break;
+	}
+	spec->end = (*c == '\0') ? c : c + 1;
+}
+
+/**
+ * @brief Take an integer argument, as promoted by its length
+ *
+ * @param args Arguments of cli_log()
+ * @param spec Conversion
+ * @return Value, sign extended if signed
+ */
+static uint64_t cli_log_fetch_integer(va_list * args, const cli_log_spec_t * spec)
+{
+	if (spec->kind == CLI_LOG_ARG_SIGNED) {
+		switch (spec->length) {
+		case 'H': return (int64_t) (signed char) va_arg(*args, int);
+		case 'h': return (int64_t) (short) va_arg(*args, int);
+		case 'l': return (int64_t) va_arg(*args, long);
+		case 'L': return (int64_t) va_arg(*args, long long);
+		case 'z': return (int64_t) va_arg(*args, size_t);
+		case 'j': return (int64_t) va_arg(*args, intmax_t);
+		case 't': return (int64_t) va_arg(*args, ptrdiff_t);
+		default: return (int64_t) va_arg(*args, int);
+		}
+	}
+	switch (spec->length) {
+	case 'H': return (unsigned char) va_arg(*args, unsigned);
+	case 'h': return (unsigned short) va_arg(*args, unsigned);
+	case 'l': return va_arg(*args, unsigned long);
+	case 'L': return va_arg(*args, unsigned long long);
+	case 'z': return va_arg(*args, size_t);
+	case 'j': return va_arg(*args, uintmax_t);
+	case 't': return va_arg(*args, ptrdiff_t);
+	default: return va_arg(*args, unsigned);
+	}
+}
+
+/**
+ * @brief Rebuild a conversion for snprintf()
+ * @details '*' are replaced by their recorded value and the length of
+ * integers becomes "ll" as they are recorded on 64 bits
+ *
+ * @param spec Conversion
+ * @param args Recorded values of the '*'
+ * @param text Filled, CLI_LOG_SPEC_LENGTH bytes
+ */
+static void cli_log_rebuild_spec(const cli_log_spec_t * spec, const uint64_t * args, char * text)
+{
+	const char * last = spec->end - 1; // Conversion character
+	uint8_t      pos  = 0;
+
+	for (const char * c = spec->start; (c < last) && (pos < CLI_LOG_SPEC_LENGTH - 4); ++c) {
+		if (*c == '*') {
+			pos += snprintf(&text[pos], CLI_LOG_SPEC_LENGTH - 3 - pos, "%d", (int) (int64_t) *args++);
+		} else if (strchr("hlzjt", *c) == NULL) {
+			text[pos++] = *c;
+		}
+	}
+	if (pos > CLI_LOG_SPEC_LENGTH - 4) {
+		pos = CLI_LOG_SPEC_LENGTH - 4;
+	}
+	if (((spec->kind == CLI_LOG_ARG_SIGNED) && (*last != 'c')) || (spec->kind == CLI_LOG_ARG_UNSIGNED)) {
+		text[pos++] = 'l';
+		text[pos++] = 'l';
+	}
+	text[pos++] = *last;
+	text[pos]   = '\0';
+}
+
+/**
+ * @brief Format a record
+ * @details Conversions which could not be recorded are copied as they are
+ *
+ * @param record Pointer
+ * @param line Filled
+ * @param size Size of line
+ */
+static void cli_log_format(const cli_log_record_t * record, char * line, uint16_t size)
+{
+	char           specText[CLI_LOG_SPEC_LENGTH];
+	cli_log_spec_t spec;
+	uint16_t       pos      = 0;
+	uint8_t        argIndex = 0;
+	const char *   c        = record->format;
+
+	while ((*c != '\0') && (pos < size - 1)) {
+		int written;
+
+		if (*c != '%') {
+			line[pos++] = *c++;
+			continue;
+		}
+		cli_log_parse_spec(c, &spec);
+		c = spec.end;
+
+		if ((spec.kind == CLI_LOG_ARG_NONE) || (argIndex + spec.starCount + 1 > record->argCount)) {
+			// "%%", unknown conversion or argument not recorded
+			if (spec.start[1] == '%') {
+				line[pos++] = '%';
+			} else {
+				written = snprintf(&line[pos], size - pos, "%.*s", (int) (spec.end - spec.start), spec.start);
+				pos += (written < size - pos) ? written : size - 1 - pos;
+			}
+			continue;
+		}
+
+		cli_log_rebuild_spec(&spec, &record->args[argIndex], specText);
+		argIndex += spec.starCount;
+		switch (spec.kind) {
+		case CLI_LOG_ARG_SIGNED:
+			if (spec.end[-1] == 'c') {
+				written = snprintf(&line[pos], size - pos, specText, (int) record->args[argIndex]);
+			} else {
+				written = snprintf(&line[pos], size - pos, specText, (long long) record->args[argIndex]);
+			}
+			break;
+		case CLI_LOG_ARG_UNSIGNED:
+			written = snprintf(&line[pos], size - pos, specText, (unsigned long long) record->args[argIndex]);
+			break;
+		case CLI_LOG_ARG_POINTER:
+			written = snprintf(&line[pos], size - pos, specText, (void *) (uintptr_t) record->args[argIndex]);
+			break;
+		case CLI_LOG_ARG_STRING:
+			written = snprintf(&line[pos], size - pos, specText, &record->strings[record->args[argIndex]]);
+			break;
+		default: {
+			double value;
+
+			memcpy(&value, &record->args[argIndex], sizeof(value));
+			written = snprintf(&line[pos], size - pos, specText, value);
+			break;
+		}
+		}
+		++argIndex;
+		if (written > 0) {
+			pos += (written < size - pos) ? written : size - 1 - pos;
+		}
+	}
+	line[pos] = '\0';
+}
+
+/**
+ * @brief Format the pending records, oldest first
+ *
+ * @param isToCli true: Written with CLI_PRINTF(), false: Written on stdout
+ */
+static void cli_log_drain(bool isToCli)
+{
+	char line[CLI_OUTPUT_BUFFER_LENGTH];
+
+	if (cliLogLost > 0) {
+		snprintf(line, sizeof(line), "[LOG] %lu messages lost\n\r", (unsigned long) cliLogLost);
+		cliLogLost = 0;
+		if (isToCli) {
+			CLI_PRINTF("%s", line);
+		} else {
+			printf("%s", line);
+		}
+	}
+
+	while (cliLogTail != cliLogHead) {
+		// Copied as a DPRINTF() of the output may overwrite it
+		cli_log_record_t record = cliLog[cliLogTail % CLI_LOG_LENGTH];
+
+		++cliLogTail;
+		cli_log_format(&record, line, sizeof(line));
+		if (isToCli) {
+			CLI_PRINTF("%s", line);
+		} else {
+			printf("%s", line);
+		}
+	}
+}
+
+#endif /* CLI_LOG_IS_DEFERRED */
+
+/**
+ * @brief Callback of "log"
+ *
+ * @param argc Argument count
+ * @param argv Unused
+ * @return 0: ok
+ */
+static int cli_log_cb_log(uint8_t argc, char * argv[])
+{
+	(void) argc;
+	(void) argv;
+#if (CLI_LOG_IS_DEFERRED == 1)
+	cli_log_drain(true);
+#else
+	CLI_PRINTF("Log is not deferred (DEBUG undefined or CLI_LOG_LENGTH = 0)\n\r");
+#endif
+	return 0;
+}
+
+// ===================
+//       EXTERN
+// ===================
+
+/**
+ * @brief Record a message, DPRINTF() calls it when CLI_LOG_IS_DEFERRED is 1
+ * @details Only the arguments are copied, format must be a string literal.
+ * The oldest record is overwritten when the ring is full.
+ * Not thread safe: DPRINTF() flags must stay disabled in the threads of the
+ * batch executor and of the server
+ *
+ * @param format printf() format (Up to CLI_LOG_MAX_ARGS arguments, '*' included)
+ */
+void cli_log(const char * format, ...)
+{
+	va_list args;
+
+	va_start(args, format);
+#if (CLI_LOG_IS_DEFERRED == 1)
+	cli_log_record_t * record     = &cliLog[cliLogHead % CLI_LOG_LENGTH];
+	uint8_t            stringUsed = 0;
+	cli_log_spec_t     spec;
+
+	if (cliLogHead - cliLogTail == CLI_LOG_LENGTH) {
+		++cliLogTail;
+		++cliLogLost;
+	}
+	++cliLogHead;
+
+	record->format   = format;
+	record->argCount = 0;
+	for (const char * c = format; *c != '\0';) {
+		if (*c != '%') {
+			++c;
+			continue;
+		}
+		cli_log_parse_spec(c, &spec);
+		c = spec.end;
+		if (spec.kind == CLI_LOG_ARG_NONE) {
+			continue;
+		}
+		if (record->argCount + spec.starCount + 1 > CLI_LOG_MAX_ARGS) {
+			break; // The following conversions are printed as they are
+		}
+
+		for (uint8_t i = 0; i < spec.starCount; ++i) {
+			record->args[record->argCount++] = (int64_t) va_arg(args, int);
+		}
+		switch (spec.kind) {
+		case CLI_LOG_ARG_POINTER:
+			record->args[record->argCount++] = (uintptr_t) va_arg(args, void *);
+			break;
+		case CLI_LOG_ARG_STRING: {
+			const char * string = va_arg(args, const char *);
+			size_t       length;
+
+			if (string == NULL) {
+				string = "(null)";
+			}
+			if (stringUsed == CLI_LOG_STRING_SIZE) {
+				// No room, points on the terminator of the previous string
+				record->args[record->argCount++] = CLI_LOG_STRING_SIZE - 1;
+				break;
+			}
+			length = strlen(string);
+			if (length > (size_t) (CLI_LOG_STRING_SIZE - 1 - stringUsed)) {
+				length = CLI_LOG_STRING_SIZE - 1 - stringUsed;
+			}
+			memcpy(&record->strings[stringUsed], string, length);
+			record->strings[stringUsed + length] = '\0';
+			record->args[record->argCount++]    = stringUsed;
+			stringUsed += length + 1;
+			break;
+		}
+		case CLI_LOG_ARG_DOUBLE: {
+			double value = va_arg(args, double);
+
+			memcpy(&record->args[record->argCount++], &value, sizeof(value));
+			break;
+		}
+		default:
+			record->args[record->argCount++] = cli_log_fetch_integer(&args, &spec);
+			break;
+		}
+	}
+#else
+	vprintf(format, args);
+#endif
+	va_end(args);
+}
+
+/**
+ * @brief Format the pending records on stdout
+ * @details Called by cli_tick(), may be called from any other idle point
+ */
+void cli_log_flush(void)
+{
+#if (CLI_LOG_IS_DEFERRED == 1)
+	if ((cliLogTail != cliLogHead) || (cliLogLost > 0)) {
+		cli_log_drain(false);
+	}
+#endif
+}
+
+/**
+ * @brief Add the "log" command
+ * @details It prints the pending records in the session instead of stdout
+ *
+ * @param parent Token receiving the command (Ex: root)
+ * @return 0: ok, -1: Error
+ */
+int cli_log_register(cli_token * parent)
+{
+	cli_token * curTok = cli_add_token("log", CLI_DESC(log, "Print pending debug messages"));
+
+	if (curTok == NULL) {
+		return -1;
+	}
+	cli_set_callback(curTok, &cli_log_cb_log);
+	return cli_add_children(parent, curTok);
+}
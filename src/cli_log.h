@@ -0,0 +1,28 @@
+#ifndef CLI_LOG_H
+#define CLI_LOG_H
+
+// ======================
+// Includes
+// ======================
+
+#include "cli.h"
+
+// ======================
+// Constants
+// ======================
+
+#if defined(DEBUG) && (CLI_LOG_LENGTH > 0)
+#define CLI_LOG_IS_DEFERRED 1 /**< DPRINTF() records its arguments, they are formatted later */
+#else
+#define CLI_LOG_IS_DEFERRED 0
+#endif
+
+// ======================
+// Protoypes
+// ======================
+
+void cli_log(const char * format, ...);
+void cli_log_flush(void);
+int  cli_log_register(cli_token * parent);
+
+#endif /* CLI_LOG_H */
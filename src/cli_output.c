@@ -0,0 +1,101 @@
+#include "cli_output.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "cli_config.h"
+
+// Global variables
+CLI_THREAD_LOCAL cli_output_callback_t      outputCallback     = NULL; /**< Where the output goes, NULL for stdout */
+CLI_THREAD_LOCAL cli_output_room_callback_t outputRoomCallback = NULL; /**< Room left in the output, NULL if unknown */
+
+// ===================
+//       EXTERN
+// ===================
+
+/**
+ * @brief Define where the output of CLI_PRINTF() goes
+ *
+ * @param callback Pointer on function, NULL to use stdout
+ */
+void cli_output_set_callback(cli_output_callback_t callback)
+{
+	outputCallback = callback;
+}
+
+/**
+ * @brief Give the function receiving the output
+ * @return Pointer on function, NULL for stdout
+ */
+cli_output_callback_t cli_output_get_callback(void)
+{
+	return outputCallback;
+}
+
+/**
+ * @brief Define how the room left in the output is known
+ *
+ * @param callback Pointer on function, NULL if the output never blocks (stdout)
+ */
+void cli_output_set_room_callback(cli_output_room_callback_t callback)
+{
+	outputRoomCallback = callback;
+}
+
+/**
+ * @brief Give the number of bytes the output accepts without blocking
+ * @return Number of bytes, UINT16_MAX if unknown
+ */
+uint16_t cli_output_get_room(void)
+{
+	if (outputRoomCallback == NULL) {
+		return UINT16_MAX;
+	}
+	return outputRoomCallback();
+}
+
+/**
+ * @brief Write raw bytes to the output
+ *
+ * @param str Bytes to write
+ * @param len Number of bytes
+ * @return Return of the output callback, -1: Error
+ */
+int cli_output_write(const char * str, uint16_t len)
+{
+	if (outputCallback == NULL) {
+		return (fwrite(str, 1, len, stdout) == len) ? len : -1;
+	}
+	return outputCallback(str, len);
+}
+
+/**
+ * @brief Format a string and write it to the output
+ * @note Strings longer than CLI_OUTPUT_BUFFER_LENGTH - 1 are truncated
+ * when an output callback is used
+ *
+ * @param format printf() like format
+ * @return Return of the output callback, -1: Error
+ */
+int cli_output_printf(const char * format, ...)
+{
+	char    buffer[CLI_OUTPUT_BUFFER_LENGTH];
+	va_list args;
+	int     len;
+
+	va_start(args, format);
+	if (outputCallback == NULL) {
+		len = vprintf(format, args);
+		va_end(args);
+		return len;
+	}
+	len = vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+
+	if (len < 0) {
+		return -1;
+	} else if (len >= (int) sizeof(buffer)) {
+		len = sizeof(buffer) - 1;
+	}
+	return outputCallback(buffer, len);
+}
@@ -0,0 +1,28 @@
+#ifndef CLI_OUTPUT_H
+#define CLI_OUTPUT_H
+
+// ======================
+// Includes
+// ======================
+
+#include <stdint.h>
+
+// ======================
+// Typedefs and structs
+// ======================
+
+typedef int (*cli_output_callback_t)(const char * str, uint16_t len); /**< Prototype of the function receiving the output */
+typedef uint16_t (*cli_output_room_callback_t)(void);                 /**< Prototype of the function giving the number of bytes the output accepts without blocking */
+
+// ======================
+// Protoypes
+// ======================
+
+void                  cli_output_set_callback(cli_output_callback_t callback);
+cli_output_callback_t cli_output_get_callback(void);
+void                  cli_output_set_room_callback(cli_output_room_callback_t callback);
+uint16_t              cli_output_get_room(void);
+int                   cli_output_write(const char * str, uint16_t len);
+int                   cli_output_printf(const char * format, ...);
+
+#endif /* CLI_OUTPUT_H */
@@ -0,0 +1,689 @@
+#define _GNU_SOURCE // accept4()
+#include "cli_server.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cli_watch.h"
+
+#define CLI_SERVER_C
+#include "cli_debug.h"
+
+// Telnet commands and options (RFC 854, 857, 858)
+#define TELNET_SE       240
+#define TELNET_SB       250
+#define TELNET_WILL     251
+#define TELNET_WONT     252
+#define TELNET_DO       253
+#define TELNET_DONT     254
+#define TELNET_IAC      255
+#define TELNET_OPT_ECHO 1
+#define TELNET_OPT_SGA  3
+
+// Telnet input parser states
+#define CLI_SERVER_TN_DATA   0 /**< Normal bytes */
+#define CLI_SERVER_TN_CR     1 /**< CR received, a following '\n' or '\0' is dropped */
+#define CLI_SERVER_TN_IAC    2 /**< IAC received */
+#define CLI_SERVER_TN_OPTION 3 /**< Negotiation received, waiting for the option */
+#define CLI_SERVER_TN_SB     4 /**< Inside a sub-negotiation */
+#define CLI_SERVER_TN_SB_IAC 5 /**< IAC received inside a sub-negotiation */
+
+#define CLI_SERVER_EVENT_COUNT     64         /**< Maximum number of events handled by one cli_server_poll() */
+#define CLI_SERVER_LISTEN_ID       UINT32_MAX /**< epoll data of the listening socket */
+#define CLI_SERVER_ACCEPT_RETRY_MS 100        /**< Time connections are left pending when no file descriptor is left */
+
+/**
+ * Negotiation sent to each new client: the server echoes and
+ * the client sends characters as they are typed
+ */
+static const uint8_t telnetCharMode[] = {
+	TELNET_IAC, TELNET_WILL, TELNET_OPT_ECHO,
+	TELNET_IAC, TELNET_WILL, TELNET_OPT_SGA,
+	TELNET_IAC, TELNET_DO, TELNET_OPT_SGA
+};
+
+typedef struct {
+	cli_session session;                             /**< CLI state of this connection */
+	int         fd;                                  /**< Socket, -1 if slot is free */
+	uint8_t     telnetState;                         /**< State of the telnet input parser CLI_SERVER_TN_* */
+	uint8_t     isWaitingOut : 1;                    /**< Tell if EPOLLOUT is requested */
+	uint16_t    outHead;                             /**< Index of the first byte to send in outBuffer */
+	uint16_t    outLen;                              /**< Number of bytes to send in outBuffer */
+	uint32_t    droppedBytes;                        /**< Number of output bytes lost because outBuffer was full */
+	char        outBuffer[CLI_SERVER_OUTPUT_LENGTH]; /**< Ring buffer of pending output */
+} cli_server_client_t;
+
+// Global variables
+typedef struct {
+	int                   listenFd;                         /**< Listening socket, -1 if closed */
+	int                   epollFd;                          /**< epoll instance watching all sockets */
+	uint16_t              port;                             /**< Port actually used */
+	uint16_t              clientCount;                      /**< Number of connected clients */
+	uint8_t               isAcceptPaused : 1;               /**< Tell if the listening socket is not watched (No file descriptor left) */
+	struct timespec       acceptPauseTime;                  /**< When accepting was paused */
+	cli_server_client_t * curClient;                        /**< Client whose output is being produced */
+	cli_server_client_t   clients[CLI_SERVER_MAX_SESSIONS]; /**< All client slots */
+} cli_server_t;
+cli_server_t cliServer = { .listenFd = -1, .epollFd = -1 };
+
+// ===================
+//      STATIC
+// ===================
+
+/**
+ * @brief Update the events watched for a client
+ *
+ * @param client Pointer
+ * @param wantOut Tell if we must be woken up when the socket has room
+ */
+static void cli_server_watch_out(cli_server_client_t * client, bool wantOut)
+{
+	struct epoll_event event;
+
+	if (client->isWaitingOut == wantOut) {
+		return;
+	}
+
+	event.events   = EPOLLIN | (wantOut ? EPOLLOUT : 0);
+	event.data.u32 = client - cliServer.clients;
+	epoll_ctl(cliServer.epollFd, EPOLL_CTL_MOD, client->fd, &event);
+	client->isWaitingOut = wantOut;
+}
+
+/**
+ * @brief Give the client whose output is being produced
+ * @details Outside of the server (Ex: a watch job run by cli_tick()), this
+ * is the client of the selected session
+ *
+ * @return Pointer, NULL if the selected session is not a client
+ */
+static cli_server_client_t * cli_server_get_cur_client(void)
+{
+	cli_session * session = cli_session_get();
+
+	if (cliServer.curClient != NULL) {
+		return cliServer.curClient;
+	}
+
+	for (uint16_t i = 0; i < CLI_SERVER_MAX_SESSIONS; ++i) {
+		if ((&cliServer.clients[i].session == session) && (cliServer.clients[i].fd >= 0)) {
+			return &cliServer.clients[i];
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Tell if the bytes of a client are not text
+ * @details In binary mode and during a raw upload, CR is not translated
+ * and 0xFF (IAC) is doubled both ways
+ *
+ * @param client Pointer
+ * @return boolean
+ */
+static bool cli_server_is_binary(cli_server_client_t * client)
+{
+	return (client->session.mode == CLI_MODE_BINARY) || ((client->session.upload != NULL) && (client->session.uploadEncoding == CLI_UPLOAD_RAW));
+}
+
+/**
+ * @brief Append bytes to the output ring of a client as they are
+ * @details Bytes that do not fit are dropped
+ *
+ * @param client Pointer
+ * @param str Bytes to send
+ * @param len Number of bytes
+ * @return Number of bytes queued
+ */
+static uint16_t cli_server_queue(cli_server_client_t * client, const char * str, uint16_t len)
+{
+	uint16_t freeLen;
+	uint16_t tail;
+	uint16_t firstLen;
+
+	freeLen = CLI_SERVER_OUTPUT_LENGTH - client->outLen;
+	if (len > freeLen) {
+		client->droppedBytes += len - freeLen;
+		len = freeLen;
+	}
+
+	// Copy in 2 parts if we reach the end of the ring
+	tail     = (client->outHead + client->outLen) % CLI_SERVER_OUTPUT_LENGTH;
+	firstLen = CLI_SERVER_OUTPUT_LENGTH - tail;
+	if (firstLen > len) {
+		firstLen = len;
+	}
+	memcpy(client->outBuffer + tail, str, firstLen);
+	memcpy(client->outBuffer, str + firstLen, len - firstLen);
+	client->outLen += len;
+	return len;
+}
+
+/**
+ * @brief Output callback of all sessions
+ * @details Append bytes to the output ring of the current client, never blocks.
+ * Bytes that do not fit are dropped. 0xFF is doubled in binary mode, as
+ * cli_server_telnet_rx() expects from the client.
+ * @see cli_output_callback_t
+ *
+ * @param str Bytes to send
+ * @param len Number of bytes
+ * @return Number of bytes queued
+ */
+static int cli_server_output(const char * str, uint16_t len)
+{
+	cli_server_client_t * client = cli_server_get_cur_client();
+	uint16_t              pos    = 0;
+
+	if (client == NULL) {
+		return -1;
+	}
+
+	if (cli_server_is_binary(client) == false) {
+		pos = cli_server_queue(client, str, len);
+	} else {
+		while (pos < len) {
+			const char * iac      = memchr(str + pos, TELNET_IAC, len - pos);
+			uint16_t     chunkLen = (iac != NULL) ? (iac - str) - pos + 1 : len - pos;
+
+			if ((cli_server_queue(client, str + pos, chunkLen) != chunkLen) ||
+				((iac != NULL) && (cli_server_queue(client, iac, 1) != 1))) {
+				break;
+			}
+			pos += chunkLen;
+		}
+	}
+
+	// Nobody will flush it after, wait for the socket
+	if (client != cliServer.curClient) {
+		cli_server_watch_out(client, true);
+	}
+	return pos;
+}
+
+/**
+ * @brief Room callback of all sessions
+ * @see cli_output_room_callback_t
+ *
+ * @return Number of bytes the output ring of the current client accepts,
+ * half of the free ones in binary mode where each may be doubled
+ */
+static uint16_t cli_server_output_room(void)
+{
+	cli_server_client_t * client = cli_server_get_cur_client();
+	uint16_t              freeLen;
+
+	if (client == NULL) {
+		return 0;
+	}
+	freeLen = CLI_SERVER_OUTPUT_LENGTH - client->outLen;
+	return cli_server_is_binary(client) ? (freeLen / 2) : freeLen;
+}
+
+/**
+ * @brief Send as much pending output as the socket accepts
+ *
+ * @param client Pointer
+ * @return 0: ok, -1: Connection error
+ */
+static int cli_server_flush(cli_server_client_t * client)
+{
+	struct iovec iov[2];
+	int          iovCount;
+	ssize_t      sent;
+
+	while (client->outLen > 0) {
+		// Pending bytes may wrap around the end of the ring
+		iov[0].iov_base = client->outBuffer + client->outHead;
+		iov[0].iov_len  = CLI_SERVER_OUTPUT_LENGTH - client->outHead;
+		iovCount        = 1;
+		if (iov[0].iov_len >= client->outLen) {
+			iov[0].iov_len = client->outLen;
+		} else {
+			iov[1].iov_base = client->outBuffer;
+			iov[1].iov_len  = client->outLen - iov[0].iov_len;
+			iovCount        = 2;
+		}
+
+		sent = writev(client->fd, iov, iovCount);
+		if (sent < 0) {
+			if (errno == EINTR) {
+				continue;
+			} else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+				break;
+			}
+			return -1;
+		}
+		client->outHead = (client->outHead + sent) % CLI_SERVER_OUTPUT_LENGTH;
+		client->outLen -= sent;
+	}
+
+	// A streamed output is produced as the socket accepts bytes
+	cli_server_watch_out(client, (client->outLen > 0) || (client->session.stream != NULL));
+	return 0;
+}
+
+/**
+ * @brief Produce the streamed output of a client until its output ring is full
+ *
+ * @param client Pointer
+ */
+static void cli_server_stream(cli_server_client_t * client)
+{
+	cli_session * prevSession = cli_session_get();
+
+	if (client->session.stream == NULL) {
+		return;
+	}
+
+	cliServer.curClient = client;
+	cli_session_select(&client->session);
+	while (cli_poll() > 0) {
+	}
+	cli_session_select(prevSession);
+	cliServer.curClient = NULL;
+}
+
+/**
+ * @brief Stop or restart watching the listening socket
+ * @details Pending connections can't be accepted when no file descriptor is
+ * left, the level triggered socket would wake up epoll_wait() at once
+ *
+ * @param isPaused true to stop watching
+ */
+static void cli_server_pause_accept(bool isPaused)
+{
+	struct epoll_event event;
+
+	if (cliServer.isAcceptPaused == isPaused) {
+		return;
+	}
+
+	event.events   = isPaused ? 0 : EPOLLIN;
+	event.data.u32 = CLI_SERVER_LISTEN_ID;
+	epoll_ctl(cliServer.epollFd, EPOLL_CTL_MOD, cliServer.listenFd, &event);
+	cliServer.isAcceptPaused = isPaused;
+	if (isPaused) {
+		clock_gettime(CLOCK_MONOTONIC, &cliServer.acceptPauseTime);
+	}
+}
+
+/**
+ * @brief Give the time left before accepting again
+ *
+ * @return Time in ms, 0 if accepting is not paused or may be tried again
+ */
+static int cli_server_get_accept_delay(void)
+{
+	struct timespec now;
+	long            elapsedMs;
+
+	if (cliServer.isAcceptPaused == false) {
+		return 0;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	elapsedMs = (now.tv_sec - cliServer.acceptPauseTime.tv_sec) * 1000 + (now.tv_nsec - cliServer.acceptPauseTime.tv_nsec) / 1000000;
+	return (elapsedMs < CLI_SERVER_ACCEPT_RETRY_MS) ? (CLI_SERVER_ACCEPT_RETRY_MS - elapsedMs) : 0;
+}
+
+/**
+ * @brief Disconnect a client and free its slot
+ *
+ * @param client Pointer
+ */
+static void cli_server_close_client(cli_server_client_t * client)
+{
+	DPRINTF(INFO, "Client %d disconnected (%u bytes dropped)\n\r", client->fd, client->droppedBytes);
+
+	cli_watch_remove_session(&client->session);
+	epoll_ctl(cliServer.epollFd, EPOLL_CTL_DEL, client->fd, NULL);
+	close(client->fd);
+	client->fd = -1;
+	--cliServer.clientCount;
+
+	// A file descriptor is free again
+	cli_server_pause_accept(false);
+}
+
+/**
+ * @brief Accept all pending connections
+ */
+static void cli_server_accept(void)
+{
+	cli_server_client_t * client;
+	struct epoll_event    event;
+	int                   fd;
+	int                   one = 1;
+
+	while (1) {
+		fd = accept4(cliServer.listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) {
+			if ((errno == EMFILE) || (errno == ENFILE)) {
+				DPRINTF(ERROR, "Unable to accept a connection, no file descriptor left\n\r");
+				cli_server_pause_accept(true);
+			}
+			return; // No more pending connection
+		}
+
+		// Find a free slot
+		client = NULL;
+		for (uint16_t i = 0; i < CLI_SERVER_MAX_SESSIONS; ++i) {
+			if (cliServer.clients[i].fd < 0) {
+				client = &cliServer.clients[i];
+				break;
+			}
+		}
+		if (client == NULL) {
+			DPRINTF(ERROR, "Connection refused, maximum reach (CLI_SERVER_MAX_SESSIONS = %d)\n\r", CLI_SERVER_MAX_SESSIONS);
+			close(fd);
+			continue;
+		}
+
+		// Small writes must leave right away
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		event.events   = EPOLLIN;
+		event.data.u32 = client - cliServer.clients;
+		if (epoll_ctl(cliServer.epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+			close(fd);
+			continue;
+		}
+
+		client->fd           = fd;
+		client->telnetState  = CLI_SERVER_TN_DATA;
+		client->isWaitingOut = false;
+		client->outHead      = 0;
+		client->outLen       = 0;
+		client->droppedBytes = 0;
+		++cliServer.clientCount;
+		DPRINTF(INFO, "Client %d connected\n\r", fd);
+
+		// Negotiate character mode, then display the prompt
+		cliServer.curClient = client;
+		cli_server_queue(client, (const char *) telnetCharMode, sizeof(telnetCharMode));
+		cli_session_init(&client->session, &cli_server_output);
+		cli_session_set_output_room(&client->session, &cli_server_output_room);
+		cliServer.curClient = NULL;
+
+		if (cli_server_flush(client) != 0) {
+			cli_server_close_client(client);
+		}
+	}
+}
+
+/**
+ * @brief Remove telnet commands from the input and give data to the CLI
+ * @details Negotiation answers from the client are ignored. CR LF and CR NUL
+ * are given as a single '\n', except in binary mode and during a raw upload
+ * (See cli_server_is_binary()).
+ *
+ * @param client Pointer
+ * @param byte Incomming byte
+ */
+static void cli_server_telnet_rx(cli_server_client_t * client, uint8_t byte)
+{
+	bool isBinary = cli_server_is_binary(client);
+
+	switch (client->telnetState) {
+	case CLI_SERVER_TN_CR:
+		client->telnetState = CLI_SERVER_TN_DATA;
+		if ((byte == '\n') || (byte == '\0')) {
+			break;
+		}
+		// Fall through
+	case CLI_SERVER_TN_DATA:
+		if (byte == TELNET_IAC) {
+			client->telnetState = CLI_SERVER_TN_IAC;
+		} else if ((byte == '\r') && (isBinary == false)) {
+			client->telnetState = CLI_SERVER_TN_CR;
+			cli_rx('\n');
+		} else {
+			cli_rx(byte);
+		}
+		break;
+	case CLI_SERVER_TN_IAC:
+		if (byte == TELNET_IAC) {
+			client->telnetState = CLI_SERVER_TN_DATA;
+			cli_rx(byte); // Escaped 0xFF
+		} else if ((byte >= TELNET_WILL) && (byte <= TELNET_DONT)) {
+			client->telnetState = CLI_SERVER_TN_OPTION;
+		} else if (byte == TELNET_SB) {
+			client->telnetState = CLI_SERVER_TN_SB;
+		} else {
+			client->telnetState = CLI_SERVER_TN_DATA; // Commands without option (NOP, IP, ...)
+		}
+		break;
+	case CLI_SERVER_TN_OPTION:
+		client->telnetState = CLI_SERVER_TN_DATA;
+		break;
+	case CLI_SERVER_TN_SB:
+		if (byte == TELNET_IAC) {
+			client->telnetState = CLI_SERVER_TN_SB_IAC;
+		}
+		break;
+	case CLI_SERVER_TN_SB_IAC:
+		client->telnetState = (byte == TELNET_SE) ? CLI_SERVER_TN_DATA : CLI_SERVER_TN_SB;
+		break;
+	default:
+		client->telnetState = CLI_SERVER_TN_DATA;
+		break;
+	}
+}
+
+/**
+ * @brief Read and process incomming bytes of a client
+ *
+ * @param client Pointer
+ */
+static void cli_server_read(cli_server_client_t * client)
+{
+	uint8_t       buffer[CLI_SERVER_RX_LENGTH];
+	cli_session * prevSession = cli_session_get();
+	ssize_t       len;
+	bool          isExiting;
+
+	len = read(client->fd, buffer, sizeof(buffer));
+	if (len < 0) {
+		if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) {
+			return;
+		}
+		cli_server_close_client(client);
+		return;
+	} else if (len == 0) {
+		cli_server_close_client(client);
+		return;
+	}
+
+	// Process bytes within the session of the client
+	cliServer.curClient = client;
+	cli_session_select(&client->session);
+	for (ssize_t i = 0; i < len; ++i) {
+		cli_server_telnet_rx(client, buffer[i]);
+	}
+	isExiting = lb_is_exiting();
+	cli_session_select(prevSession);
+	cliServer.curClient = NULL;
+
+	cli_server_stream(client);
+	if ((cli_server_flush(client) != 0) || isExiting) {
+		cli_server_close_client(client);
+	}
+}
+
+// ===================
+//       EXTERN
+// ===================
+
+/**
+ * @brief Listen for TCP/telnet connections
+ * @note cli_init() must be called before
+ *
+ * @param address IPv4 address to listen on, NULL for all interfaces
+ * @param port TCP port, 0 to let the system choose (see cli_server_get_port())
+ * @return 0: ok, -1: Error
+ */
+int cli_server_open(const char * address, uint16_t port)
+{
+	struct sockaddr_in addr;
+	socklen_t          addrLen = sizeof(addr);
+	struct epoll_event event;
+	int                one = 1;
+
+	cli_server_close();
+	for (uint16_t i = 0; i < CLI_SERVER_MAX_SESSIONS; ++i) {
+		cliServer.clients[i].fd = -1;
+	}
+	cliServer.clientCount = 0;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family      = AF_INET;
+	addr.sin_port        = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	if ((address != NULL) && (inet_pton(AF_INET, address, &addr.sin_addr) != 1)) {
+		DPRINTF(ERROR, "Invalid address \"%s\"\n\r", address);
+		return -1;
+	}
+
+	cliServer.listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	cliServer.epollFd  = epoll_create1(EPOLL_CLOEXEC);
+	if ((cliServer.listenFd < 0) || (cliServer.epollFd < 0)) {
+		goto retFailed;
+	}
+
+	setsockopt(cliServer.listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if ((bind(cliServer.listenFd, (struct sockaddr *) &addr, sizeof(addr)) != 0) ||
+		(listen(cliServer.listenFd, SOMAXCONN) != 0) ||
+		(getsockname(cliServer.listenFd, (struct sockaddr *) &addr, &addrLen) != 0)) {
+		DPRINTF(ERROR, "Unable to listen on port %u\n\r", port);
+		goto retFailed;
+	}
+	cliServer.port           = ntohs(addr.sin_port);
+	cliServer.isAcceptPaused = false;
+
+	event.events   = EPOLLIN;
+	event.data.u32 = CLI_SERVER_LISTEN_ID;
+	if (epoll_ctl(cliServer.epollFd, EPOLL_CTL_ADD, cliServer.listenFd, &event) != 0) {
+		goto retFailed;
+	}
+
+	return 0;
+
+retFailed:
+	cli_server_close();
+	return -1;
+}
+
+/**
+ * @brief Give the file descriptor to watch in an external event loop
+ * @details It becomes readable when cli_server_poll() has work to do
+ *
+ * @return The epoll file descriptor, -1 if server is closed
+ */
+int cli_server_get_fd(void)
+{
+	return cliServer.epollFd;
+}
+
+/**
+ * @brief Give the TCP port the server listens on
+ * @return Port number
+ */
+uint16_t cli_server_get_port(void)
+{
+	return cliServer.port;
+}
+
+/**
+ * @brief Give the number of connected clients
+ * @return Number of sessions
+ */
+uint16_t cli_server_get_session_count(void)
+{
+	return cliServer.clientCount;
+}
+
+/**
+ * @brief Wait for and process network events
+ *
+ * @param timeoutMs Maximum time to wait in ms, 0 to return immediately,
+ * CLI_SERVER_NO_TIMEOUT to wait forever
+ * @return Number of events processed, -1: Error
+ */
+int cli_server_poll(int timeoutMs)
+{
+	struct epoll_event    events[CLI_SERVER_EVENT_COUNT];
+	cli_server_client_t * client;
+	int                   count;
+	int                   acceptDelay = cli_server_get_accept_delay();
+
+	// Try to accept again once the delay is over
+	if (cliServer.isAcceptPaused && (acceptDelay > 0) && ((timeoutMs < 0) || (timeoutMs > acceptDelay))) {
+		timeoutMs = acceptDelay;
+	}
+	count = epoll_wait(cliServer.epollFd, events, CLI_SERVER_EVENT_COUNT, timeoutMs);
+	if (count < 0) {
+		return (errno == EINTR) ? 0 : -1;
+	}
+	if (cliServer.isAcceptPaused && (cli_server_get_accept_delay() == 0)) {
+		cli_server_pause_accept(false);
+	}
+
+	for (int i = 0; i < count; ++i) {
+		if (events[i].data.u32 == CLI_SERVER_LISTEN_ID) {
+			cli_server_accept();
+			continue;
+		}
+
+		client = &cliServer.clients[events[i].data.u32];
+		if (client->fd < 0) {
+			continue; // Closed by a previous event
+		}
+
+		if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+			cli_server_close_client(client);
+			continue;
+		}
+		if (events[i].events & EPOLLOUT) {
+			// Make room, fill it with the streamed output, then send it
+			if (cli_server_flush(client) == 0) {
+				cli_server_stream(client);
+			}
+			if (cli_server_flush(client) != 0) {
+				cli_server_close_client(client);
+				continue;
+			}
+		}
+		if (events[i].events & EPOLLIN) {
+			cli_server_read(client);
+		}
+	}
+	return count;
+}
+
+/**
+ * @brief Disconnect all clients and stop listening
+ */
+void cli_server_close(void)
+{
+	// Client slots are valid only once the server was opened
+	if (cliServer.epollFd >= 0) {
+		for (uint16_t i = 0; i < CLI_SERVER_MAX_SESSIONS; ++i) {
+			if (cliServer.clients[i].fd >= 0) {
+				cli_server_close_client(&cliServer.clients[i]);
+			}
+		}
+		close(cliServer.epollFd);
+		cliServer.epollFd = -1;
+	}
+	if (cliServer.listenFd >= 0) {
+		close(cliServer.listenFd);
+		cliServer.listenFd = -1;
+	}
+}
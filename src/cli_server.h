@@ -0,0 +1,27 @@
+#ifndef CLI_SERVER_H
+#define CLI_SERVER_H
+
+// ======================
+// Includes
+// ======================
+
+#include "cli.h"
+
+// ======================
+// Constants
+// ======================
+
+#define CLI_SERVER_NO_TIMEOUT -1 /**< Wait forever in cli_server_poll() */
+
+// ======================
+// Protoypes
+// ======================
+
+int      cli_server_open(const char * address, uint16_t port);
+int      cli_server_get_fd(void);
+uint16_t cli_server_get_port(void);
+uint16_t cli_server_get_session_count(void);
+int      cli_server_poll(int timeoutMs);
+void     cli_server_close(void);
+
+#endif /* CLI_SERVER_H */
@@ -0,0 +1,127 @@
+#include "cli_snapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CLI_SNAPSHOT_C
+#include "cli_debug.h"
+
+// Global variables
+uint8_t * cliSnapshotImage;     /**< Mapping used as the tree, NULL if none */
+size_t    cliSnapshotImageSize; /**< Size of cliSnapshotImage */
+
+// ===================
+//      EXTERN
+// ===================
+
+/**
+ * @brief Write the tree to a file cli_snapshot_load() reads at next start
+ * @details The image is written to a temporary file which then replaces the
+ * snapshot, so processes mapping the previous one are not disturbed
+ * @see cli_snapshot_export()
+ *
+ * @param path Path of the file, created or replaced
+ * @param symbols Every callback, provider and options used by the tree
+ * @param symbolCount Number of symbols
+ * @return 0: ok, -1: Error
+ */
+int cli_snapshot_save(const char * path, const cli_symbol_t * symbols, uint16_t symbolCount)
+{
+	char      tmpPath[CLI_SNAPSHOT_PATH_LENGTH + 4];
+	uint8_t * image;
+	int       size;
+	int       fd;
+	int       ret = -1;
+
+	if (strlen(path) >= CLI_SNAPSHOT_PATH_LENGTH) {
+		DPRINTF(ERROR, "Snapshot file path is too long (CLI_SNAPSHOT_PATH_LENGTH = %d)\n\r", CLI_SNAPSHOT_PATH_LENGTH);
+		return -1;
+	}
+
+	size = cli_snapshot_export(NULL, 0, symbols, symbolCount);
+	snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+	fd = open(tmpPath, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		DPRINTF(ERROR, "Unable to create \"%s\"\n\r", tmpPath);
+		return -1;
+	}
+
+	// The image is exported straight into the file
+	if (ftruncate(fd, size) == 0) {
+		image = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (image != MAP_FAILED) {
+			ret = (cli_snapshot_export(image, size, symbols, symbolCount) == size) ? 0 : -1;
+			munmap(image, size);
+		}
+	}
+	if ((ret == 0) && (fsync(fd) != 0)) {
+		ret = -1;
+	}
+	close(fd);
+
+	if ((ret != 0) || (rename(tmpPath, path) != 0)) {
+		DPRINTF(ERROR, "Unable to write snapshot file \"%s\"\n\r", path);
+		unlink(tmpPath);
+		return -1;
+	}
+	DPRINTF(INFO, "Snapshot saved (%d bytes)\n\r", size);
+	return 0;
+}
+
+/**
+ * @brief Replace the tree by the one of a file written by cli_snapshot_save()
+ * @details The file is mapped and the mapping becomes the tree, nothing is
+ * copied nor rebuilt. The mapping is private: pages are read from the page
+ * cache, shared by all the processes loading the file, until a process
+ * changes a token of the page (Ex: lazy tokens, modules registered after),
+ * which then gets its own copy. The mapping is kept until the next load.
+ * A missing or outdated file is an error, the tree must then be built and
+ * saved again.
+ * @note cli_init() must be called right before
+ * @see cli_snapshot_import()
+ *
+ * @param path Path of the file
+ * @param symbols Same names, in the same order, as the ones given to cli_snapshot_save()
+ * @param symbolCount Number of symbols
+ * @return 0: ok, -1: Error (The tree only has root)
+ */
+int cli_snapshot_load(const char * path, const cli_symbol_t * symbols, uint16_t symbolCount)
+{
+	struct stat st;
+	uint8_t *   image;
+	int         fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		DPRINTF(INFO, "No snapshot file \"%s\"\n\r", path);
+		return -1;
+	}
+	if ((fstat(fd, &st) != 0) || (st.st_size == 0) || (st.st_size > UINT32_MAX)) {
+		DPRINTF(ERROR, "Unable to use snapshot file \"%s\"\n\r", path);
+		close(fd);
+		return -1;
+	}
+
+	// Copy on write, the file is never changed
+	image = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (image == MAP_FAILED) {
+		DPRINTF(ERROR, "Unable to map snapshot file \"%s\"\n\r", path);
+		return -1;
+	}
+
+	if (cli_snapshot_import(image, st.st_size, symbols, symbolCount) != 0) {
+		munmap(image, st.st_size);
+		return -1;
+	}
+
+	// The tree no longer uses the previous mapping since cli_init()
+	if (cliSnapshotImage != NULL) {
+		munmap(cliSnapshotImage, cliSnapshotImageSize);
+	}
+	cliSnapshotImage     = image;
+	cliSnapshotImageSize = st.st_size;
+	return 0;
+}
@@ -0,0 +1,23 @@
+#ifndef CLI_SNAPSHOT_H
+#define CLI_SNAPSHOT_H
+
+// ======================
+// Includes
+// ======================
+
+#include "cli.h"
+
+// ======================
+// Constants
+// ======================
+
+#define CLI_SNAPSHOT_PATH_LENGTH 256 /**< Maximum length of the snapshot file path */
+
+// ======================
+// Protoypes
+// ======================
+
+int cli_snapshot_save(const char * path, const cli_symbol_t * symbols, uint16_t symbolCount);
+int cli_snapshot_load(const char * path, const cli_symbol_t * symbols, uint16_t symbolCount);
+
+#endif /* CLI_SNAPSHOT_H */
@@ -0,0 +1,208 @@
+#include "cli_trace.h"
+
+#ifdef __unix__
+#include <time.h>
+#endif
+
+// Global variables
+#if (CLI_TRACE_LENGTH > 0)
+CLI_THREAD_LOCAL cli_trace_record_t cliTrace[CLI_TRACE_LENGTH]; /**< Ring of the last events of the thread */
+CLI_THREAD_LOCAL uint32_t           cliTraceCount;              /**< Number of events recorded, the next one goes to cliTrace[cliTraceCount % CLI_TRACE_LENGTH] */
+
+/**
+ * Names of the events, indexed by CLI_TRACE_*
+ */
+static const char * const cliTraceNames[CLI_TRACE_COUNT] = {
+	[CLI_TRACE_RX]       = "rx",
+	[CLI_TRACE_REDRAW]   = "redraw",
+	[CLI_TRACE_PARSE]    = "parse",
+	[CLI_TRACE_RESOLVE]  = "resolve",
+	[CLI_TRACE_CB_START] = "cb start",
+	[CLI_TRACE_CB_END]   = "cb end",
+};
+#endif
+
+// ===================
+//      STATIC
+// ===================
+
+#if (CLI_TRACE_LENGTH > 0)
+/**
+ * @brief Print one record
+ *
+ * @param record Pointer
+ * @param prevTime Time of the previous record
+ * @param isRaw true: Numbers only, false: Decoded
+ */
+static void cli_trace_print_record(const cli_trace_record_t * record, uint32_t prevTime, bool isRaw)
+{
+	const char * name = (record->event < CLI_TRACE_COUNT) ? cliTraceNames[record->event] : "?";
+	const char * text = "";
+	cli_token *  curTok;
+
+	if (isRaw) {
+		CLI_PRINTF("%08lX %02X %02X %04X\n\r", (unsigned long) record->time, record->event, record->token, record->arg);
+		return;
+	}
+
+	// The token may have been removed since
+	curTok = cli_get_token(record->token);
+	if (curTok != NULL) {
+		text = curTok->text;
+	}
+
+	if (record->event == CLI_TRACE_RX) {
+		bool isPrintable = (record->arg >= ' ') && (record->arg < 0x7F);
+
+		CLI_PRINTF("%+10ld %-8s 0x%02X %c\n\r", (long) (record->time - prevTime), name, record->arg, isPrintable ? record->arg : ' ');
+	} else {
+		CLI_PRINTF("%+10ld %-8s %-*s %d\n\r", (long) (record->time - prevTime), name, CLI_MAX_TEXT_LEN, text, (int16_t) record->arg);
+	}
+}
+#endif
+
+/**
+ * @brief Callback of "trace [raw|clear]"
+ *
+ * @param argc Argument count
+ * @param argv "raw": Print numbers, "clear": Forget the events
+ * @return 0: ok, -1: Error
+ */
+static int cli_trace_cb_trace(uint8_t argc, char * argv[])
+{
+	if (argc == 0) {
+		cli_trace_print(false);
+	} else if (strcmp(argv[0], "raw") == 0) {
+		cli_trace_print(true);
+	} else if (strcmp(argv[0], "clear") == 0) {
+		cli_trace_clear();
+	} else {
+		CLI_PRINTF("Unknown argument \"%s\"\n\r", argv[0]);
+		return -1;
+	}
+	return 0;
+}
+
+// ===================
+//       EXTERN
+// ===================
+
+/**
+ * @brief Record an event, use CLI_TRACE() to remove it when CLI_TRACE_LENGTH is 0
+ * @details Nothing is formatted, the record is decoded when printed
+ *
+ * @param event CLI_TRACE_*
+ * @param token Index of the token, CLI_TRACE_NO_TOKEN if none
+ * @param arg Depends on event
+ */
+void cli_trace(uint8_t event, uint8_t token, uint16_t arg)
+{
+#if (CLI_TRACE_LENGTH > 0)
+	cli_trace_record_t * record = &cliTrace[cliTraceCount++ & (CLI_TRACE_LENGTH - 1)];
+
+	record->time  = CLI_TRACE_CLOCK();
+	record->event = event;
+	record->token = token;
+	record->arg   = arg;
+#endif
+}
+
+/**
+ * @brief Default CLI_TRACE_CLOCK()
+ * @return Monotonic time in ns on UNIX, cli_get_tick() in ms otherwise
+ */
+uint32_t cli_trace_clock(void)
+{
+#ifdef __unix__
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000UL + now.tv_nsec;
+#else
+	return cli_get_tick();
+#endif
+}
+
+/**
+ * @brief Copy the recorded events, oldest first
+ *
+ * @param records Where events are written
+ * @param maxCount Size of records
+ * @return Number of events written (The most recent ones)
+ */
+uint16_t cli_trace_read(cli_trace_record_t * records, uint16_t maxCount)
+{
+#if (CLI_TRACE_LENGTH > 0)
+	uint32_t count = (cliTraceCount < CLI_TRACE_LENGTH) ? cliTraceCount : CLI_TRACE_LENGTH;
+	uint32_t first;
+
+	if (count > maxCount) {
+		count = maxCount;
+	}
+	first = cliTraceCount - count;
+	for (uint32_t i = 0; i < count; ++i) {
+		records[i] = cliTrace[(first + i) & (CLI_TRACE_LENGTH - 1)];
+	}
+	return count;
+#else
+	return 0;
+#endif
+}
+
+/**
+ * @brief Forget the recorded events
+ */
+void cli_trace_clear(void)
+{
+#if (CLI_TRACE_LENGTH > 0)
+	cliTraceCount = 0;
+#endif
+}
+
+/**
+ * @brief Print the recorded events, oldest first
+ * @details Decoded lines give the time elapsed since the previous event
+ * (unit of CLI_TRACE_CLOCK()), raw lines are "<time> <event> <token> <arg>"
+ * in hexadecimal
+ *
+ * @param isRaw true: Numbers only, false: Decoded
+ */
+void cli_trace_print(bool isRaw)
+{
+#if (CLI_TRACE_LENGTH > 0)
+	uint32_t count = (cliTraceCount < CLI_TRACE_LENGTH) ? cliTraceCount : CLI_TRACE_LENGTH;
+	uint32_t first = cliTraceCount - count;
+	uint32_t prevTime;
+
+	if (count == 0) {
+		return;
+	}
+	prevTime = cliTrace[first & (CLI_TRACE_LENGTH - 1)].time;
+	for (uint32_t i = 0; i < count; ++i) {
+		const cli_trace_record_t * record = &cliTrace[(first + i) & (CLI_TRACE_LENGTH - 1)];
+
+		cli_trace_print_record(record, prevTime, isRaw);
+		prevTime = record->time;
+	}
+#else
+	CLI_PRINTF("Trace is disabled (CLI_TRACE_LENGTH = 0)\n\r");
+#endif
+}
+
+/**
+ * @brief Add the "trace" command
+ *
+ * @param parent Token receiving the command (Ex: root)
+ * @return 0: ok, -1: Error
+ */
+int cli_trace_register(cli_token * parent)
+{
+	cli_token * curTok = cli_add_token("trace", CLI_DESC(trace, "[raw|clear] Print events"));
+
+	if (curTok == NULL) {
+		return -1;
+	}
+	cli_set_callback(curTok, &cli_trace_cb_trace);
+	cli_set_argc(curTok, 0, 1);
+	return cli_add_children(parent, curTok);
+}
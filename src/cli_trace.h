@@ -0,0 +1,55 @@
+#ifndef CLI_TRACE_H
+#define CLI_TRACE_H
+
+// ======================
+// Includes
+// ======================
+
+#include "cli.h"
+
+// ======================
+// Constants
+// ======================
+
+#define CLI_TRACE_RX       0 /**< Byte received, arg: byte */
+#define CLI_TRACE_REDRAW   1 /**< Prompt and line written, arg: cursor position */
+#define CLI_TRACE_PARSE    2 /**< Line split in words, arg: word count (< 0: Error) */
+#define CLI_TRACE_RESOLVE  3 /**< Leaf of a command found, arg: argument count */
+#define CLI_TRACE_CB_START 4 /**< Callback called */
+#define CLI_TRACE_CB_END   5 /**< Callback returned, arg: status */
+#define CLI_TRACE_COUNT    6
+
+#define CLI_TRACE_NO_TOKEN 0xFF /**< Token of the events without one */
+
+#if (CLI_TRACE_LENGTH > 0)
+#define CLI_TRACE(event, token, arg) cli_trace(CLI_TRACE_##event, token, arg) /**< Record an event (Ex: CLI_TRACE(RX, CLI_TRACE_NO_TOKEN, byte)) */
+#else
+#define CLI_TRACE(event, token, arg)
+#endif
+
+// ======================
+// Typedefs and structs
+// ======================
+
+/**
+ * An event of the trace
+ */
+typedef struct {
+	uint32_t time;  /**< CLI_TRACE_CLOCK() when recorded */
+	uint8_t  event; /**< CLI_TRACE_* */
+	uint8_t  token; /**< Index of the token (See cli_get_token()), CLI_TRACE_NO_TOKEN if none */
+	uint16_t arg;   /**< Depends on event */
+} cli_trace_record_t;
+
+// ======================
+// Protoypes
+// ======================
+
+void     cli_trace(uint8_t event, uint8_t token, uint16_t arg);
+uint32_t cli_trace_clock(void);
+uint16_t cli_trace_read(cli_trace_record_t * records, uint16_t maxCount);
+void     cli_trace_clear(void);
+void     cli_trace_print(bool isRaw);
+int      cli_trace_register(cli_token * parent);
+
+#endif /* CLI_TRACE_H */
@@ -0,0 +1,247 @@
+#include "cli_tty.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "cli_watch.h"
+
+#define CLI_TTY_C
+#include "cli_debug.h"
+
+// Global variables
+typedef struct {
+	cli_session    session;       /**< CLI state of the terminal */
+	int            inFd;          /**< Where bytes are read, -1 if closed */
+	int            outFd;         /**< Where the output is written */
+	uint8_t        isRaw : 1;     /**< Tell if the settings of inFd were changed (It is a terminal) */
+	uint8_t        isAfterCr : 1; /**< Tell if the last byte was '\r', a following '\n' or '\0' is dropped */
+	struct termios savedSettings; /**< Settings of inFd restored by cli_tty_close() */
+} cli_tty_t;
+cli_tty_t cliTty             = { .inFd = -1, .outFd = -1 };
+bool      cliTtyIsRegistered = false; /**< Tell if cli_tty_close() is called at exit */
+
+// ===================
+//      STATIC
+// ===================
+
+/**
+ * @brief Output callback of the terminal session
+ * @details Blocks until the terminal took everything, as a terminal does
+ * @see cli_output_callback_t
+ *
+ * @param str Bytes to write
+ * @param len Number of bytes
+ * @return Number of bytes written, -1: Error
+ */
+static int cli_tty_output(const char * str, uint16_t len)
+{
+	uint16_t pos = 0;
+	ssize_t  written;
+
+	while (pos < len) {
+		written = write(cliTty.outFd, str + pos, len - pos);
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return (pos > 0) ? pos : -1;
+		}
+		pos += written;
+	}
+	return len;
+}
+
+/**
+ * @brief Give a received byte to the CLI
+ * @details The Enter key sends '\r' in raw mode, it is given as '\n' and the
+ * '\n' or '\0' some terminals send after it is dropped. Bytes are given as
+ * they are in binary mode and during a raw upload.
+ *
+ * @param byte Incomming byte
+ */
+static void cli_tty_rx(uint8_t byte)
+{
+	cli_session * session = &cliTty.session;
+
+	if ((session->mode == CLI_MODE_BINARY) || ((session->upload != NULL) && (session->uploadEncoding == CLI_UPLOAD_RAW))) {
+		cliTty.isAfterCr = false;
+		cli_rx(byte);
+		return;
+	}
+
+	if (cliTty.isAfterCr && ((byte == '\n') || (byte == '\0'))) {
+		cliTty.isAfterCr = false;
+		return;
+	}
+	cliTty.isAfterCr = (byte == '\r');
+	cli_rx(cliTty.isAfterCr ? '\n' : byte);
+}
+
+/**
+ * @brief Read and process the bytes waiting in the input
+ *
+ * @return Number of bytes read, -1: Error or end of input
+ */
+static int cli_tty_read(void)
+{
+	uint8_t buffer[CLI_TTY_RX_LENGTH];
+	ssize_t len;
+
+	len = read(cliTty.inFd, buffer, sizeof(buffer));
+	if (len < 0) {
+		return ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) ? 0 : -1;
+	} else if (len == 0) {
+		DPRINTF(INFO, "End of input\n\r");
+		return -1;
+	}
+
+	for (ssize_t i = 0; i < len; ++i) {
+		cli_tty_rx(buffer[i]);
+	}
+	return len;
+}
+
+// ===================
+//       EXTERN
+// ===================
+
+/**
+ * @brief Serve the CLI on a terminal, a serial device or any file descriptor
+ * @details A terminal is switched to raw mode (no echo, no line edition and
+ * no signal keys, the CLI does it) until cli_tty_close(), which is also called
+ * at exit. Descriptors are not closed by this module.
+ * @note cli_init() must be called before
+ *
+ * @param inFd Where bytes are read (Ex: STDIN_FILENO, an opened /dev/ttyS0)
+ * @param outFd Where the output is written, can be inFd
+ * @return 0: ok, -1: Error
+ */
+int cli_tty_open(int inFd, int outFd)
+{
+	struct termios settings;
+
+	cli_tty_close();
+	cliTty.isRaw     = false;
+	cliTty.isAfterCr = false;
+
+	// Pipes and sockets are read as they are
+	if (isatty(inFd)) {
+		if (tcgetattr(inFd, &cliTty.savedSettings) != 0) {
+			DPRINTF(ERROR, "Unable to get the terminal settings\n\r");
+			return -1;
+		}
+
+		// Same as cfmakeraw(), which is not POSIX
+		settings = cliTty.savedSettings;
+		settings.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON);
+		settings.c_oflag &= ~OPOST;
+		settings.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+		settings.c_cflag &= ~(CSIZE | PARENB);
+		settings.c_cflag |= CS8;
+		settings.c_cc[VMIN]  = 1; // read() returns what is there, poll() tells when
+		settings.c_cc[VTIME] = 0;
+		if (tcsetattr(inFd, TCSANOW, &settings) != 0) {
+			DPRINTF(ERROR, "Unable to set the terminal in raw mode\n\r");
+			return -1;
+		}
+		cliTty.isRaw = true;
+
+		if (cliTtyIsRegistered == false) {
+			atexit(&cli_tty_close);
+			cliTtyIsRegistered = true;
+		}
+	}
+
+	cliTty.inFd  = inFd;
+	cliTty.outFd = outFd;
+	cli_session_init(&cliTty.session, &cli_tty_output);
+	return 0;
+}
+
+/**
+ * @brief Give the file descriptor to watch in an external event loop
+ * @details It becomes readable when cli_tty_poll() has bytes to process.
+ * While cli_is_streaming(), cli_tty_poll() must also be called when the
+ * output is writable.
+ *
+ * @return The input file descriptor, -1 if closed
+ */
+int cli_tty_get_fd(void)
+{
+	return cliTty.inFd;
+}
+
+/**
+ * @brief Give the session of the terminal
+ * @details Select it to act on the terminal out of cli_tty_poll()
+ * (Ex: lb_history_file_open())
+ *
+ * @return Pointer
+ */
+cli_session * cli_tty_get_session(void)
+{
+	return &cliTty.session;
+}
+
+/**
+ * @brief Wait for and process the input, produce the streamed output
+ * @details All the bytes available are read at once, one chunk of the
+ * streamed output is written if the output is writable
+ *
+ * @param timeoutMs Maximum time to wait in ms, 0 to return immediately,
+ * CLI_TTY_NO_TIMEOUT to wait forever
+ * @return Number of bytes read, -1: Error or end of input
+ */
+int cli_tty_poll(int timeoutMs)
+{
+	cli_session * prevSession = cli_session_get();
+	struct pollfd fds[2];
+	int           count = 0;
+
+	if (cliTty.inFd < 0) {
+		return -1;
+	}
+
+	fds[0].fd     = cliTty.inFd;
+	fds[0].events = POLLIN;
+	fds[1].fd     = (cliTty.session.stream != NULL) ? cliTty.outFd : -1; // Ignored by poll() if < 0
+	fds[1].events = POLLOUT;
+	if (poll(fds, 2, timeoutMs) < 0) {
+		return (errno == EINTR) ? 0 : -1;
+	}
+
+	cli_session_select(&cliTty.session);
+	if (fds[0].revents & POLLIN) {
+		count = cli_tty_read();
+	} else if (fds[0].revents & (POLLHUP | POLLERR | POLLNVAL)) {
+		count = -1;
+	}
+	if ((count >= 0) && (fds[1].revents & POLLOUT)) {
+		cli_poll();
+	}
+	cli_session_select(prevSession);
+	return count;
+}
+
+/**
+ * @brief Stop to serve the CLI and restore the terminal settings
+ */
+void cli_tty_close(void)
+{
+	if (cliTty.inFd < 0) {
+		return;
+	}
+
+	// Wait for the output to be written before leaving raw mode
+	if (cliTty.isRaw) {
+		tcsetattr(cliTty.inFd, TCSADRAIN, &cliTty.savedSettings);
+	}
+	cli_watch_remove_session(&cliTty.session);
+	if (cli_session_get() == &cliTty.session) {
+		cli_session_select(NULL);
+	}
+	cliTty.inFd = -1;
+}
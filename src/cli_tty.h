@@ -0,0 +1,26 @@
+#ifndef CLI_TTY_H
+#define CLI_TTY_H
+
+// ======================
+// Includes
+// ======================
+
+#include "cli.h"
+
+// ======================
+// Constants
+// ======================
+
+#define CLI_TTY_NO_TIMEOUT -1 /**< Wait forever in cli_tty_poll() */
+
+// ======================
+// Protoypes
+// ======================
+
+int           cli_tty_open(int inFd, int outFd);
+int           cli_tty_get_fd(void);
+cli_session * cli_tty_get_session(void);
+int           cli_tty_poll(int timeoutMs);
+void          cli_tty_close(void);
+
+#endif /* CLI_TTY_H */
@@ -0,0 +1,502 @@
+#include "cli_watch.h"
+
+#include <stdlib.h>
+
+#define CLI_WATCH_C
+#include "cli_debug.h"
+
+#define CLI_WATCH_SLOT_MASK (CLI_WATCH_WHEEL_SLOTS - 1)
+
+/**
+ * A command run periodically, resolved once when added
+ */
+typedef struct cli_watch_job_t {
+	struct cli_watch_job_t * next;                       /**< Next job of the same wheel slot */
+	cli_session *            session;                    /**< Where the command runs, NULL if job is free or cancelled */
+	cli_token *              token;                      /**< Leaf of the command */
+	uint32_t                 periodMs;                   /**< Period asked by the user */
+	uint32_t                 periodTicks;                /**< Period in wheel ticks */
+	uint32_t                 expireTick;                 /**< Wheel tick of the next run */
+	uint8_t                  argIndex;                   /**< Index of the first argument in cmdText */
+	uint8_t                  argc;                       /**< Number of arguments */
+	uint8_t                  isLinked : 1;               /**< Tell if job is in the wheel (or being run) */
+	cli_option_values_t      options;                    /**< Options of the command */
+	char *                   cmdText[CLI_CMD_MAX_TOKEN]; /**< Words of line */
+	char                     line[CLI_CMD_MAX_LEN];      /**< The command, split in place */
+} cli_watch_job_t;
+
+// Global variables
+typedef struct {
+	cli_watch_job_t   jobs[CLI_WATCH_MAX_JOBS];     /**< All job slots */
+	cli_watch_job_t * wheel[CLI_WATCH_WHEEL_SLOTS]; /**< Jobs by slot of their next run */
+	uint32_t          curTick;                      /**< Last wheel tick processed */
+	uint32_t          lastMs;                       /**< Time of curTick */
+	uint8_t           jobCount;                     /**< Number of active jobs */
+	uint8_t           isStarted : 1;                /**< Tell if lastMs is known */
+	uint8_t           isExpiring : 1;               /**< Tell if jobs are being run */
+	cli_token *       tokWatch;                     /**< "watch" command, can't be watched */
+	cli_token *       tokUnwatch;                   /**< "unwatch" command, can't be watched */
+} cli_watch_t;
+cli_watch_t cliWatch;
+
+// ===================
+//      STATIC
+// ===================
+
+/**
+ * @brief Put a job in the wheel slot of its next run
+ *
+ * @param job Pointer
+ */
+static void cli_watch_link(cli_watch_job_t * job)
+{
+	cli_watch_job_t ** slot = &cliWatch.wheel[job->expireTick & CLI_WATCH_SLOT_MASK];
+
+	job->next     = *slot;
+	job->isLinked = true;
+	*slot         = job;
+}
+
+/**
+ * @brief Remove a job from the wheel
+ *
+ * @param job Pointer, must be linked
+ */
+static void cli_watch_unlink(cli_watch_job_t * job)
+{
+	cli_watch_job_t ** link = &cliWatch.wheel[job->expireTick & CLI_WATCH_SLOT_MASK];
+
+	while (*link != NULL) {
+		if (*link == job) {
+			*link         = job->next;
+			job->isLinked = false;
+			return;
+		}
+		link = &(*link)->next;
+	}
+}
+
+/**
+ * @brief Stop a job
+ * @details While jobs are run, the job stays in the wheel until its slot is
+ * processed so that the slot being processed is never modified
+ *
+ * @param job Pointer
+ */
+static void cli_watch_cancel(cli_watch_job_t * job)
+{
+	if (job->session == NULL) {
+		return;
+	}
+
+	job->session = NULL;
+	--cliWatch.jobCount;
+	if (cliWatch.isExpiring == false) {
+		cli_watch_unlink(job);
+	}
+}
+
+/**
+ * @brief Run a job within its session
+ * @details Skipped while the session is not in human mode, an output
+ * nobody asked for would break the frames of machine and binary modes
+ *
+ * @param job Pointer
+ */
+static void cli_watch_run(cli_watch_job_t * job)
+{
+	cli_session * prevSession = cli_session_get();
+
+	cli_session_select(job->session);
+
+	// Do not mix with a streamed output
+	if ((job->session->mode == CLI_MODE_HUMAN) && (cli_is_streaming() == false)) {
+		CLI_PRINTF("\x1B[1000D\x1B[K"); // Output replaces the prompt
+		cli_set_option_values(&job->options);
+		cli_call_resolved(job->token, job->argc, &job->cmdText[job->argIndex]);
+		lb_refresh();
+	}
+
+	cli_session_select(prevSession);
+}
+
+/**
+ * @brief Run the due jobs of a wheel slot and schedule their next run
+ *
+ * @param slotIndex Index of the slot
+ */
+static void cli_watch_expire(uint16_t slotIndex)
+{
+	cli_watch_job_t ** link = &cliWatch.wheel[slotIndex];
+	cli_watch_job_t *  due  = NULL;
+	cli_watch_job_t *  job;
+
+	// Take due jobs out of the slot, free cancelled ones
+	while ((job = *link) != NULL) {
+		if (job->session == NULL) {
+			*link         = job->next;
+			job->isLinked = false;
+		} else if ((int32_t) (job->expireTick - cliWatch.curTick) <= 0) {
+			*link     = job->next;
+			job->next = due;
+			due       = job;
+		} else {
+			link = &job->next;
+		}
+	}
+
+	// Jobs may add or cancel jobs
+	cliWatch.isExpiring = true;
+	while (due != NULL) {
+		job = due;
+		due = job->next;
+
+		if (job->session != NULL) {
+			cli_watch_run(job);
+		}
+		if (job->session == NULL) {
+			job->isLinked = false; // Cancelled while running
+		} else {
+			job->expireTick = cliWatch.curTick + job->periodTicks;
+			cli_watch_link(job);
+		}
+	}
+	cliWatch.isExpiring = false;
+}
+
+/**
+ * @brief Print the jobs of the selected session
+ */
+static void cli_watch_print_jobs(void)
+{
+	for (uint8_t i = 0; i < CLI_WATCH_MAX_JOBS; ++i) {
+		cli_watch_job_t * job = &cliWatch.jobs[i];
+
+		if (job->session != cli_session_get()) {
+			continue;
+		}
+		CLI_PRINTF("%3u %7lu ms", i + 1, (unsigned long) job->periodMs);
+		for (uint8_t j = 0; j < (job->argIndex + job->argc); ++j) {
+			CLI_PRINTF(" %s", job->cmdText[j]);
+		}
+		CLI_PRINTF("\n\r");
+	}
+}
+
+/**
+ * @brief Append a word to a line so that it is parsed back the same
+ * @details Words with spaces, quotes or backslashes are quoted
+ *
+ * @param line The line
+ * @param len Length of line, updated
+ * @param word The word to append after a space
+ * @return 0: ok, -1: Line is too long
+ */
+static int cli_watch_append_word(char * line, uint16_t * len, const char * word)
+{
+	bool isQuoted = (word[0] == '\0') || (strpbrk(word, " \t\"'\\") != NULL);
+
+	// Room for a space, 2 quotes and '\0'
+	if ((*len + 4) > CLI_CMD_MAX_LEN) {
+		return -1;
+	}
+	if (*len > 0) {
+		line[(*len)++] = ' ';
+	}
+	if (isQuoted) {
+		line[(*len)++] = '"';
+	}
+	for (; *word != '\0'; ++word) {
+		if ((*len + 4) > CLI_CMD_MAX_LEN) {
+			return -1;
+		}
+		if ((*word == '"') || (*word == '\\')) {
+			line[(*len)++] = '\\';
+		}
+		line[(*len)++] = *word;
+	}
+	if (isQuoted) {
+		line[(*len)++] = '"';
+	}
+	line[*len] = '\0';
+	return 0;
+}
+
+/**
+ * @brief Read a decimal number given by the user
+ *
+ * @param word The text
+ * @param min Smallest value accepted
+ * @param max Greatest value accepted
+ * @return The number, -1: Not a number or out of [min; max]
+ */
+static int32_t cli_watch_parse_number(const char * word, uint32_t min, uint32_t max)
+{
+	char *        end;
+	unsigned long value;
+
+	if ((word[0] < '0') || (word[0] > '9')) {
+		return -1;
+	}
+	value = strtoul(word, &end, 10);
+	if ((*end != '\0') || (value < min) || (value > max)) {
+		return -1;
+	}
+	return value;
+}
+
+/**
+ * @brief Callback of "watch [<ms> <cmd...>]"
+ * @details Without argument, print the jobs of the session
+ *
+ * @param argc Argument count
+ * @param argv Period and command
+ * @return 0: ok, -1: Error
+ */
+static int cli_watch_cb_watch(uint8_t argc, char * argv[])
+{
+	char     line[CLI_CMD_MAX_LEN];
+	uint16_t len = 0;
+	int32_t  periodMs;
+	int      id;
+
+	if (argc == 0) {
+		cli_watch_print_jobs();
+		return 0;
+	} else if (argc < 2) {
+		CLI_PRINTF("Usage: watch <ms> <cmd...>\n\r");
+		return -1;
+	}
+
+	periodMs = cli_watch_parse_number(argv[0], CLI_WATCH_TICK_MS, INT32_MAX);
+	if (periodMs < 0) {
+		CLI_PRINTF("Period must be a number of ms, at least %d\n\r", CLI_WATCH_TICK_MS);
+		return -1;
+	}
+
+	// Join the words of the command
+	for (uint8_t i = 1; i < argc; ++i) {
+		if (cli_watch_append_word(line, &len, argv[i]) != 0) {
+			CLI_PRINTF("Command is too long\n\r");
+			return -1;
+		}
+	}
+
+	id = cli_watch_add(line, periodMs);
+	if (id < 0) {
+		return -1;
+	}
+	CLI_PRINTF("Watch %d started\n\r", id);
+	return 0;
+}
+
+/**
+ * @brief Callback of "unwatch [id]"
+ * @details Without argument, stop all the jobs of the session
+ *
+ * @param argc Argument count
+ * @param argv Job ID
+ * @return 0: ok, -1: Error
+ */
+static int cli_watch_cb_unwatch(uint8_t argc, char * argv[])
+{
+	int32_t id = 0;
+
+	if (argc > 0) {
+		id = cli_watch_parse_number(argv[0], 1, CLI_WATCH_MAX_JOBS);
+		if (id < 0) {
+			CLI_PRINTF("Unknown watch %s\n\r", argv[0]);
+			return -1;
+		}
+	}
+	return cli_watch_remove(id);
+}
+
+// ===================
+//       EXTERN
+// ===================
+
+/**
+ * @brief Add the "watch" and "unwatch" commands
+ *
+ * @param parent Token receiving the commands (Ex: root)
+ * @return 0: ok, -1: Error
+ */
+int cli_watch_register(cli_token * parent)
+{
+	cliWatch.tokWatch   = cli_add_token("watch", CLI_DESC(watch, "[<ms> <cmd...>] Repeat a cmd"));
+	cliWatch.tokUnwatch = cli_add_token("unwatch", CLI_DESC(unwatch, "[id] Stop repeated cmds"));
+	if ((cliWatch.tokWatch == NULL) || (cliWatch.tokUnwatch == NULL)) {
+		return -1;
+	}
+
+	cli_set_callback(cliWatch.tokWatch, &cli_watch_cb_watch);
+	cli_set_argc(cliWatch.tokWatch, 0, CLI_CMD_MAX_TOKEN - 1);
+	cli_set_callback(cliWatch.tokUnwatch, &cli_watch_cb_unwatch);
+	cli_set_argc(cliWatch.tokUnwatch, 0, 1);
+
+	if (cli_add_children(parent, cliWatch.tokWatch) != 0) {
+		return -1;
+	}
+	return cli_add_children(parent, cliWatch.tokUnwatch);
+}
+
+/**
+ * @brief Run a command periodically within the selected session
+ * @details The command is parsed and its leaf is found only once,
+ * cli_tick() must be called to run it. Only a session in human mode can
+ * watch, jobs are paused while it is in another mode.
+ *
+ * @param line The command (Ex: "lan show eth0")
+ * @param periodMs Period, at least CLI_WATCH_TICK_MS
+ * @return ID of the job (> 0), -1: Error
+ */
+int cli_watch_add(const char * line, uint32_t periodMs)
+{
+	cli_watch_job_t *   job = NULL;
+	cli_option_values_t callerOptions;
+	int                 argIndex;
+	uint8_t             i;
+
+	if (periodMs < CLI_WATCH_TICK_MS) {
+		CLI_PRINTF("Period must be at least %d ms\n\r", CLI_WATCH_TICK_MS);
+		return -1;
+	} else if (cli_session_get()->mode != CLI_MODE_HUMAN) {
+		CLI_PRINTF("Commands can only be watched in human mode\n\r");
+		return -1;
+	}
+
+	// Find a free job
+	for (i = 0; i < CLI_WATCH_MAX_JOBS; ++i) {
+		if ((cliWatch.jobs[i].session == NULL) && (cliWatch.jobs[i].isLinked == false)) {
+			job = &cliWatch.jobs[i];
+			break;
+		}
+	}
+	if (job == NULL) {
+		CLI_PRINTF("Too many watches (CLI_WATCH_MAX_JOBS = %d)\n\r", CLI_WATCH_MAX_JOBS);
+		return -1;
+	}
+
+	// Resolve the command once, options of the caller are kept
+	cli_get_option_values(&callerOptions);
+	cli_strcpy_safe(job->line, line, CLI_CMD_MAX_LEN);
+	argIndex = cli_resolve_lb(job->line, job->cmdText, &job->token, &job->argc);
+	cli_get_option_values(&job->options);
+	cli_set_option_values(&callerOptions);
+	if (argIndex < 0) {
+		return -1;
+	} else if ((job->token == cliWatch.tokWatch) || (job->token == cliWatch.tokUnwatch)) {
+		CLI_PRINTF("This command can't be watched\n\r");
+		return -1;
+	}
+
+	job->session     = cli_session_get();
+	job->argIndex    = argIndex;
+	job->periodMs    = periodMs;
+	job->periodTicks = (periodMs + CLI_WATCH_TICK_MS - 1) / CLI_WATCH_TICK_MS;
+	job->expireTick  = cliWatch.curTick + job->periodTicks;
+	cli_watch_link(job);
+	++cliWatch.jobCount;
+
+	DPRINTF(INFO, "Job %u: \"%s\" every %lu ms\n\r", i + 1, line, (unsigned long) periodMs);
+	return i + 1;
+}
+
+/**
+ * @brief Stop a job of the selected session
+ *
+ * @param id ID given by cli_watch_add(), 0 to stop all jobs of the session
+ * @return 0: ok, -1: Unknown ID
+ */
+int cli_watch_remove(uint8_t id)
+{
+	if (id == 0) {
+		cli_watch_remove_session(cli_session_get());
+		return 0;
+	} else if ((id > CLI_WATCH_MAX_JOBS) || (cliWatch.jobs[id - 1].session != cli_session_get())) {
+		CLI_PRINTF("Unknown watch %u\n\r", id);
+		return -1;
+	}
+
+	cli_watch_cancel(&cliWatch.jobs[id - 1]);
+	return 0;
+}
+
+/**
+ * @brief Stop all jobs of a session
+ * @details Must be called before a session is destroyed
+ *
+ * @param session Pointer
+ */
+void cli_watch_remove_session(cli_session * session)
+{
+	for (uint8_t i = 0; i < CLI_WATCH_MAX_JOBS; ++i) {
+		if (cliWatch.jobs[i].session == session) {
+			cli_watch_cancel(&cliWatch.jobs[i]);
+		}
+	}
+}
+
+/**
+ * @brief Stop all jobs calling a token
+ * @details Called by cli_remove_token() before the token is freed
+ *
+ * @param curTok Pointer
+ */
+void cli_watch_remove_token(cli_token * curTok)
+{
+	for (uint8_t i = 0; i < CLI_WATCH_MAX_JOBS; ++i) {
+		if (cliWatch.jobs[i].token == curTok) {
+			cli_watch_cancel(&cliWatch.jobs[i]);
+		}
+	}
+	if (curTok == cliWatch.tokWatch) {
+		cliWatch.tokWatch = NULL;
+	} else if (curTok == cliWatch.tokUnwatch) {
+		cliWatch.tokUnwatch = NULL;
+	}
+}
+
+/**
+ * @brief Give the number of jobs
+ * @details When there is none, the main loop doesn't need to call cli_tick()
+ *
+ * @return Number of active jobs
+ */
+uint8_t cli_watch_get_job_count(void)
+{
+	return cliWatch.jobCount;
+}
+
+/**
+ * @brief Run the due jobs
+ * @details Called by cli_tick(). Only the slots between the previous
+ * and the current time are visited.
+ *
+ * @param nowMs Current time (may wrap)
+ */
+void cli_watch_tick(uint32_t nowMs)
+{
+	uint32_t tickCount;
+
+	if (cliWatch.isStarted == false) {
+		cliWatch.lastMs    = nowMs;
+		cliWatch.isStarted = true;
+		return;
+	}
+
+	tickCount = (nowMs - cliWatch.lastMs) / CLI_WATCH_TICK_MS;
+	cliWatch.lastMs += tickCount * CLI_WATCH_TICK_MS;
+
+	// After a long pause, each slot is visited once and late jobs run once
+	if (tickCount > CLI_WATCH_WHEEL_SLOTS) {
+		cliWatch.curTick += tickCount - CLI_WATCH_WHEEL_SLOTS;
+		tickCount = CLI_WATCH_WHEEL_SLOTS;
+	}
+
+	while (tickCount-- > 0) {
+		++cliWatch.curTick;
+		cli_watch_expire(cliWatch.curTick & CLI_WATCH_SLOT_MASK);
+	}
+}
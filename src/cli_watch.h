@@ -0,0 +1,22 @@
+#ifndef CLI_WATCH_H
+#define CLI_WATCH_H
+
+// ======================
+// Includes
+// ======================
+
+#include "cli.h"
+
+// ======================
+// Protoypes
+// ======================
+
+int     cli_watch_register(cli_token * parent);
+int     cli_watch_add(const char * line, uint32_t periodMs);
+int     cli_watch_remove(uint8_t id);
+void    cli_watch_remove_session(cli_session * session);
+void    cli_watch_remove_token(cli_token * curTok);
+uint8_t cli_watch_get_job_count(void);
+void    cli_watch_tick(uint32_t nowMs);
+
+#endif /* CLI_WATCH_H */
@@ -0,0 +1,262 @@
+#include "lb_history_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define LB_HISTORY_FILE_C
+#include "cli_debug.h"
+
+// Bytes at the end of the file that always hold a full history (+1 line for a torn write)
+#define LB_HISTORY_FILE_TAIL_SIZE ((LB_HISTORY_COUNT + 1) * LB_LINE_BUFFER_LENGTH)
+
+// Global variables
+typedef struct {
+	char     path[LB_HISTORY_FILE_PATH_LENGTH]; /**< Path of the history file */
+	int      fd;                                /**< Append-only descriptor of the history file, -1 if closed */
+	int      tmpFd;                             /**< Descriptor of the file being written during compaction */
+	uint32_t appendCount;                       /**< Number of lines appended since last compaction */
+} lb_history_file_t;
+lb_history_file_t historyFile = { .fd = -1, .tmpFd = -1 };
+
+// ===================
+//      STATIC
+// ===================
+
+/**
+ * @brief Give the last lines of a file, oldest first
+ * @details Only the tail of the file is mapped and scanned backward,
+ * so the cost does not depend on the size of the file.
+ * An incomplete last line (torn write) is ignored.
+ *
+ * @param fd The file to read
+ * @param maxLines Maximum number of lines to give
+ * @param lineCallback Function called for each line (without '\n')
+ * @return Number of lines given, -1: Error
+ */
+static int lb_history_file_read_tail(int fd, uint16_t maxLines, lb_history_write_callback_t lineCallback)
+{
+	struct stat  st;
+	off_t        mapOffset;
+	size_t       mapLen;
+	const char * data;
+	const char * pStop;
+	const char * pFirst;
+	const char * pLine;
+	uint16_t     count = 0;
+
+	if (fstat(fd, &st) != 0) {
+		DPRINTF(ERROR, "Unable to stat history file\n\r");
+		return -1;
+	}
+	if (st.st_size == 0) {
+		return 0;
+	}
+
+	// Map only the tail, aligned on a page
+	mapOffset = (st.st_size > LB_HISTORY_FILE_TAIL_SIZE) ? (st.st_size - LB_HISTORY_FILE_TAIL_SIZE) : 0;
+	mapOffset &= ~((off_t) sysconf(_SC_PAGESIZE) - 1);
+	mapLen = st.st_size - mapOffset;
+
+	data = mmap(NULL, mapLen, PROT_READ, MAP_PRIVATE, fd, mapOffset);
+	if (data == MAP_FAILED) {
+		DPRINTF(ERROR, "Unable to map history file\n\r");
+		return -1;
+	}
+
+	// Skip the incomplete last line if any
+	pStop = data + mapLen;
+	while ((pStop > data) && (pStop[-1] != '\n')) {
+		--pStop;
+	}
+
+	// Go backward until we have enough lines
+	pFirst = pStop;
+	while ((pFirst > data) && (count < maxLines)) {
+		pLine = pFirst - 1; // Ending '\n' of the previous line
+		while ((pLine > data) && (pLine[-1] != '\n')) {
+			--pLine;
+		}
+
+		// The first line of the mapping may be cut
+		if ((pLine == data) && (mapOffset != 0)) {
+			break;
+		}
+		pFirst = pLine;
+		++count;
+	}
+
+	// Give lines oldest first
+	count = 0;
+	while (pFirst < pStop) {
+		pLine = memchr(pFirst, '\n', pStop - pFirst);
+		if (pLine > pFirst) {
+			lineCallback(pFirst, pLine - pFirst);
+			++count;
+		}
+		pFirst = pLine + 1;
+	}
+
+	munmap((void *) data, mapLen);
+	return count;
+}
+
+/**
+ * @brief Write a line to the compacted file
+ * @see lb_history_write_callback_t
+ *
+ * @param str The line
+ * @param len The length of str
+ * @return 0: ok, -1: Error
+ */
+static int lb_history_file_write_tmp(const char * str, uint16_t len)
+{
+	struct iovec iov[2] = { { (void *) str, len }, { "\n", 1 } };
+
+	if (writev(historyFile.tmpFd, iov, 2) < 0) {
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Append an accepted line to the history file
+ * @details Line and its ending '\n' are written with a single call
+ * so that concurrent appends never interleave
+ * @see lb_history_write_callback_t
+ *
+ * @param str The line
+ * @param len The length of str
+ * @return 0: ok, -1: Error
+ */
+static int lb_history_file_write(const char * str, uint16_t len)
+{
+	struct iovec iov[2] = { { (void *) str, len }, { "\n", 1 } };
+
+	if (writev(historyFile.fd, iov, 2) < 0) {
+		DPRINTF(ERROR, "Unable to append to history file\n\r");
+		return -1;
+	}
+
+	// Keep the file small
+	if (++historyFile.appendCount >= LB_HISTORY_FILE_COMPACT_LINES) {
+		lb_history_file_compact();
+	}
+	return 0;
+}
+
+// ===================
+//      EXTERN
+// ===================
+
+/**
+ * @brief Load the tail of a history file and append every new
+ * accepted line to it
+ * @note lb_init() must be called before since it clears the history
+ *
+ * @param path Path of the file, created if it does not exist
+ * @return 0: ok, -1: Error
+ */
+int lb_history_file_open(const char * path)
+{
+	struct stat st;
+	char        lastChar;
+
+	lb_history_file_close();
+
+	if (strlen(path) >= LB_HISTORY_FILE_PATH_LENGTH) {
+		DPRINTF(ERROR, "History file path is too long (LB_HISTORY_FILE_PATH_LENGTH = %d)\n\r", LB_HISTORY_FILE_PATH_LENGTH);
+		return -1;
+	}
+	strcpy(historyFile.path, path);
+
+	historyFile.fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+	if (historyFile.fd < 0) {
+		DPRINTF(ERROR, "Unable to open history file \"%s\"\n\r", path);
+		return -1;
+	}
+
+	// The line being edited uses one slot of the history
+	if (lb_history_file_read_tail(historyFile.fd, LB_HISTORY_COUNT - 1, &lb_history_push) < 0) {
+		lb_history_file_close();
+		return -1;
+	}
+
+	// A file that grew while we were not running or ends with
+	// a torn write is compacted right away
+	historyFile.appendCount = 0;
+	if ((fstat(historyFile.fd, &st) == 0) && (st.st_size > 0)) {
+		if ((st.st_size > LB_HISTORY_FILE_COMPACT_LINES * LB_LINE_BUFFER_LENGTH) ||
+			(pread(historyFile.fd, &lastChar, 1, st.st_size - 1) != 1) || (lastChar != '\n')) {
+			lb_history_file_compact();
+		}
+	}
+
+	lb_set_history_write_callback(&lb_history_file_write);
+	return 0;
+}
+
+/**
+ * @brief Rewrite the history file with only the lines that would be loaded
+ * @details The tail is written to a temporary file which then replaces
+ * the history file, so a crash never leaves a partial history
+ *
+ * @return 0: ok, -1: Error
+ */
+int lb_history_file_compact(void)
+{
+	char tmpPath[LB_HISTORY_FILE_PATH_LENGTH + 4];
+	int  ret;
+
+	if (historyFile.fd < 0) {
+		return -1;
+	}
+	historyFile.appendCount = 0;
+
+	snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", historyFile.path);
+	historyFile.tmpFd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (historyFile.tmpFd < 0) {
+		DPRINTF(ERROR, "Unable to create \"%s\"\n\r", tmpPath);
+		return -1;
+	}
+
+	ret = lb_history_file_read_tail(historyFile.fd, LB_HISTORY_COUNT - 1, &lb_history_file_write_tmp);
+	if ((ret >= 0) && (fsync(historyFile.tmpFd) != 0)) {
+		ret = -1;
+	}
+	close(historyFile.tmpFd);
+	historyFile.tmpFd = -1;
+
+	if ((ret < 0) || (rename(tmpPath, historyFile.path) != 0)) {
+		DPRINTF(ERROR, "Unable to compact history file\n\r");
+		unlink(tmpPath);
+		return -1;
+	}
+
+	// Append to the new file from now on
+	close(historyFile.fd);
+	historyFile.fd = open(historyFile.path, O_RDWR | O_APPEND | O_CLOEXEC);
+	if (historyFile.fd < 0) {
+		DPRINTF(ERROR, "Unable to reopen history file\n\r");
+		lb_set_history_write_callback(NULL);
+		return -1;
+	}
+
+	DPRINTF(INFO, "History file compacted (%d lines)\n\r", ret);
+	return 0;
+}
+
+/**
+ * @brief Stop appending lines to the history file
+ */
+void lb_history_file_close(void)
+{
+	if (historyFile.fd < 0) {
+		return;
+	}
+	lb_set_history_write_callback(NULL);
+	close(historyFile.fd);
+	historyFile.fd = -1;
+}
@@ -0,0 +1,24 @@
+#ifndef LB_HISTORY_FILE_H
+#define LB_HISTORY_FILE_H
+
+// ======================
+// Includes
+// ======================
+
+#include "line_buffer.h"
+
+// ======================
+// Constants
+// ======================
+
+#define LB_HISTORY_FILE_PATH_LENGTH 256 /**< Maximum length of the history file path */
+
+// ======================
+// Protoypes
+// ======================
+
+int  lb_history_file_open(const char * path);
+int  lb_history_file_compact(void);
+void lb_history_file_close(void);
+
+#endif /* LB_HISTORY_FILE_H */
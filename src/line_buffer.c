@@ -1,25 +1,64 @@
 #include "line_buffer.h"
 
+#include "cli_trace.h"
+
 #define LINE_BUFFER_C
 #include "cli_debug.h"
 
+// Input decoder states
+#define LB_DEC_GROUND      0 /**< Normal bytes */
+#define LB_DEC_ESC         1 /**< ESC received */
+#define LB_DEC_CSI         2 /**< ESC [ received, reading parameters */
+#define LB_DEC_SS3         3 /**< ESC O received */
+#define LB_DEC_STATE_COUNT 4
+
+// Input decoder byte classes
+#define LB_DEC_CLASS_CTRL  0  /**< C0 controls except ESC */
+#define LB_DEC_CLASS_ESC   1  /**< ESC */
+#define LB_DEC_CLASS_INTER 2  /**< Intermediate bytes 0x20-0x2F */
+#define LB_DEC_CLASS_DIGIT 3  /**< Parameter digits */
+#define LB_DEC_CLASS_SEP   4  /**< Parameter separators ';' ':' */
+#define LB_DEC_CLASS_PRIV  5  /**< Private parameter markers 0x3C-0x3F */
+#define LB_DEC_CLASS_CSI   6  /**< '[' */
+#define LB_DEC_CLASS_SS3   7  /**< 'O' */
+#define LB_DEC_CLASS_FINAL 8  /**< Other final bytes 0x40-0x7E */
+#define LB_DEC_CLASS_DEL   9  /**< DEL */
+#define LB_DEC_CLASS_HIGH  10 /**< Bytes 0x80-0xFF */
+#define LB_DEC_CLASS_COUNT 11
+
+// Input decoder actions
+#define LB_DEC_ACT_NONE  0 /**< Swallow the byte */
+#define LB_DEC_ACT_KEY   1 /**< Give the byte as a key */
+#define LB_DEC_ACT_CLEAR 2 /**< Begin a new sequence */
+#define LB_DEC_ACT_PARAM 3 /**< Accumulate a parameter digit */
+#define LB_DEC_ACT_SEP   4 /**< Go to next parameter */
+#define LB_DEC_ACT_PRIV  5 /**< Mark the sequence as private (ignored) */
+#define LB_DEC_ACT_CSI   6 /**< Dispatch a CSI sequence */
+#define LB_DEC_ACT_SS3   7 /**< Dispatch a SS3 sequence */
+#define LB_DEC_ACT_META  8 /**< Dispatch an ESC prefixed key (Alt + key) */
+
+#define LB_DEC_PARAM_MAX 9999 /**< Parameters saturate to this value */
+
+#define LB_DEC_ENTRY(state, action) (((state) << 4) | (LB_DEC_ACT_##action))
+#define LB_DEC_TO_GROUND(action)    LB_DEC_ENTRY(LB_DEC_GROUND, action)
+#define LB_DEC_TO_ESC(action)       LB_DEC_ENTRY(LB_DEC_ESC, action)
+#define LB_DEC_TO_CSI(action)       LB_DEC_ENTRY(LB_DEC_CSI, action)
+#define LB_DEC_TO_SS3(action)       LB_DEC_ENTRY(LB_DEC_SS3, action)
+
+/**
+ * Transition table of the input decoder: [state][class] -> (next state << 4) | action
+ * Columns: CTRL, ESC, INTER, DIGIT, SEP, PRIV, CSI, SS3, FINAL, DEL, HIGH
+ */
+static const uint8_t lbDecTable[LB_DEC_STATE_COUNT][LB_DEC_CLASS_COUNT] = {
+	[LB_DEC_GROUND] = { LB_DEC_TO_GROUND(KEY), LB_DEC_TO_ESC(CLEAR), LB_DEC_TO_GROUND(KEY), LB_DEC_TO_GROUND(KEY), LB_DEC_TO_GROUND(KEY), LB_DEC_TO_GROUND(KEY), LB_DEC_TO_GROUND(KEY), LB_DEC_TO_GROUND(KEY), LB_DEC_TO_GROUND(KEY), LB_DEC_TO_GROUND(KEY), LB_DEC_TO_GROUND(KEY) },
+	[LB_DEC_ESC] = { LB_DEC_TO_GROUND(KEY), LB_DEC_TO_ESC(CLEAR), LB_DEC_TO_GROUND(NONE), LB_DEC_TO_GROUND(META), LB_DEC_TO_GROUND(META), LB_DEC_TO_GROUND(META), LB_DEC_TO_CSI(NONE), LB_DEC_TO_SS3(NONE), LB_DEC_TO_GROUND(META), LB_DEC_TO_GROUND(META), LB_DEC_TO_GROUND(NONE) },
+	[LB_DEC_CSI] = { LB_DEC_TO_CSI(NONE), LB_DEC_TO_ESC(CLEAR), LB_DEC_TO_CSI(NONE), LB_DEC_TO_CSI(PARAM), LB_DEC_TO_CSI(SEP), LB_DEC_TO_CSI(PRIV), LB_DEC_TO_GROUND(CSI), LB_DEC_TO_GROUND(CSI), LB_DEC_TO_GROUND(CSI), LB_DEC_TO_CSI(NONE), LB_DEC_TO_GROUND(NONE) },
+	[LB_DEC_SS3] = { LB_DEC_TO_SS3(NONE), LB_DEC_TO_ESC(CLEAR), LB_DEC_TO_SS3(NONE), LB_DEC_TO_SS3(PARAM), LB_DEC_TO_SS3(SEP), LB_DEC_TO_GROUND(NONE), LB_DEC_TO_GROUND(SS3), LB_DEC_TO_GROUND(SS3), LB_DEC_TO_GROUND(SS3), LB_DEC_TO_SS3(NONE), LB_DEC_TO_GROUND(NONE) },
+};
+
 // Global variables
-typedef struct {
-	char lineBufferTable[LB_HISTORY_COUNT][LB_LINE_BUFFER_LENGTH]; /**< Buffer to store the state of the line */
-
-	uint8_t historyIndex;   /**< The current lineBuffer index under edition, history will be saved here after processing */
-	uint8_t explorerIndex;  /**< Index controlled by user when explorating history */
-	char *  curLineBuffer;  /**< The line currently under edition by user */
-	uint8_t lineSize;       /**< Size of the line (without ending '\0') */
-	char *  pCurPos;        /**< Current position of the cursor */
-	uint8_t escPos : 2;     /**< Current position in the ainsi escaped sequence [0;2] */
-	uint8_t isEscaping : 1; /**< Tell if next bytes will be managed as escaped command */
-	uint8_t isExiting : 1;  /**< Tell if module is in exiting mode */
-
-	lb_line_callback_t         lineCallback;     /**< Function called when user valid a line */
-	lb_autocomplete_callback_t autoCompCallback; /**< Function called when user request an autocompletion */
-} lb_handle_t;
-lb_handle_t lbHandle;
+lb_handle_t                    lbDefaultHandle;             /**< Handle used when none is selected */
+CLI_THREAD_LOCAL lb_handle_t * lbHandle = &lbDefaultHandle; /**< Selected handle, one per thread serving sessions */
 
 // ===================
 //      TOOLS
@@ -36,13 +75,14 @@ lb_handle_t lbHandle;
  */
 static uint8_t lb_loop_index_operation(uint8_t index, int8_t add, int maxRange)
 {
-	index += add;
-	if (index < 0) {
-		return index + maxRange;
-	} else if (index >= maxRange) {
-		return index - maxRange;
+	int result = index + add; // Signed to detect underflow
+
+	if (result < 0) {
+		return result + maxRange;
+	} else if (result >= maxRange) {
+		return result - maxRange;
 	} else {
-		return index;
+		return result;
 	}
 }
 
@@ -57,12 +97,12 @@ static uint8_t lb_loop_index_operation(uint8_t index, int8_t add, int maxRange)
  */
 static void lb_insert_at_cursor(char toInsert)
 {
-	char * pBuffer = lbHandle.pCurPos;
+	char * pBuffer = lbHandle->pCurPos;
 	char * pEnd;
 	char   backup;
 
 	// Check size before inserting
-	if ((lbHandle.lineSize + 1) >= LB_LINE_BUFFER_LENGTH) {
+	if ((lbHandle->lineSize + 1) >= LB_LINE_BUFFER_LENGTH) {
 		DEBUG_BLOC(ERROR)
 		{
 			CLI_PRINTF("\n\r");
@@ -72,8 +112,8 @@ static void lb_insert_at_cursor(char toInsert)
 	}
 
 	// Define the new ending line
-	++lbHandle.lineSize;
-	pEnd = &lbHandle.curLineBuffer[lbHandle.lineSize];
+	++lbHandle->lineSize;
+	pEnd = &lbHandle->curLineBuffer[lbHandle->lineSize];
 
 	// Slide characters
 	while (pBuffer <= pEnd) {
@@ -84,7 +124,7 @@ static void lb_insert_at_cursor(char toInsert)
 	}
 
 	// Slide cursor position
-	++lbHandle.pCurPos;
+	++lbHandle->pCurPos;
 }
 
 /**
@@ -97,19 +137,19 @@ static void lb_remove_at_cursor(void)
 	char * pEnd;
 
 	// Check size before removing
-	if (((int) lbHandle.lineSize - 1) < 0) {
+	if (((int) lbHandle->lineSize - 1) < 0) {
 		return;
 	}
 
 	// Can't remove char if positionned at first char
-	if (lbHandle.pCurPos <= lbHandle.curLineBuffer) {
+	if (lbHandle->pCurPos <= lbHandle->curLineBuffer) {
 		return;
 	}
 
-	--lbHandle.pCurPos;
-	pBuffer = lbHandle.pCurPos;
-	pEnd    = lbHandle.curLineBuffer + lbHandle.lineSize;
-	--lbHandle.lineSize;
+	--lbHandle->pCurPos;
+	pBuffer = lbHandle->pCurPos;
+	pEnd    = lbHandle->curLineBuffer + lbHandle->lineSize;
+	--lbHandle->lineSize;
 
 	// Slide characters
 	while (pBuffer <= pEnd) {
@@ -118,6 +158,66 @@ static void lb_remove_at_cursor(void)
 	}
 }
 
+/**
+ * @brief Remove the characters in [start; end[ and put the cursor at start
+ *
+ * @param start Position of the first character to remove
+ * @param end Position after the last character to remove
+ */
+static void lb_kill_range(uint8_t start, uint8_t end)
+{
+	char * pStart = lbHandle->curLineBuffer + start;
+
+	if (end <= start) {
+		return;
+	}
+
+	// Slide the end of the line (with ending '\0')
+	memmove(pStart, lbHandle->curLineBuffer + end, lbHandle->lineSize - end + 1);
+	lbHandle->lineSize -= end - start;
+	lbHandle->pCurPos = pStart;
+}
+
+/**
+ * @brief Find the begin of the word before a position
+ * @details Words are separated by spaces
+ *
+ * @param pos Position to start from
+ * @return Position of the begin of the word
+ */
+static uint8_t lb_find_word_left(uint8_t pos)
+{
+	const char * line = lbHandle->curLineBuffer;
+
+	while ((pos > 0) && (line[pos - 1] == ' ')) {
+		--pos;
+	}
+	while ((pos > 0) && (line[pos - 1] != ' ')) {
+		--pos;
+	}
+	return pos;
+}
+
+/**
+ * @brief Find the end of the word after a position
+ * @details Words are separated by spaces
+ *
+ * @param pos Position to start from
+ * @return Position after the end of the word
+ */
+static uint8_t lb_find_word_right(uint8_t pos)
+{
+	const char * line = lbHandle->curLineBuffer;
+
+	while ((pos < lbHandle->lineSize) && (line[pos] == ' ')) {
+		++pos;
+	}
+	while ((pos < lbHandle->lineSize) && (line[pos] != ' ')) {
+		++pos;
+	}
+	return pos;
+}
+
 /**
  * @brief Copy an historic line to the current line buffer
  *
@@ -127,8 +227,8 @@ static void lb_remove_at_cursor(void)
 static int lb_use_history(void)
 {
 	// Shortcuts
-	uint8_t index       = lbHandle.explorerIndex;
-	char *  historyLine = lbHandle.lineBufferTable[index];
+	uint8_t index       = lbHandle->explorerIndex;
+	char *  historyLine = lbHandle->lineBufferTable[index];
 
 	// Is the pointed history line empty ?
 	if (historyLine[0] == '\0') {
@@ -136,84 +236,177 @@ static int lb_use_history(void)
 	}
 
 	// Copy content
-	if (lbHandle.curLineBuffer == historyLine) {
+	if (lbHandle->curLineBuffer == historyLine) {
 		// We came back to curLine, empty the line buffer
-		lbHandle.curLineBuffer[0] = '\0';
+		lbHandle->curLineBuffer[0] = '\0';
 	} else {
 		// Copy history to curLine
-		strncpy(lbHandle.curLineBuffer, historyLine, LB_LINE_BUFFER_LENGTH);
+		strncpy(lbHandle->curLineBuffer, historyLine, LB_LINE_BUFFER_LENGTH);
 	}
 
 	// Update positions
-	lbHandle.lineSize = strlen(lbHandle.curLineBuffer);
-	lbHandle.pCurPos  = lbHandle.curLineBuffer + lbHandle.lineSize;
+	lbHandle->lineSize = strlen(lbHandle->curLineBuffer);
+	lbHandle->pCurPos  = lbHandle->curLineBuffer + lbHandle->lineSize;
 	return 0;
 }
 
 /**
- * @brief Execute the actions assciated to escaped codes
+ * @brief Give the class of a byte for the input decoder
  *
- * @param byte The escaped code
- * @return 0: OK, -1: unsupported code
+ * @param byte The incomming byte
+ * @return LB_DEC_CLASS_*
  */
-static int lb_exec_escaped_code(uint8_t byte)
+static uint8_t lb_dec_class(uint8_t byte)
 {
-	int tmp;
+	if (byte >= 0x80) {
+		return LB_DEC_CLASS_HIGH;
+	} else if (byte == LB_KEY_ESC) {
+		return LB_DEC_CLASS_ESC;
+	} else if (byte < 0x20) {
+		return LB_DEC_CLASS_CTRL;
+	} else if (byte < 0x30) {
+		return LB_DEC_CLASS_INTER;
+	} else if (byte <= '9') {
+		return LB_DEC_CLASS_DIGIT;
+	} else if (byte <= ';') {
+		return LB_DEC_CLASS_SEP;
+	} else if (byte < 0x40) {
+		return LB_DEC_CLASS_PRIV;
+	} else if (byte == LB_KEY_OPEN_BRACKET) {
+		return LB_DEC_CLASS_CSI;
+	} else if (byte == LB_KEY_SS3) {
+		return LB_DEC_CLASS_SS3;
+	} else if (byte < 0x7F) {
+		return LB_DEC_CLASS_FINAL;
+	} else {
+		return LB_DEC_CLASS_DEL;
+	}
+}
 
-	switch (byte) {
+/**
+ * @brief Translate the final byte of a CSI or SS3 sequence into a key
+ *
+ * @param final The final byte of the sequence
+ * @return LB_KEY_*
+ */
+static uint16_t lb_dec_dispatch(uint8_t final)
+{
+	lb_decoder_t * dec = &lbHandle->decoder;
+	bool           isWordMotion;
+
+	// xterm gives modifiers as 2nd parameter (1 + bitmask): ESC [ 1 ; 5 C
+	isWordMotion = (dec->params[1] > 1) && (((dec->params[1] - 1) & (LB_MOD_ALT | LB_MOD_CTRL)) != 0);
+
+	switch (final) {
 	case LB_CODE_ARROW_UP:
+		return LB_KEY_UP;
 	case LB_CODE_ARROW_DOWN:
-		// Decide if we go up (-1) or down (+1) in history
-		tmp                    = (byte == LB_CODE_ARROW_UP) ? -1 : +1;
-		lbHandle.explorerIndex = lb_loop_index_operation(lbHandle.explorerIndex, tmp, LB_HISTORY_COUNT);
-		if (lb_use_history() == -1) {
-			// If nothing to see there (empty strings), come back to previous value as if nothing happened
-			lbHandle.explorerIndex = lb_loop_index_operation(lbHandle.explorerIndex, -tmp, LB_HISTORY_COUNT);
-		}
-		break;
+		return LB_KEY_DOWN;
 	case LB_CODE_ARROW_RIGHT:
-		// Increment cursor
-		tmp = lbHandle.pCurPos - lbHandle.curLineBuffer;
-		if (tmp <= (lbHandle.lineSize - 1)) {
-			++lbHandle.pCurPos;
-		}
-		break;
+		return isWordMotion ? LB_KEY_WORD_RIGHT : LB_KEY_RIGHT;
 	case LB_CODE_ARROW_LEFT:
-		// Decrement cursor
-		if (lbHandle.pCurPos > lbHandle.curLineBuffer) {
-			--lbHandle.pCurPos;
+		return isWordMotion ? LB_KEY_WORD_LEFT : LB_KEY_LEFT;
+	case LB_CODE_HOME:
+		return LB_KEY_HOME;
+	case LB_CODE_END:
+		return LB_KEY_END;
+	case LB_CODE_VT_KEY:
+		// VT220 editing keys: ESC [ n ~
+		switch (dec->params[0]) {
+		case LB_VT_HOME:
+		case LB_VT_HOME_RXVT:
+			return LB_KEY_HOME;
+		case LB_VT_END:
+		case LB_VT_END_RXVT:
+			return LB_KEY_END;
+		case LB_VT_DELETE:
+			return LB_KEY_DELETE;
+		default:
+			break;
 		}
 		break;
 	default:
-		DPRINTF(ERROR, "Unsupported escape code : 0x%02X\n\r", byte);
-		return -1;
+		break;
 	}
-	return 0;
+
+	DPRINTF(ERROR, "Unsupported escape code : 0x%02X (%u;%u)\n\r", final, dec->params[0], dec->params[1]);
+	return LB_KEY_NONE;
 }
 
 /**
- * @brief Handle the escaped codes with a simple state machine
+ * @brief Translate an ESC prefixed byte (Alt + key) into a key
  *
- * @param byte The incomming new character
- * @return [description]
+ * @param byte The byte following ESC
+ * @return LB_KEY_*
  */
-static void lb_handle_escaped(uint8_t byte)
+static uint16_t lb_dec_meta(uint8_t byte)
 {
-	++lbHandle.escPos;
+	switch (byte) {
+	case 'b':
+		return LB_KEY_WORD_LEFT;
+	case 'f':
+		return LB_KEY_WORD_RIGHT;
+	case LB_KEY_BACKSPACE_2:
+		return LB_KEY_CTRL_W;
+	default:
+		return LB_KEY_NONE;
+	}
+}
 
-	// Check '['
-	if (lbHandle.escPos == 1) {
-		// If 2nd character is ok, wait for the next one
-		if (byte == LB_KEY_OPEN_BRACKET) {
-			return;
+/**
+ * @brief Feed the input decoder with one byte
+ * @details Table driven VT/xterm decoder: constant time per byte
+ * and no allocation. Unknown sequences are swallowed.
+ *
+ * @param byte The incomming byte
+ * @return The byte itself, a decoded key LB_KEY_* (> 0xFF)
+ * or LB_KEY_NONE if there is nothing to do yet
+ */
+static uint16_t lb_decode(uint8_t byte)
+{
+	lb_decoder_t * dec   = &lbHandle->decoder;
+	uint8_t        entry = lbDecTable[dec->state][lb_dec_class(byte)];
+	uint16_t *     param;
+
+	dec->state = entry >> 4;
+
+	switch (entry & 0x0F) {
+	case LB_DEC_ACT_KEY:
+		return byte;
+	case LB_DEC_ACT_CLEAR:
+		memset(dec->params, 0, sizeof(dec->params));
+		dec->paramIndex = 0;
+		dec->isPrivate  = false;
+		break;
+	case LB_DEC_ACT_PARAM:
+		if (dec->paramIndex < LB_DEC_MAX_PARAMS) {
+			param  = &dec->params[dec->paramIndex];
+			*param = (*param * 10) + (byte - '0');
+			if (*param > LB_DEC_PARAM_MAX) {
+				*param = LB_DEC_PARAM_MAX;
+			}
 		}
-	} else if (lbHandle.escPos == 2) {
-		lb_exec_escaped_code(byte);
+		break;
+	case LB_DEC_ACT_SEP:
+		if (dec->paramIndex < LB_DEC_MAX_PARAMS) {
+			++dec->paramIndex;
+		}
+		break;
+	case LB_DEC_ACT_PRIV:
+		dec->isPrivate = true;
+		break;
+	case LB_DEC_ACT_CSI:
+	case LB_DEC_ACT_SS3:
+		if (!dec->isPrivate) {
+			return lb_dec_dispatch(byte);
+		}
+		break;
+	case LB_DEC_ACT_META:
+		return lb_dec_meta(byte);
+	default:
+		break;
 	}
-
-	// Reset escape handler
-	lbHandle.isEscaping = false;
-	lbHandle.escPos     = 0;
+	return LB_KEY_NONE;
 }
 
 /**
@@ -226,32 +419,39 @@ static int lb_cmp_curline_prevline()
 	char *  curLine;
 	uint8_t index;
 
-	index = lb_loop_index_operation(lbHandle.historyIndex, -1, LB_HISTORY_COUNT);
+	index = lb_loop_index_operation(lbHandle->historyIndex, -1, LB_HISTORY_COUNT);
 
-	prevLine = lbHandle.lineBufferTable[index];
-	curLine  = lbHandle.curLineBuffer;
+	prevLine = lbHandle->lineBufferTable[index];
+	curLine  = lbHandle->curLineBuffer;
 
 	return strncmp(prevLine, curLine, LB_LINE_BUFFER_LENGTH);
 }
 
 /**
  * @brief Save current line and go to the next one (the older)
+ *
+ * @param persist Tell if the line should be given to the history write callback
  * @return 0
  */
-static int lb_save_to_history(void)
+static int lb_save_to_history(bool persist)
 {
 	// Do not save empty lines and duplicates
-	if ((lbHandle.lineSize > 0) && (lb_cmp_curline_prevline() != 0)) {
+	if ((lbHandle->lineSize > 0) && (lb_cmp_curline_prevline() != 0)) {
+		// Give the accepted line to the persistence backend
+		if (persist && (lbHandle->historyWriteCallback != NULL)) {
+			lbHandle->historyWriteCallback(lbHandle->curLineBuffer, lbHandle->lineSize);
+		}
+
 		// Go to next lineBuffer
-		lbHandle.historyIndex  = lb_loop_index_operation(lbHandle.historyIndex, +1, LB_HISTORY_COUNT);
-		lbHandle.curLineBuffer = lbHandle.lineBufferTable[lbHandle.historyIndex];
+		lbHandle->historyIndex  = lb_loop_index_operation(lbHandle->historyIndex, +1, LB_HISTORY_COUNT);
+		lbHandle->curLineBuffer = lbHandle->lineBufferTable[lbHandle->historyIndex];
 	}
 
 	// Reset positions
-	lbHandle.pCurPos = lbHandle.curLineBuffer;
-	memset(lbHandle.curLineBuffer, 0, LB_LINE_BUFFER_LENGTH);
-	lbHandle.explorerIndex = lbHandle.historyIndex;
-	lbHandle.lineSize      = 0;
+	lbHandle->pCurPos = lbHandle->curLineBuffer;
+	memset(lbHandle->curLineBuffer, 0, LB_LINE_BUFFER_LENGTH);
+	lbHandle->explorerIndex = lbHandle->historyIndex;
+	lbHandle->lineSize      = 0;
 	return 0;
 }
 
@@ -261,7 +461,7 @@ static int lb_save_to_history(void)
  */
 static int lb_get_cursor_pos(void)
 {
-	int curPos = lbHandle.pCurPos - lbHandle.curLineBuffer;
+	int curPos = lbHandle->pCurPos - lbHandle->curLineBuffer;
 	return (int) curPos;
 }
 
@@ -275,27 +475,27 @@ static void lb_auto_complete(void)
 	uint8_t  count;
 	char *   appendBuffer;
 
-	if (lbHandle.autoCompCallback == NULL) {
+	if (lbHandle->autoCompCallback == NULL) {
 		return;
 	}
 
 	// Prevent autocompletion if cursor is not at the end of the line
-	if (lb_get_cursor_pos() != lbHandle.lineSize) {
+	if (lb_get_cursor_pos() != lbHandle->lineSize) {
 		return;
 	}
 
 	// Do autocompletion
-	appendBuffer = lbHandle.pCurPos;
-	remainLen    = LB_LINE_BUFFER_LENGTH - lbHandle.lineSize;
-	count        = lbHandle.autoCompCallback(lbHandle.curLineBuffer, lbHandle.lineSize, appendBuffer, remainLen);
+	appendBuffer = lbHandle->pCurPos;
+	remainLen    = LB_LINE_BUFFER_LENGTH - lbHandle->lineSize;
+	count        = lbHandle->autoCompCallback(lbHandle->curLineBuffer, lbHandle->lineSize, appendBuffer, remainLen);
 
 	// Update position and counters if valid
 	if ((count > 0) && (count <= remainLen)) {
-		lbHandle.lineSize += count;
-		lbHandle.pCurPos += count;
+		lbHandle->lineSize += count;
+		lbHandle->pCurPos += count;
 
 		// End the line to be sure
-		(*lbHandle.pCurPos) = '\0';
+		(*lbHandle->pCurPos) = '\0';
 	}
 }
 
@@ -309,12 +509,97 @@ static void lb_process_line(void)
 	CLI_PRINTF("\n\r");
 
 	// Execute the command
-	if (lbHandle.lineCallback != NULL) {
-		lbHandle.lineCallback(lbHandle.curLineBuffer, lbHandle.lineSize);
+	if (lbHandle->lineCallback != NULL) {
+		lbHandle->lineCallback(lbHandle->curLineBuffer, lbHandle->lineSize);
 	}
 
 	// Save the command into history
-	lb_save_to_history();
+	lb_save_to_history(true);
+}
+
+/**
+ * @brief Execute the action associated to a key
+ *
+ * @param key A byte or a decoded key LB_KEY_*
+ * @return 0: line must be redrawn, -1: Nothing done
+ */
+static int lb_exec_key(uint16_t key)
+{
+	int tmp;
+	int curPos = lb_get_cursor_pos();
+
+	switch (key) {
+	case LB_KEY_UP:
+	case LB_KEY_DOWN:
+		// Decide if we go up (-1) or down (+1) in history
+		tmp                    = (key == LB_KEY_UP) ? -1 : +1;
+		lbHandle->explorerIndex = lb_loop_index_operation(lbHandle->explorerIndex, tmp, LB_HISTORY_COUNT);
+		if (lb_use_history() == -1) {
+			// If nothing to see there (empty strings), come back to previous value as if nothing happened
+			lbHandle->explorerIndex = lb_loop_index_operation(lbHandle->explorerIndex, -tmp, LB_HISTORY_COUNT);
+			return -1;
+		}
+		break;
+	case LB_KEY_RIGHT:
+		if (curPos >= lbHandle->lineSize) {
+			return -1;
+		}
+		++lbHandle->pCurPos;
+		break;
+	case LB_KEY_LEFT:
+		if (curPos <= 0) {
+			return -1;
+		}
+		--lbHandle->pCurPos;
+		break;
+	case LB_KEY_HOME:
+	case LB_KEY_CTRL_A:
+		lbHandle->pCurPos = lbHandle->curLineBuffer;
+		break;
+	case LB_KEY_END:
+	case LB_KEY_CTRL_E:
+		lbHandle->pCurPos = lbHandle->curLineBuffer + lbHandle->lineSize;
+		break;
+	case LB_KEY_WORD_LEFT:
+		lbHandle->pCurPos = lbHandle->curLineBuffer + lb_find_word_left(curPos);
+		break;
+	case LB_KEY_WORD_RIGHT:
+		lbHandle->pCurPos = lbHandle->curLineBuffer + lb_find_word_right(curPos);
+		break;
+	case LB_KEY_DELETE:
+		if (curPos >= lbHandle->lineSize) {
+			return -1;
+		}
+		lb_kill_range(curPos, curPos + 1);
+		break;
+	case LB_KEY_CTRL_W:
+		lb_kill_range(lb_find_word_left(curPos), curPos);
+		break;
+	case LB_KEY_CTRL_U:
+		lb_kill_range(0, curPos);
+		break;
+	case LB_KEY_CTRL_K:
+		lb_kill_range(curPos, lbHandle->lineSize);
+		break;
+	case LB_KEY_TAB:
+		lb_auto_complete();
+		break;
+	case LB_KEY_ENTER_UNIX:
+		lb_process_line();
+		break;
+	case LB_KEY_BACKSPACE_1:
+	case LB_KEY_BACKSPACE_2:
+		lb_remove_at_cursor();
+		break;
+	default:
+		// Other control characters are not inserted
+		if ((key < 0x20) || (key > 0xFF)) {
+			return -1;
+		}
+		lb_insert_at_cursor((char) key);
+		break;
+	}
+	return 0;
 }
 
 /**
@@ -323,17 +608,19 @@ static void lb_process_line(void)
 static void lb_term_update(void)
 {
 	// Do not display prompt on exit
-	if (lbHandle.isExiting) {
+	if (lbHandle->isExiting || lbHandle->isSilent) {
 		return;
 	}
 
+	CLI_TRACE(REDRAW, CLI_TRACE_NO_TOKEN, lb_get_cursor_pos());
+
 	// [%dD set cursor pos
 	CLI_PRINTF("\x1B[1000D" // Set cursor to begin line
 			   "\x1B[K"     // Kill line
-			   "> %s"       // Print prompt and line
+			   "%s%s"       // Print prompt and line
 			   "\x1B[1000D" // Set cursor to begin line
 			   "\x1B[%dC",  // Set cursor to actual position
-			   lbHandle.curLineBuffer, 2 + lb_get_cursor_pos());
+			   lbHandle->prompt, lbHandle->curLineBuffer, (int) strlen(lbHandle->prompt) + lb_get_cursor_pos());
 }
 
 // ===================
@@ -349,14 +636,27 @@ void lb_init(void)
 	//DEBUG_ENABLE(INFO);
 
 	// Init handle
-	memset(&lbHandle, 0, sizeof(lbHandle));
-	lbHandle.curLineBuffer = lbHandle.lineBufferTable[0];
-	lbHandle.pCurPos       = lbHandle.curLineBuffer;
+	memset(lbHandle, 0, sizeof(*lbHandle));
+	lbHandle->curLineBuffer = lbHandle->lineBufferTable[0];
+	lbHandle->pCurPos       = lbHandle->curLineBuffer;
+	strcpy(lbHandle->prompt, LB_DEFAULT_PROMPT);
 
 	// Display prompt on init
 	lb_term_update();
 }
 
+/**
+ * @brief Select the handle used by all other functions
+ * @details Each terminal (serial port, network connection, ...) has
+ * its own handle. A handle must be initialized with lb_init() once selected.
+ *
+ * @param handle Pointer, NULL to select the default handle
+ */
+void lb_select_handle(lb_handle_t * handle)
+{
+	lbHandle = (handle != NULL) ? handle : &lbDefaultHandle;
+}
+
 /**
  * @brief Define the function callback to call when user hit enter
  *
@@ -364,7 +664,7 @@ void lb_init(void)
  */
 void lb_set_valid_line_callback(lb_line_callback_t callback)
 {
-	lbHandle.lineCallback = callback;
+	lbHandle->lineCallback = callback;
 }
 
 /**
@@ -374,7 +674,41 @@ void lb_set_valid_line_callback(lb_line_callback_t callback)
  */
 void lb_set_autocomplete_callback(lb_autocomplete_callback_t callback)
 {
-	lbHandle.autoCompCallback = callback;
+	lbHandle->autoCompCallback = callback;
+}
+
+/**
+ * @brief Define the function callback to call when a line is saved into history
+ * @details Used to persist history (file, flash sector, ...). The callback
+ * receives each accepted line once, without ending '\0'.
+ *
+ * @param callback Pointer on function, can be NULL to remove callback
+ */
+void lb_set_history_write_callback(lb_history_write_callback_t callback)
+{
+	lbHandle->historyWriteCallback = callback;
+}
+
+/**
+ * @brief Append a line to the history without executing it
+ * @details Used to reload a persisted history at startup, oldest line first.
+ * The line being edited is lost. The history write callback is not called.
+ *
+ * @param str The line to push (does not need to be '\0' terminated)
+ * @param len The length of str, truncated to LB_LINE_BUFFER_LENGTH - 1
+ * @return 0
+ */
+int lb_history_push(const char * str, uint16_t len)
+{
+	if (len >= LB_LINE_BUFFER_LENGTH) {
+		len = LB_LINE_BUFFER_LENGTH - 1;
+	}
+
+	memcpy(lbHandle->curLineBuffer, str, len);
+	lbHandle->curLineBuffer[len] = '\0';
+	lbHandle->lineSize           = len;
+
+	return lb_save_to_history(false);
 }
 
 /**
@@ -384,27 +718,74 @@ void lb_set_autocomplete_callback(lb_autocomplete_callback_t callback)
  */
 void lb_rx(uint8_t byte)
 {
+	uint16_t key;
+
 	//DPRINTF(INFO, "rx: %c (0x%02X)\n\r", byte, byte);
-	if (lbHandle.isExiting) {
+	if (lbHandle->isExiting) {
+		return;
+	}
+
+	// Only redraw once a key is complete and did something
+	key = lb_decode(byte);
+	if ((key == LB_KEY_NONE) || (lb_exec_key(key) != 0)) {
 		return;
-	} else if (lbHandle.isEscaping) {
-		lb_handle_escaped(byte);
-	} else if (byte == LB_KEY_ESC) {
-		lbHandle.isEscaping = true;
-	} else if (byte == LB_KEY_TAB) {
-		lb_auto_complete();
-	} else if (byte == LB_KEY_ENTER_WIN) {
-		// Ignore this
-	} else if (byte == LB_KEY_ENTER_UNIX) {
-		lb_process_line();
-	} else if ((byte == LB_KEY_BACKSPACE_1) || (byte == LB_KEY_BACKSPACE_2)) {
-		lb_remove_at_cursor();
-	} else {
-		lb_insert_at_cursor((char) byte);
 	}
 	lb_term_update();
 }
 
+/**
+ * @brief Enable or disable the display of the prompt and line
+ * @details Used when the terminal is not a human (automation)
+ *
+ * @param isSilent boolean
+ */
+void lb_set_silent(bool isSilent)
+{
+	lbHandle->isSilent = isSilent;
+}
+
+/**
+ * @brief Change the text written before the line
+ * @details It is displayed at the next refresh
+ *
+ * @param prompt Text (Truncated to LB_PROMPT_LENGTH - 1), NULL for LB_DEFAULT_PROMPT
+ */
+void lb_set_prompt(const char * prompt)
+{
+	if (prompt == NULL) {
+		prompt = LB_DEFAULT_PROMPT;
+	}
+	strncpy(lbHandle->prompt, prompt, sizeof(lbHandle->prompt) - 1);
+	lbHandle->prompt[sizeof(lbHandle->prompt) - 1] = '\0';
+}
+
+/**
+ * @brief Give the number of bytes used by the lines of history
+ * @details Includes the line being edited and the '\0' of each line
+ *
+ * @return Number of bytes, at most LB_HISTORY_COUNT * LB_LINE_BUFFER_LENGTH
+ */
+uint16_t lb_get_history_size(void)
+{
+	uint16_t size = 0;
+
+	for (uint8_t i = 0; i < LB_HISTORY_COUNT; ++i) {
+		if (lbHandle->lineBufferTable[i][0] != '\0') {
+			size += strlen(lbHandle->lineBufferTable[i]) + 1;
+		}
+	}
+	return size;
+}
+
+/**
+ * @brief Display the prompt and line again
+ * @details Used after something else was written on the terminal
+ */
+void lb_refresh(void)
+{
+	lb_term_update();
+}
+
 /**
  * @brief Put LineBuffer in exit mode
  * @details No more character will be accepted and
@@ -412,5 +793,14 @@ void lb_rx(uint8_t byte)
  */
 void lb_exit(void)
 {
-	lbHandle.isExiting = true;
+	lbHandle->isExiting = true;
+}
+
+/**
+ * @brief Tell if LineBuffer is in exit mode
+ * @return boolean
+ */
+bool lb_is_exiting(void)
+{
+	return lbHandle->isExiting;
 }
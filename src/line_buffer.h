@@ -16,17 +16,54 @@
 // Constants
 // ======================
 
+#define LB_KEY_CTRL_A       0x01 // Move cursor to begin of line
+#define LB_KEY_CTRL_E       0x05 // Move cursor to end of line
 #define LB_KEY_BACKSPACE_1  0x08 // For serial
-#define LB_KEY_BACKSPACE_2  0x7F // For MacOS
 #define LB_KEY_TAB          0x09
 #define LB_KEY_ENTER_UNIX   0x0A
+#define LB_KEY_CTRL_K       0x0B // Kill from cursor to end of line
 #define LB_KEY_ENTER_WIN    0x0D
+#define LB_KEY_CTRL_U       0x15 // Kill from begin of line to cursor
+#define LB_KEY_CTRL_W       0x17 // Kill the word before cursor
 #define LB_KEY_ESC          0x1B
+#define LB_KEY_SS3          0x4F // 'O'
 #define LB_KEY_OPEN_BRACKET 0x5B // '['
+#define LB_KEY_BACKSPACE_2  0x7F // For MacOS
 #define LB_CODE_ARROW_UP    0x41 // 'A'
 #define LB_CODE_ARROW_DOWN  0x42 // 'B'
 #define LB_CODE_ARROW_RIGHT 0x43 // 'C'
 #define LB_CODE_ARROW_LEFT  0x44 // 'D'
+#define LB_CODE_END         0x46 // 'F'
+#define LB_CODE_HOME        0x48 // 'H'
+#define LB_CODE_VT_KEY      0x7E // '~' ends VT220 keys: ESC [ n ~
+
+// VT220 key numbers (ESC [ n ~)
+#define LB_VT_HOME      1
+#define LB_VT_DELETE    3
+#define LB_VT_END       4
+#define LB_VT_HOME_RXVT 7
+#define LB_VT_END_RXVT  8
+
+// xterm modifier bits (parameter - 1)
+#define LB_MOD_SHIFT 0x01
+#define LB_MOD_ALT   0x02
+#define LB_MOD_CTRL  0x04
+
+// Keys given by the input decoder (outside of byte range)
+#define LB_KEY_NONE       0x0100 // Nothing to do (sequence in progress or unsupported)
+#define LB_KEY_UP         0x0101
+#define LB_KEY_DOWN       0x0102
+#define LB_KEY_RIGHT      0x0103
+#define LB_KEY_LEFT       0x0104
+#define LB_KEY_HOME       0x0105
+#define LB_KEY_END        0x0106
+#define LB_KEY_DELETE     0x0107
+#define LB_KEY_WORD_RIGHT 0x0108
+#define LB_KEY_WORD_LEFT  0x0109
+
+#define LB_DEC_MAX_PARAMS 2 /**< Number of CSI parameters kept by the input decoder, others are ignored */
+
+#define LB_DEFAULT_PROMPT "> " /**< Prompt until lb_set_prompt() */
 
 // ======================
 // Typedefs and structs
@@ -34,15 +71,55 @@
 
 typedef int (*lb_line_callback_t)(const char * str, uint16_t len);
 typedef uint8_t (*lb_autocomplete_callback_t)(const char * str, uint16_t len, char * outBuffer, uint16_t outBufferMaxLen);
+typedef int (*lb_history_write_callback_t)(const char * str, uint16_t len);
+
+/**
+ * State of the input decoder
+ */
+typedef struct {
+	uint8_t  state;                     /**< Current state LB_DEC_* */
+	uint8_t  paramIndex;                /**< Index of the parameter being read, LB_DEC_MAX_PARAMS if ignored */
+	uint8_t  isPrivate : 1;             /**< Tell if the sequence has a private marker */
+	uint16_t params[LB_DEC_MAX_PARAMS]; /**< Numeric parameters, 0 if omitted */
+} lb_decoder_t;
+
+/**
+ * State of a line buffer, one for each terminal
+ */
+typedef struct {
+	char lineBufferTable[LB_HISTORY_COUNT][LB_LINE_BUFFER_LENGTH]; /**< Buffer to store the state of the line */
+
+	uint8_t      historyIndex;             /**< The current lineBuffer index under edition, history will be saved here after processing */
+	uint8_t      explorerIndex;            /**< Index controlled by user when explorating history */
+	char *       curLineBuffer;            /**< The line currently under edition by user */
+	uint8_t      lineSize;                 /**< Size of the line (without ending '\0') */
+	char *       pCurPos;                  /**< Current position of the cursor */
+	lb_decoder_t decoder;                  /**< State of the input decoder */
+	uint8_t      isExiting : 1;            /**< Tell if module is in exiting mode */
+	uint8_t      isSilent : 1;             /**< Tell if the line is not displayed */
+	char         prompt[LB_PROMPT_LENGTH]; /**< Written before the line */
+
+	lb_line_callback_t          lineCallback;         /**< Function called when user valid a line */
+	lb_autocomplete_callback_t  autoCompCallback;     /**< Function called when user request an autocompletion */
+	lb_history_write_callback_t historyWriteCallback; /**< Function called when a line is saved into history */
+} lb_handle_t;
 
 // ======================
 // Protoypes
 // ======================
 
-void lb_init(void);
-void lb_set_valid_line_callback(lb_line_callback_t callback);
-void lb_set_autocomplete_callback(lb_autocomplete_callback_t callback);
-void lb_rx(uint8_t byte);
-void lb_exit(void);
+void     lb_init(void);
+void     lb_select_handle(lb_handle_t * handle);
+void     lb_set_valid_line_callback(lb_line_callback_t callback);
+void     lb_set_autocomplete_callback(lb_autocomplete_callback_t callback);
+void     lb_set_history_write_callback(lb_history_write_callback_t callback);
+int      lb_history_push(const char * str, uint16_t len);
+void     lb_rx(uint8_t byte);
+void     lb_set_silent(bool isSilent);
+void     lb_set_prompt(const char * prompt);
+uint16_t lb_get_history_size(void);
+void     lb_refresh(void);
+void     lb_exit(void);
+bool     lb_is_exiting(void);
 
 #endif /* LINE_BUFFER_H */
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cli.h"
+
+#if (CLI_CONCURRENT_READERS == 0)
+#error "stress_readers is built with CLI_CONCURRENT_READERS=1"
+#endif
+
+#define STRESS_READERS    4      /**< Number of threads serving a session */
+#define STRESS_ITERATIONS 100000 /**< Number of loops of each reader */
+
+atomic_int  stressIsDone;    /**< Tell the writer to stop */
+atomic_long stressFixedHits; /**< Calls of "fixed", the only command never removed */
+atomic_long stressPlugHits;  /**< Calls of "plug go", seen or not depending on the writer */
+
+/**
+ * @brief Callback of "fixed"
+ */
+static int fixed_cb(uint8_t argc, char * argv[])
+{
+	atomic_fetch_add(&stressFixedHits, 1);
+	return 0;
+}
+
+/**
+ * @brief Callback of "plug go"
+ */
+static int plug_cb(uint8_t argc, char * argv[])
+{
+	atomic_fetch_add(&stressPlugHits, 1);
+	return 0;
+}
+
+/**
+ * @brief Output of the sessions, dropped
+ * @see cli_output_callback_t
+ */
+static int discard_output(const char * str, uint16_t len)
+{
+	return len;
+}
+
+/**
+ * @brief Add and remove a subtree until the readers are done
+ *
+ * @param arg UNUSED
+ * @return Number of cycles
+ */
+static void * writer(void * arg)
+{
+	long cycleCount = 0;
+
+	while (atomic_load(&stressIsDone) == 0) {
+		cli_token * plug = cli_add_token("plug", "Plugin");
+		cli_token * go   = cli_add_token("go", "Run");
+
+		if ((plug == NULL) || (go == NULL)) {
+			// Retired tokens are freed once the readers left their epoch
+			if (plug != NULL) {
+				cli_remove_token(plug);
+			}
+			continue;
+		}
+		cli_set_callback(go, &plug_cb);
+		cli_add_children(plug, go);
+		cli_add_children(cli_get_root_token(), plug);
+		sched_yield(); // Let readers find it
+		cli_remove_token(plug);
+		++cycleCount;
+	}
+	return (void *) cycleCount;
+}
+
+/**
+ * @brief Execute, complete and request by ID from an own session
+ *
+ * @param arg UNUSED
+ * @return NULL
+ */
+static void * reader(void * arg)
+{
+	uint32_t    id         = cli_get_command_id("fixed");
+	uint8_t     request[8] = { 0xA5, 5, 0, id, id >> 8, id >> 16, id >> 24, 0 };
+	cli_session session;
+	char        completion[16];
+
+	// The selected session is thread local
+	cli_session_init(&session, &discard_output);
+	cli_session_select(&session);
+
+	for (long i = 0; i < STRESS_ITERATIONS; ++i) {
+		cli_execute_lb("fixed", 5);
+		cli_execute_lb("plug go", 7);
+		cli_autocomplete_lb("pl", 2, completion, sizeof(completion));
+
+		cli_set_mode(CLI_MODE_BINARY);
+		for (uint8_t j = 0; j < sizeof(request); ++j) {
+			cli_rx(request[j]);
+		}
+		cli_set_mode(CLI_MODE_HUMAN);
+	}
+	return NULL;
+}
+
+int main(void)
+{
+	pthread_t   writerThread;
+	pthread_t   readerThreads[STRESS_READERS];
+	void *      cycleCount;
+	cli_token * fixed;
+	long        expected = 2L * STRESS_READERS * STRESS_ITERATIONS;
+
+	cli_init();
+	fixed = cli_add_token("fixed", "Never removed");
+	cli_set_callback(fixed, &fixed_cb);
+	cli_add_children(cli_get_root_token(), fixed);
+
+	pthread_create(&writerThread, NULL, &writer, NULL);
+	for (int i = 0; i < STRESS_READERS; ++i) {
+		pthread_create(&readerThreads[i], NULL, &reader, NULL);
+	}
+	for (int i = 0; i < STRESS_READERS; ++i) {
+		pthread_join(readerThreads[i], NULL);
+	}
+	atomic_store(&stressIsDone, 1);
+	pthread_join(writerThread, &cycleCount);
+
+	printf("%d readers, %ld writer cycles, %ld calls of \"plug go\"\n", STRESS_READERS, (long) cycleCount, atomic_load(&stressPlugHits));
+	if (atomic_load(&stressFixedHits) != expected) {
+		printf("FAILED: %ld calls of \"fixed\", %ld expected\n", atomic_load(&stressFixedHits), expected);
+		return 1;
+	}
+	return 0;
+}
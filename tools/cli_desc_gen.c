@@ -0,0 +1,497 @@
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GEN_MAX_DESC      512   /**< Maximum number of descriptions */
+#define GEN_MAX_ID_LEN    48    /**< Maximum length of a description ID */
+#define GEN_MAX_TEXT_LEN  256   /**< Maximum length of a description */
+#define GEN_MAX_WORDS     2048  /**< Maximum number of different words candidate to the dictionary */
+#define GEN_MAX_WORD_LEN  32    /**< Maximum length of a word of the dictionary */
+#define GEN_DICT_SIZE     128   /**< Number of dictionary words, coded from 0x80 to 0xFF */
+#define GEN_DICT_FLAG     0x80  /**< Must match CLI_DESC_DICT_FLAG */
+#define GEN_MAX_BLOB_SIZE 65535 /**< Offsets are stored on 16 bits */
+#define GEN_IDS_FILE      "cli_desc_ids.h"
+#define GEN_BLOB_FILE     "cli_desc_blob.c"
+
+typedef struct {
+	char     id[GEN_MAX_ID_LEN];
+	char     text[GEN_MAX_TEXT_LEN];
+	uint16_t offset; /**< Index of the coded text in the blob */
+} gen_desc_t;
+
+typedef struct {
+	char     text[GEN_MAX_WORD_LEN];
+	uint16_t len;
+	uint32_t count; /**< Number of occurences in all descriptions */
+	int32_t  gain;  /**< Bytes saved if the word is in the dictionary */
+} gen_word_t;
+
+static gen_desc_t descs[GEN_MAX_DESC];
+static uint16_t   descCount = 0;
+static gen_word_t words[GEN_MAX_WORDS];
+static uint16_t   wordCount = 0;
+static uint16_t   dictCount = 0; /**< The dictionary is the GEN_DICT_SIZE first words once sorted */
+static uint8_t    blob[GEN_MAX_BLOB_SIZE];
+static uint32_t   blobLen = 0;
+
+/**
+ * @brief Read a whole file
+ *
+ * @param path Path of the file
+ * @return Allocated '\0' terminated content, NULL on error
+ */
+static char * read_file(const char * path)
+{
+	FILE * file = fopen(path, "rb");
+	char * content;
+	long   size;
+
+	if (file == NULL) {
+		return NULL;
+	}
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	content = malloc(size + 1);
+	if ((content != NULL) && (fread(content, 1, size, file) != (size_t) size)) {
+		free(content);
+		content = NULL;
+	}
+	if (content != NULL) {
+		content[size] = '\0';
+	}
+	fclose(file);
+	return content;
+}
+
+/**
+ * @brief Skip spaces and comments
+ *
+ * @param pos Position in the source
+ * @return Position of the next meaningful character
+ */
+static const char * skip_blank(const char * pos)
+{
+	while (*pos != '\0') {
+		if (isspace((unsigned char) *pos)) {
+			++pos;
+		} else if (strncmp(pos, "//", 2) == 0) {
+			pos += strcspn(pos, "\n");
+		} else if (strncmp(pos, "/*", 2) == 0) {
+			const char * end = strstr(pos + 2, "*/");
+			pos              = (end != NULL) ? end + 2 : pos + strlen(pos);
+		} else {
+			break;
+		}
+	}
+	return pos;
+}
+
+/**
+ * @brief Decode adjacent string literals ("abc" "def")
+ *
+ * @param pos Position of the first '"', updated after the last one
+ * @param out Decoded text
+ * @param maxLen Size of out
+ * @return 0: ok, -1: Error
+ */
+static int parse_string(const char ** pos, char * out, uint16_t maxLen)
+{
+	const char * cur = *pos;
+	uint16_t     len = 0;
+
+	while (*cur == '"') {
+		for (++cur; *cur != '"'; ++cur) {
+			char c = *cur;
+
+			if ((c == '\0') || (c == '\n')) {
+				return -1;
+			}
+			if (c == '\\') {
+				++cur;
+				switch (*cur) {
+				case 'n': c = '\n'; break;
+				case 'r': c = '\r'; break;
+				case 't': c = '\t'; break;
+				case '"': c = '"'; break;
+				case '\'': c = '\''; break;
+				case '\\': c = '\\'; break;
+				default: return -1; // Octal and hexadecimal escapes are not supported
+				}
+			}
+			if ((unsigned char) c >= GEN_DICT_FLAG) {
+				return -1; // Codes from GEN_DICT_FLAG are dictionary words
+			}
+			if (len >= (maxLen - 1)) {
+				return -1;
+			}
+			out[len++] = c;
+		}
+		cur = skip_blank(cur + 1);
+	}
+	out[len] = '\0';
+	*pos     = cur;
+	return 0;
+}
+
+/**
+ * @brief Add a description, an ID may be used several times with the same text
+ *
+ * @param id ID of the description
+ * @param text Text
+ * @return 0: ok, -1: Error
+ */
+static int add_desc(const char * id, const char * text)
+{
+	for (uint16_t i = 0; i < descCount; ++i) {
+		if (strcmp(descs[i].id, id) == 0) {
+			if (strcmp(descs[i].text, text) != 0) {
+				printf("Description \"%s\" is defined with different texts\n", id);
+				return -1;
+			}
+			return 0;
+		}
+	}
+	if (descCount >= GEN_MAX_DESC) {
+		printf("Too many descriptions (GEN_MAX_DESC = %d)\n", GEN_MAX_DESC);
+		return -1;
+	}
+	strcpy(descs[descCount].id, id);
+	strcpy(descs[descCount].text, text);
+	++descCount;
+	return 0;
+}
+
+/**
+ * @brief Find all CLI_DESC(id, "text") of a source file
+ *
+ * @param path Path of the file
+ * @return 0: ok, -1: Error
+ */
+static int parse_file(const char * path)
+{
+	char *       content = read_file(path);
+	const char * pos     = content;
+	int          ret     = 0;
+
+	if (content == NULL) {
+		printf("Unable to read \"%s\"\n", path);
+		return -1;
+	}
+
+	while ((ret == 0) && (*(pos = skip_blank(pos)) != '\0')) {
+		char         id[GEN_MAX_ID_LEN];
+		char         text[GEN_MAX_TEXT_LEN];
+		const char * idStart;
+		size_t       idLen;
+
+		if (*pos == '"') {
+			// Literals out of CLI_DESC() are skipped
+			if (parse_string(&pos, text, sizeof(text)) != 0) {
+				++pos;
+			}
+			continue;
+		}
+		if (*pos == '\'') {
+			pos += (pos[1] == '\\') ? 4 : 3;
+			continue;
+		}
+		if (!isalpha((unsigned char) *pos) && (*pos != '_')) {
+			++pos;
+			continue;
+		}
+
+		// Whole identifiers only (Not MY_CLI_DESC)
+		idStart = pos;
+		while (isalnum((unsigned char) *pos) || (*pos == '_')) {
+			++pos;
+		}
+		if (((pos - idStart) != 8) || (strncmp(idStart, "CLI_DESC", 8) != 0)) {
+			continue;
+		}
+
+		pos = skip_blank(pos);
+		if (*pos != '(') {
+			continue;
+		}
+		idStart = skip_blank(pos + 1);
+		for (pos = idStart; isalnum((unsigned char) *pos) || (*pos == '_'); ++pos) {
+		}
+		idLen = pos - idStart;
+		pos   = skip_blank(pos);
+		if ((idLen == 0) || (*pos != ',')) {
+			continue;
+		}
+		pos = skip_blank(pos + 1);
+		if (*pos != '"') {
+			continue; // Definition of the macro itself
+		}
+		if ((idLen >= sizeof(id)) || (parse_string(&pos, text, sizeof(text)) != 0) || (*pos != ')')) {
+			printf("%s: Invalid CLI_DESC() near \"%.*s\"\n", path, (int) idLen, idStart);
+			ret = -1;
+			break;
+		}
+		memcpy(id, idStart, idLen);
+		id[idLen] = '\0';
+		ret       = add_desc(id, text);
+	}
+
+	free(content);
+	return ret;
+}
+
+/**
+ * @brief Count a word candidate to the dictionary
+ *
+ * @param text Start of the word
+ * @param len Length of the word
+ */
+static void count_word(const char * text, uint16_t len)
+{
+	if ((len < 2) || (len >= GEN_MAX_WORD_LEN)) {
+		return;
+	}
+	for (uint16_t i = 0; i < wordCount; ++i) {
+		if ((words[i].len == len) && (strncmp(words[i].text, text, len) == 0)) {
+			++words[i].count;
+			return;
+		}
+	}
+	if (wordCount < GEN_MAX_WORDS) {
+		memcpy(words[wordCount].text, text, len);
+		words[wordCount].text[len] = '\0';
+		words[wordCount].len       = len;
+		words[wordCount].count     = 1;
+		++wordCount;
+	}
+}
+
+/**
+ * @brief Sort words by gain for qsort()
+ */
+static int cmp_word(const void * a, const void * b)
+{
+	return ((const gen_word_t *) b)->gain - ((const gen_word_t *) a)->gain;
+}
+
+/**
+ * @brief Choose the words of the dictionary
+ * @details Words are the runs of non space characters with the space before
+ * them. Each use replaces len bytes by 1 and each word costs its text, its
+ * '\0' and its offset.
+ */
+static void build_dict(void)
+{
+	for (uint16_t i = 0; i < descCount; ++i) {
+		const char * text = descs[i].text;
+		uint16_t     start;
+
+		for (uint16_t pos = 0; text[pos] != '\0';) {
+			start = pos;
+			if (text[pos] == ' ') {
+				++pos;
+			}
+			while ((text[pos] != '\0') && (text[pos] != ' ')) {
+				++pos;
+			}
+			count_word(text + start, pos - start);
+			if (pos == start) {
+				++pos;
+			}
+		}
+	}
+
+	for (uint16_t i = 0; i < wordCount; ++i) {
+		words[i].gain = (int32_t) words[i].count * (words[i].len - 1) - (words[i].len + 1 + 2);
+	}
+	qsort(words, wordCount, sizeof(gen_word_t), cmp_word);
+
+	while ((dictCount < wordCount) && (dictCount < GEN_DICT_SIZE) && (words[dictCount].gain > 0)) {
+		++dictCount;
+	}
+}
+
+/**
+ * @brief Code all descriptions into the blob, identical texts are shared
+ *
+ * @return 0: ok, -1: Blob too large
+ */
+static int encode_descs(void)
+{
+	for (uint16_t i = 0; i < descCount; ++i) {
+		const char * text = descs[i].text;
+		uint16_t     j;
+
+		for (j = 0; j < i; ++j) {
+			if (strcmp(descs[j].text, text) == 0) {
+				break;
+			}
+		}
+		if (j < i) {
+			descs[i].offset = descs[j].offset;
+			continue;
+		}
+
+		if ((blobLen + strlen(text) + 1) > GEN_MAX_BLOB_SIZE) {
+			printf("Descriptions are too large (GEN_MAX_BLOB_SIZE = %d)\n", GEN_MAX_BLOB_SIZE);
+			return -1;
+		}
+		descs[i].offset = blobLen;
+
+		// Longest word first
+		while (*text != '\0') {
+			int16_t  best    = -1;
+			uint16_t bestLen = 1;
+
+			for (uint16_t w = 0; w < dictCount; ++w) {
+				if ((words[w].len > bestLen) && (strncmp(text, words[w].text, words[w].len) == 0)) {
+					best    = w;
+					bestLen = words[w].len;
+				}
+			}
+			blob[blobLen++] = (best < 0) ? (uint8_t) *text : (GEN_DICT_FLAG + best);
+			text += bestLen;
+		}
+		blob[blobLen++] = 0;
+	}
+	return 0;
+}
+
+/**
+ * @brief Write the header giving the ID of each description
+ *
+ * @param path Path of the file
+ * @return 0: ok, -1: Error
+ */
+static int write_ids(const char * path)
+{
+	FILE * file = fopen(path, "w");
+
+	if (file == NULL) {
+		return -1;
+	}
+	fprintf(file, "/* Generated by cli_desc_gen, do not edit */\n");
+	fprintf(file, "#ifndef CLI_DESC_IDS_H\n#define CLI_DESC_IDS_H\n\n");
+	fprintf(file, "#define CLI_DESC_COUNT %u\n\n", descCount);
+	for (uint16_t i = 0; i < descCount; ++i) {
+		fprintf(file, "#define CLI_DESC_ID_%s %u\n", descs[i].id, i);
+	}
+	fprintf(file, "\n#endif /* CLI_DESC_IDS_H */\n");
+	fclose(file);
+	return 0;
+}
+
+/**
+ * @brief Write the tables used by cli_print_desc()
+ *
+ * @param path Path of the file
+ * @return 0: ok, -1: Error
+ */
+static int write_blob(const char * path)
+{
+	FILE *   file = fopen(path, "w");
+	uint32_t offset;
+
+	if (file == NULL) {
+		return -1;
+	}
+	fprintf(file, "/* Generated by cli_desc_gen, do not edit */\n");
+	fprintf(file, "#include <stdint.h>\n\n");
+
+	fprintf(file, "const uint8_t cliDescBlob[%u] = {", blobLen);
+	for (uint32_t i = 0; i < blobLen; ++i) {
+		fprintf(file, "%s0x%02X,", ((i % 16) == 0) ? "\n\t" : " ", blob[i]);
+	}
+	fprintf(file, "\n};\n\n");
+
+	fprintf(file, "const uint16_t cliDescOffsets[%u] = {", descCount);
+	for (uint16_t i = 0; i < descCount; ++i) {
+		fprintf(file, "\n\t%u, // %s", descs[i].offset, descs[i].id);
+	}
+	fprintf(file, "\n};\n\n");
+
+	fprintf(file, "const char cliDescDict[] = {");
+	for (uint16_t w = 0; w < dictCount; ++w) {
+		bool isPrintable = true;
+
+		fprintf(file, "\n\t");
+		for (uint16_t i = 0; i <= words[w].len; ++i) {
+			fprintf(file, "0x%02X, ", (uint8_t) words[w].text[i]);
+			if ((i < words[w].len) && (!isprint((unsigned char) words[w].text[i]) || (words[w].text[i] == '\\'))) {
+				isPrintable = false;
+			}
+		}
+		if (isPrintable) {
+			fprintf(file, "// \"%s\"", words[w].text);
+		}
+	}
+	fprintf(file, "\n\t0x00\n};\n\n");
+
+	fprintf(file, "const uint16_t cliDescDictOffsets[%u] = {", (dictCount > 0) ? dictCount : 1);
+	offset = 0;
+	for (uint16_t w = 0; w < dictCount; ++w) {
+		fprintf(file, "%s%u,", ((w % 16) == 0) ? "\n\t" : " ", offset);
+		offset += words[w].len + 1;
+	}
+	fprintf(file, "%s\n};\n", (dictCount > 0) ? "" : "\n\t0,");
+	fclose(file);
+	return 0;
+}
+
+/**
+ * @brief Compress the descriptions given by CLI_DESC() for CLI_DESC_COMPRESSED
+ * @details Usage: cli_desc_gen <output directory> <source file>...
+ * Writes cli_desc_ids.h (to include, See cli.h) and cli_desc_blob.c (to compile)
+ */
+int main(int argc, char * argv[])
+{
+	char     path[1024];
+	uint32_t textSize = 0;
+	uint32_t dictSize = 0;
+
+	if (argc < 3) {
+		printf("Usage: %s <output directory> <source file>...\n", argv[0]);
+		return 1;
+	}
+
+	for (int i = 2; i < argc; ++i) {
+		if (parse_file(argv[i]) != 0) {
+			return 1;
+		}
+	}
+
+	if (descCount == 0) {
+		printf("No CLI_DESC() found\n");
+		return 1;
+	}
+
+	build_dict();
+	if (encode_descs() != 0) {
+		return 1;
+	}
+
+	snprintf(path, sizeof(path), "%s/%s", argv[1], GEN_IDS_FILE);
+	if (write_ids(path) != 0) {
+		printf("Unable to write \"%s\"\n", path);
+		return 1;
+	}
+	snprintf(path, sizeof(path), "%s/%s", argv[1], GEN_BLOB_FILE);
+	if (write_blob(path) != 0) {
+		printf("Unable to write \"%s\"\n", path);
+		return 1;
+	}
+
+	for (uint16_t i = 0; i < descCount; ++i) {
+		textSize += strlen(descs[i].text) + 1;
+	}
+	for (uint16_t w = 0; w < dictCount; ++w) {
+		dictSize += words[w].len + 1 + 2;
+	}
+	printf("%u descriptions: %u bytes of text coded in %u bytes + %u bytes of dictionary (%u words)\n",
+		   descCount, textSize, blobLen + descCount * 2, dictSize, dictCount);
+	return 0;
+}